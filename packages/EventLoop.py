@@ -0,0 +1,75 @@
+# Event loop integration for inventor sensor queues
+# Author: Thomas Moeller
+#
+# Copyright (C) the PyInventor contributors. All rights reserved.
+# This file is part of PyInventor, distributed under the BSD 3-Clause
+# License. For full terms see the included COPYING file.
+#
+
+"""
+Integrates the processing of inventor timer and delay queues with asyncio.
+
+Instead of polling process_queues() the event loop waits on the wakeup
+file descriptor of the inventor module and on the deadline of the next
+timer sensor, so sensors fire on time and idle applications use no CPU.
+"""
+
+import asyncio
+import inventor
+
+
+class AsyncioIntegration(object):
+    """
+    Processes inventor queues from an asyncio event loop. Create one
+    instance per event loop and keep a reference to it.
+    """
+
+    # polling interval if platform does not support wakeup file descriptor
+    pollInterval = 0.01
+
+    def __init__(self, loop=None):
+        self.loop = loop if loop is not None else asyncio.get_event_loop()
+        self.handle = None
+        self.fd = inventor.wakeup_fd()
+        if self.fd is not None:
+            self.loop.add_reader(self.fd, self.schedule)
+        self.schedule()
+
+    def close(self):
+        """Stops processing inventor queues"""
+        if self.handle is not None:
+            self.handle.cancel()
+            self.handle = None
+        if self.fd is not None:
+            self.loop.remove_reader(self.fd)
+            self.fd = None
+
+    def process(self):
+        """Processes queues and waits for next sensor"""
+        # callbacks scheduled by the loop only run when it has nothing
+        # else to do, so idle sensors are processed too but without sleeping
+        self.handle = None
+        inventor.process_queues(True, False)
+        self.schedule()
+
+    def schedule(self):
+        """Schedules processing for when next sensor is due"""
+        if self.handle is not None:
+            self.handle.cancel()
+            self.handle = None
+        timeout = inventor.next_timeout()
+        if self.fd is None:
+            timeout = self.pollInterval if timeout is None else min(timeout, self.pollInterval)
+        if timeout is not None:
+            self.handle = self.loop.call_later(timeout, self.process)
+
+
+def install_asyncio(loop=None):
+    """
+    Starts processing inventor queues in the given (or current) asyncio
+    event loop.
+
+    Returns:
+        AsyncioIntegration instance, call close() on it to stop processing.
+    """
+    return AsyncioIntegration(loop)
@@ -9,6 +9,52 @@
 from PySide import QtCore, QtGui, QtOpenGL
 import inventor
 
+class QIVEventLoop(QtCore.QObject):
+    """
+    Processes inventor timer and delay queues from the Qt event loop. A
+    socket notifier watches the wakeup file descriptor of the inventor
+    module and a single shot timer fires when the next sensor is due, so
+    no polling is needed.
+    """
+
+    # polling interval in ms if platform does not support wakeup file descriptor
+    pollInterval = 10
+
+    def __init__(self, parent=None):
+        super().__init__(parent)
+        self.timer = QtCore.QTimer(self)
+        self.timer.setSingleShot(True)
+        self.timer.timeout.connect(self.process)
+        self.notifier = None
+        fd = inventor.wakeup_fd()
+        if fd is not None:
+            self.notifier = QtCore.QSocketNotifier(fd, QtCore.QSocketNotifier.Read, self)
+            self.notifier.activated.connect(self.schedule)
+        self.schedule()
+
+    def process(self):
+        """Processes queues and waits for next sensor"""
+        # timers fire after pending window system events were handled, so
+        # idle sensors are processed too but without sleeping
+        inventor.process_queues(True, False)
+        self.schedule()
+
+    def schedule(self):
+        """Starts timer for when next sensor is due"""
+        timeout = inventor.next_timeout()
+        if timeout is None:
+            if self.notifier is not None:
+                self.timer.stop()
+                return
+            timeout = self.pollInterval
+        else:
+            # round up to avoid firing before timer is due
+            timeout = int(timeout * 1000.0 + 0.999)
+            if self.notifier is None:
+                timeout = min(timeout, self.pollInterval)
+        self.timer.start(timeout)
+
+
 class QIVWidget(QtOpenGL.QGLWidget):
     """
     OpenGL widget for displaying and interacting with inventor scene graphs.
@@ -19,9 +65,8 @@ class QIVWidget(QtOpenGL.QGLWidget):
     # used to map Qt buttons to simple index
     qtButtonIndex = (QtCore.Qt.LeftButton, QtCore.Qt.MiddleButton, QtCore.Qt.RightButton)
 
-    # queue processing timer on class (not instance) level
-    idleTimer = QtCore.QTimer()
-    idleTimer.timeout.connect(inventor.process_queues)
+    # queue processing on class (not instance) level
+    eventLoop = None
 
     def __init__(self, parent=None, shareWidget=None, format=QtOpenGL.QGLFormat()):
         super().__init__(format, parent, shareWidget)
@@ -30,8 +75,9 @@ class QIVWidget(QtOpenGL.QGLWidget):
         self.sceneManager.redisplay = self.updateGL
         self.resizeGLWidth = 512
         self.resizeGLHeight = 512
-        # timer must be started from QThread
-        self.idleTimer.start()
+        # timers must be started from QThread
+        if QIVWidget.eventLoop is None:
+            QIVWidget.eventLoop = QIVEventLoop()
     
     def initializeGL(self):
         """Performs initial OpenGL setup"""
@@ -49,10 +49,9 @@ class QSceneGraphEditorWindow(QtGui.QWidget):
         
         self.inspectorWidget.attach(self.previewWidget.sceneManager.scene)
 
-        # timer for inventor queue processing (delay, timer and idle queues)
-        self.idleTimer = QtCore.QTimer()
-        self.idleTimer.timeout.connect(iv.process_queues)
-        self.idleTimer.start()
+        # inventor queue processing (delay, timer and idle queues) is
+        # driven by the event loop integration shared by all viewports
+        self.eventLoop = QIVWidget.eventLoop
 
     def applicationTitle(self):
         """Returns the default application title"""
@@ -6,6 +6,7 @@ package contains helper classes that integrate Open Inventor / Coin3D
 into PySide based applications, namely:
 - QIVWidget: Viewport widget for rendering and interacting with scene
   graphs.
+- QIVEventLoop: Processes inventor sensor queues from the Qt event loop.
 - QInspectorWidget: Scene graph inspector showing the scene structure in
   a tree view and the fields of a node in a table view.
 
@@ -4,10 +4,11 @@ Python binding for the Open Inventor 3D graphics toolkit.
 The intention of this module is to provide Python programmers tools for
 easy creation of interactive 3D applications. It interfaces to the Coin3D
 or Open Inventor 3D graphics toolkit, which implements a scene graph API
-on top of OpenGL. PyInventor consists of two submodules:
+on top of OpenGL. PyInventor consists of three submodules:
 - inventor: Low level interface module to the C++ Coin3D or Open Inventor
   library.
 - QtInventor: Helper classes for creating PySide applications.
+- EventLoop: Integration of inventor sensor queues with asyncio.
 
 The module also contains a simple scene graph editor application, which
 can be started from the command line with "python -m PyInventor".
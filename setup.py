@@ -72,7 +72,19 @@ module1 = Extension('inventor',
 							   'src/PyField.cpp',
                                'src/PyEngineOutput.cpp',
                                'src/PyNodekitCatalog.cpp',
-                               'src/PyPath.cpp'])
+                               'src/PyPath.cpp',
+                               'src/PySharedScene.cpp',
+                               'src/PyGeometry.cpp',
+                               'src/PyExporter.cpp',
+                               'src/PyChangeLog.cpp',
+                               'src/PyEngine.cpp',
+                               'src/SoExpressionEngine.cpp',
+                               'src/PyProfiler.cpp',
+                               'src/PyOptimizer.cpp',
+                               'src/PySimplifier.cpp',
+                               'src/SoPointCloud.cpp',
+                               'src/PyIsosurface.cpp',
+                               'src/PyMeshTools.cpp'])
 
 setup (name = 'PyInventor',
        version = '1.2',
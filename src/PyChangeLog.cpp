@@ -0,0 +1,525 @@
+/**
+ * \file
+ * \brief      PyChangeLog class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/sensors/SoSensors.h>
+#include <Inventor/fields/SoField.h>
+#include <Inventor/fields/SoFieldContainer.h>
+#include <Inventor/nodes/SoNode.h>
+#include "PyChangeLog.h"
+#include <algorithm>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+
+
+// all existing change logs, records are delivered per process_queues() call
+static std::vector<PyObject*> changeLogs;
+
+// notified when a change log with callback needs a process_queues() call
+static void (*changedCallback)(void *data) = 0;
+static void *changedCallbackData = 0;
+
+
+PyTypeObject *PyChangeLog::getType()
+{
+	static PyMemberDef members[] =
+	{
+		{"callback", T_OBJECT_EX, offsetof(Object, callback), 0,
+            "Change log callback function.\n"
+            "\n"
+            "If set the function is called once per process_queues() call with the\n"
+            "list of records collected since the previous call.\n"
+        },
+		{"overflow", T_PYSSIZET, offsetof(Object, overflow), READONLY,
+            "Number of records dropped because the buffer capacity was exceeded.\n"
+        },
+		{NULL}  /* Sentinel */
+	};
+
+	static PyMethodDef methods[] =
+	{
+		{"attach", (PyCFunction) attach, METH_VARARGS,
+            "Records changes of a node (including its children) or of a single\n"
+            "field. Can be called repeatedly to observe many objects with one log.\n"
+            "\n"
+            "Args:\n"
+            "    - node: Scene object instance to attach to.\n"
+            "    - name: Optional field name.\n"
+            "\n"
+            "Returns:\n"
+            "    Container id used in records for the given scene object.\n"
+        },
+		{"detach", (PyCFunction) detach, METH_NOARGS,
+            "Detaches from all observed objects and discards pending records.\n"
+        },
+		{"fetch", (PyCFunction) fetch, METH_NOARGS,
+            "Returns and clears the records collected so far.\n"
+            "\n"
+            "Returns:\n"
+            "    List of (container id, field name, trigger type) tuples. Repeated\n"
+            "    changes of the same field are merged into one record. The field\n"
+            "    name is None for structural changes, in which case the trigger\n"
+            "    type is one of the group operations 1=add, 2=insert, 3=replace,\n"
+            "    4=remove and 5=remove all children. Field changes have type 0.\n"
+            "    Ids of attached objects stay valid until detach(), ids of other\n"
+            "    containers until the following batch is fetched. A container\n"
+            "    that is no longer referenced afterwards is released and gets a\n"
+            "    new id if it changes again.\n"
+        },
+		{"get_container", (PyCFunction) get_container, METH_VARARGS,
+            "Returns the scene object for a container id.\n"
+            "\n"
+            "Args:\n"
+            "    Container id as found in records.\n"
+            "\n"
+            "Returns:\n"
+            "    Scene object instance or None.\n"
+        },
+		{NULL}  /* Sentinel */
+	};
+
+	static PyTypeObject changeLogType =
+	{
+		PyVarObject_HEAD_INIT(NULL, 0)
+		"ChangeLog",               /* tp_name */
+		sizeof(Object),            /* tp_basicsize */
+		0,                         /* tp_itemsize */
+		(destructor) tp_dealloc,   /* tp_dealloc */
+		0,                         /* tp_print */
+		0,                         /* tp_getattr */
+		0,                         /* tp_setattr */
+		0,                         /* tp_reserved */
+		0,                         /* tp_repr */
+		0,                         /* tp_as_number */
+		0,                         /* tp_as_sequence */
+		0,                         /* tp_as_mapping */
+		0,                         /* tp_hash  */
+		0,                         /* tp_call */
+		0,                         /* tp_str */
+		0,                         /* tp_getattro */
+		0,                         /* tp_setattro */
+		0,                         /* tp_as_buffer */
+		Py_TPFLAGS_DEFAULT |
+		Py_TPFLAGS_BASETYPE,       /* tp_flags */
+        "Collects changes of many nodes and fields in a native buffer.\n"
+        "\n"
+        "Unlike Sensor, which calls into Python for every change, a change log\n"
+        "merges repeated changes and hands them over in one batch per\n"
+        "process_queues() call.\n"
+        "\n"
+        "Args:\n"
+        "    callback: Optional function receiving the list of records.\n"
+        "    capacity: Maximum number of records buffered per batch.\n",
+		0,                         /* tp_traverse */
+		0,                         /* tp_clear */
+		0,                         /* tp_richcompare */
+		0,                         /* tp_weaklistoffset */
+		0,                         /* tp_iter */
+		0,                         /* tp_iternext */
+		methods,                   /* tp_methods */
+		members,                   /* tp_members */
+		0,                         /* tp_getset */
+		0,                         /* tp_base */
+		0,                         /* tp_dict */
+		0,                         /* tp_descr_get */
+		0,                         /* tp_descr_set */
+		0,                         /* tp_dictoffset */
+		(initproc) tp_init,        /* tp_init */
+		0,                         /* tp_alloc */
+		tp_new,                    /* tp_new */
+	};
+
+	return &changeLogType;
+}
+
+
+void PyChangeLog::tp_dealloc(Object* self)
+{
+	std::vector<PyObject*>::iterator it = std::find(changeLogs.begin(), changeLogs.end(), (PyObject*) self);
+	if (it != changeLogs.end()) changeLogs.erase(it);
+
+	detachAll(self);
+	clearContainers(self);
+
+	delete self->attachments;
+	delete self->containers;
+	delete self->containerIds;
+	delete self->attached;
+	delete self->batch;
+	delete self->delivered;
+	delete self->pending;
+	delete [] self->records;
+
+	Py_XDECREF(self->callback);
+
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject* PyChangeLog::tp_new(PyTypeObject *type, PyObject* /*args*/, PyObject* /*kwds*/)
+{
+	PySceneObject::initSoDB();
+
+	Object *self = (Object *)type->tp_alloc(type, 0);
+	if (self != NULL)
+	{
+		self->attachments = new std::vector<Attachment*>();
+		self->containers = new std::map<int32_t, SoFieldContainer*>();
+		self->containerIds = new std::map<SoFieldContainer*, int32_t>();
+		self->attached = new std::set<SoFieldContainer*>();
+		self->batch = new std::set<SoFieldContainer*>();
+		self->delivered = new std::set<SoFieldContainer*>();
+		self->nextId = 0;
+		self->pending = new std::map<std::pair<int32_t, SoField*>, size_t>();
+		self->records = 0;
+		self->capacity = 0;
+		self->count = 0;
+		self->callback = 0;
+		self->overflow = 0;
+	}
+
+	return (PyObject *) self;
+}
+
+
+int PyChangeLog::tp_init(Object *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *callback = Py_None;
+	Py_ssize_t capacity = 65536;
+
+	static char *kwlist[] = { "callback", "capacity", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|On", kwlist, &callback, &capacity))
+	{
+		return -1;
+	}
+
+	Py_INCREF(callback);
+	Py_XDECREF(self->callback);
+	self->callback = callback;
+
+	delete [] self->records;
+	self->capacity = capacity > 0 ? (size_t) capacity : 1;
+	self->records = new Record[self->capacity];
+	self->count = 0;
+
+	if (std::find(changeLogs.begin(), changeLogs.end(), (PyObject*) self) == changeLogs.end())
+	{
+		changeLogs.push_back((PyObject*) self);
+	}
+
+	return 0;
+}
+
+
+int32_t PyChangeLog::getContainerId(Object *self, SoFieldContainer *container)
+{
+	std::map<SoFieldContainer*, int32_t>::iterator it = self->containerIds->find(container);
+	if (it != self->containerIds->end())
+	{
+		return it->second;
+	}
+
+	// containers are referenced while attached or while their records are
+	// pending or were delivered with the latest batch, see releaseDelivered()
+	int32_t id = self->nextId++;
+	container->ref();
+	(*self->containers)[id] = container;
+	(*self->containerIds)[container] = id;
+
+	return id;
+}
+
+
+void PyChangeLog::addRecord(Object *self, SoFieldContainer *container, SoField *field, int type)
+{
+	if (!container) return;
+
+	int32_t id = getContainerId(self, container);
+	self->batch->insert(container);
+
+	// merge with pending record of same field
+	if (field)
+	{
+		std::pair<int32_t, SoField*> key(id, field);
+		if (self->pending->find(key) != self->pending->end())
+		{
+			return;
+		}
+		(*self->pending)[key] = self->count;
+	}
+
+	if (!self->count && changedCallback && self->callback && PyCallable_Check(self->callback))
+	{
+		// records are delivered by process_queues(), so wake up event loops
+		changedCallback(changedCallbackData);
+	}
+
+	if (self->count < self->capacity)
+	{
+		Record &record = self->records[self->count++];
+		record.container = id;
+		record.field = field;
+		record.type = type;
+	}
+	else
+	{
+		self->overflow++;
+	}
+}
+
+
+void PyChangeLog::sensorCBFunc(void *userdata, SoSensor *sensor)
+{
+	// sensors have priority 0, so this is called immediately on change
+	// and trigger information is available
+	Attachment *attachment = (Attachment *) userdata;
+	SoDataSensor *dataSensor = (SoDataSensor *) sensor;
+
+	SoField *field = dataSensor->getTriggerField();
+	if (field)
+	{
+		addRecord(attachment->log, field->getContainer(), field, 0);
+	}
+	else
+	{
+		int type = 0;
+		#ifdef __COIN__
+		type = (int) dataSensor->getTriggerOperationType();
+		#endif
+		addRecord(attachment->log, dataSensor->getTriggerNode(), NULL, type);
+	}
+}
+
+
+void PyChangeLog::releaseDelivered(Object *self)
+{
+	// containers of the previous batch are released unless attached or
+	// changed again, so ids only accumulate for attached objects
+	for (std::set<SoFieldContainer*>::iterator it = self->delivered->begin(); it != self->delivered->end(); ++it)
+	{
+		SoFieldContainer *container = *it;
+		if (!self->attached->count(container) && !self->batch->count(container))
+		{
+			std::map<SoFieldContainer*, int32_t>::iterator id = self->containerIds->find(container);
+			if (id != self->containerIds->end())
+			{
+				self->containers->erase(id->second);
+				self->containerIds->erase(id);
+				container->unref();
+			}
+		}
+	}
+
+	self->delivered->swap(*self->batch);
+	self->batch->clear();
+}
+
+
+void PyChangeLog::detachAll(Object *self)
+{
+	for (size_t i = 0; i < self->attachments->size(); ++i)
+	{
+		delete (*self->attachments)[i]->sensor;
+		delete (*self->attachments)[i];
+	}
+	self->attachments->clear();
+}
+
+
+void PyChangeLog::clearContainers(Object *self)
+{
+	for (std::map<int32_t, SoFieldContainer*>::iterator it = self->containers->begin(); it != self->containers->end(); ++it)
+	{
+		it->second->unref();
+	}
+	self->containers->clear();
+	self->containerIds->clear();
+	self->attached->clear();
+	self->batch->clear();
+	self->delivered->clear();
+	self->pending->clear();
+	self->count = 0;
+}
+
+
+PyObject* PyChangeLog::attach(Object *self, PyObject *args)
+{
+	PyObject *node = 0;
+	char *fieldName = 0;
+	if (PyArg_ParseTuple(args, "O|s", &node, &fieldName))
+	{
+		SoFieldContainer *fc = 0;
+		SoField *field = 0;
+
+		if (node && PySceneObject_Check(node))
+		{
+			fc = ((PySceneObject::Object*) node)->inventorObject;
+		}
+
+		if (fc && fieldName)
+		{
+			field = fc->getField(fieldName);
+		}
+
+		if ((fc && !fieldName && fc->isOfType(SoNode::getClassTypeId())) || field)
+		{
+			Attachment *attachment = new Attachment;
+			attachment->log = self;
+
+			if (field)
+			{
+				SoFieldSensor *sensor = new SoFieldSensor(sensorCBFunc, attachment);
+				sensor->setPriority(0);
+				sensor->attach(field);
+				attachment->sensor = sensor;
+			}
+			else
+			{
+				SoNodeSensor *sensor = new SoNodeSensor(sensorCBFunc, attachment);
+				sensor->setPriority(0);
+				sensor->attach((SoNode*) fc);
+				attachment->sensor = sensor;
+			}
+			self->attachments->push_back(attachment);
+
+			int32_t id = getContainerId(self, fc);
+			self->attached->insert(fc);
+
+			return PyLong_FromLong(id);
+		}
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+PyObject* PyChangeLog::detach(Object *self)
+{
+	detachAll(self);
+	clearContainers(self);
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+PyObject* PyChangeLog::fetch(Object *self)
+{
+	PyObject *result = PyList_New(self->count);
+	std::map<SoField*, PyObject*> names;
+
+	for (size_t i = 0; i < self->count; ++i)
+	{
+		const Record &record = self->records[i];
+		PyObject *name = Py_None;
+		if (record.field)
+		{
+			// field names are looked up once per batch
+			std::map<SoField*, PyObject*>::iterator it = names.find(record.field);
+			if (it != names.end())
+			{
+				name = it->second;
+			}
+			else
+			{
+				SbName fieldName;
+				std::map<int32_t, SoFieldContainer*>::iterator container = self->containers->find(record.container);
+				if (container != self->containers->end())
+				{
+					container->second->getFieldName(record.field, fieldName);
+				}
+				name = PyUnicode_FromString(fieldName.getString());
+				names[record.field] = name;
+			}
+		}
+		PyList_SetItem(result, i, Py_BuildValue("(iOi)", record.container, name, record.type));
+	}
+
+	for (std::map<SoField*, PyObject*>::iterator it = names.begin(); it != names.end(); ++it)
+	{
+		Py_DECREF(it->second);
+	}
+
+	self->pending->clear();
+	self->count = 0;
+	releaseDelivered(self);
+
+	return result;
+}
+
+
+PyObject* PyChangeLog::get_container(Object *self, PyObject *args)
+{
+	int id = -1;
+	if (PyArg_ParseTuple(args, "i", &id))
+	{
+		std::map<int32_t, SoFieldContainer*>::iterator it = self->containers->find(id);
+		if (it != self->containers->end())
+		{
+			return PySceneObject::createWrapper(it->second);
+		}
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+void PyChangeLog::processAll()
+{
+	// callbacks may create or destroy change logs, so iterate over a copy
+	std::vector<PyObject*> logs(changeLogs);
+	for (size_t i = 0; i < logs.size(); ++i) Py_INCREF(logs[i]);
+
+	for (size_t i = 0; i < logs.size(); ++i)
+	{
+		Object *self = (Object *) logs[i];
+		if (self->count && self->callback && PyCallable_Check(self->callback))
+		{
+			PyObject *records = fetch(self);
+			PyObject *value = PyObject_CallFunctionObjArgs(self->callback, records, NULL);
+			if (value != NULL)
+			{
+				Py_DECREF(value);
+			}
+			else
+			{
+				PyErr_Print();
+			}
+			Py_DECREF(records);
+		}
+	}
+
+	for (size_t i = 0; i < logs.size(); ++i) Py_DECREF(logs[i]);
+}
+
+
+bool PyChangeLog::isPending()
+{
+	for (size_t i = 0; i < changeLogs.size(); ++i)
+	{
+		Object *self = (Object *) changeLogs[i];
+		if (self->count && self->callback && PyCallable_Check(self->callback))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void PyChangeLog::setChangedCallback(void (*func)(void *data), void *data)
+{
+	changedCallback = func;
+	changedCallbackData = data;
+}
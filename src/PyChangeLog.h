@@ -0,0 +1,94 @@
+/**
+ * \file
+ * \brief      PyChangeLog class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+#include <vector>
+#include <map>
+#include <set>
+
+class SoSensor;
+class SoDataSensor;
+class SoField;
+class SoFieldContainer;
+
+
+class PyChangeLog
+{
+public:
+	static PyTypeObject *getType();
+
+	// delivers pending records of all change logs, called from process_queues()
+	static void processAll();
+
+	// true if a change log with callback has undelivered records
+	static bool isPending();
+
+	// function called when a change log with callback receives its first
+	// record of a batch, analogous to SoSensorManager::setChangedCallback()
+	static void setChangedCallback(void (*func)(void *data), void *data);
+
+private:
+	struct Attachment;
+
+	// change record, field is NULL for structural changes
+	typedef struct
+	{
+		int32_t container;
+		SoField *field;
+		int type;
+	} Record;
+
+	typedef struct
+	{
+		PyObject_HEAD
+		std::vector<Attachment*> *attachments;
+		std::map<int32_t, SoFieldContainer*> *containers;
+		std::map<SoFieldContainer*, int32_t> *containerIds;
+		std::set<SoFieldContainer*> *attached;
+		std::set<SoFieldContainer*> *batch;
+		std::set<SoFieldContainer*> *delivered;
+		int32_t nextId;
+		std::map<std::pair<int32_t, SoField*>, size_t> *pending;
+		Record *records;
+		size_t capacity, count;
+		PyObject *callback;
+		Py_ssize_t overflow;
+	} Object;
+
+	struct Attachment
+	{
+		Object *log;
+		SoDataSensor *sensor;
+	};
+
+	// type implementations
+	static void tp_dealloc(Object *self);
+	static PyObject* tp_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+	static int tp_init(Object *self, PyObject *args, PyObject *kwds);
+
+	// methods
+	static PyObject* attach(Object *self, PyObject *args);
+	static PyObject* detach(Object *self);
+	static PyObject* fetch(Object *self);
+	static PyObject* get_container(Object *self, PyObject *args);
+
+	// internal
+	static int32_t getContainerId(Object *self, SoFieldContainer *container);
+	static void addRecord(Object *self, SoFieldContainer *container, SoField *field, int type);
+	static void sensorCBFunc(void *userdata, SoSensor *sensor);
+	static void releaseDelivered(Object *self);
+	static void detachAll(Object *self);
+	static void clearContainers(Object *self);
+};
+
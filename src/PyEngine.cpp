@@ -0,0 +1,437 @@
+/**
+ * \file
+ * \brief      PyEngine class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/engines/SoEngine.h>
+#include <Inventor/engines/SoOutputData.h>
+#include <Inventor/fields/SoFieldData.h>
+#include <Inventor/fields/SoFields.h>
+#include "PyEngine.h"
+#include "PyField.h"
+#define PY_ARRAY_UNIQUE_SYMBOL PyInventor_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/ndarrayobject.h>
+#include <vector>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+
+
+// macro for creating read-only numpy view of numeric multi-field
+#define ENGINE_INPUT_VIEW(t, nt, n, f) \
+	if (f->isOfType(SoMF ## t ::getClassTypeId())) \
+	{ \
+		npy_intp dims[] = { ((SoMF ## t *) f)->getNum(), n }; \
+		return PyArray_New(&PyArray_Type, (n > 1) ? 2 : 1, dims, nt, NULL, (void *) ((SoMF ## t *) f)->getValues(0), 0, NPY_ARRAY_CARRAY_RO, NULL); \
+	}
+
+// macro for setting numeric multi-field from array in one go
+#define ENGINE_OUTPUT_SET(t, ct, nt, n, f, v) \
+	if (f->isOfType(SoMF ## t ::getClassTypeId())) \
+	{ \
+		PyArrayObject *arr = (PyArrayObject*) PyArray_FROM_OTF(v, nt, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST); \
+		if (!arr) return false; \
+		if ((PyArray_SIZE(arr) % n) || ((n > 1) && ((PyArray_NDIM(arr) < 1) || (PyArray_DIM(arr, PyArray_NDIM(arr) - 1) != n)))) \
+		{ \
+			PyErr_Format(PyExc_ValueError, "Output array must have shape (N, %d)", (int) n); \
+			Py_DECREF(arr); \
+			return false; \
+		} \
+		int num = (int) (PyArray_SIZE(arr) / n); \
+		((SoMF ## t *) f)->setNum(num); \
+		((SoMF ## t *) f)->setValues(0, num, (const ct *) PyArray_DATA(arr)); \
+		Py_DECREF(arr); \
+		return true; \
+	}
+
+
+// engine with inputs and outputs defined at runtime that calls a Python function for evaluation
+class SoPyEngine : public SoEngine
+{
+public:
+	static void initClass();
+	static SoType getClassTypeId() { return classTypeId; }
+	virtual SoType getTypeId() const { return classTypeId; }
+	virtual const SoFieldData *getFieldData() const { return inputData; }
+	virtual const SoEngineOutputData *getOutputData() const { return outputData; }
+
+	SoPyEngine(PyObject *evaluateFunc);
+
+	bool hasName(const SbName &name) const;
+	void addInput(const SbName &name, SoType type);
+	void addOutput(const SbName &name, SoType type);
+
+protected:
+	virtual ~SoPyEngine();
+	virtual void evaluate();
+
+private:
+	void writeOutput(SoEngineOutput *output, PyObject *value);
+
+	static SoType classTypeId;
+
+	SoFieldData *inputData;
+	SoEngineOutputData *outputData;
+	std::vector<std::pair<SbName, SoField*> > inputs;
+	std::vector<std::pair<SbName, SoEngineOutput*> > outputs;
+	PyObject *func;
+};
+
+
+SoType SoPyEngine::classTypeId;
+
+
+void SoPyEngine::initClass()
+{
+	if (classTypeId.isBad())
+	{
+		// abstract type: instances cannot be read from files as the function is missing
+		classTypeId = SoType::createType(SoEngine::getClassTypeId(), "PyEngine");
+	}
+}
+
+
+SoPyEngine::SoPyEngine(PyObject *evaluateFunc) : func(evaluateFunc)
+{
+	Py_XINCREF(func);
+	inputData = new SoFieldData();
+	outputData = new SoEngineOutputData();
+	isBuiltIn = FALSE;
+}
+
+
+SoPyEngine::~SoPyEngine()
+{
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		delete inputs[i].second;
+	}
+
+	for (size_t i = 0; i < outputs.size(); ++i)
+	{
+		delete outputs[i].second;
+	}
+
+	delete inputData;
+	delete outputData;
+
+	Py_XDECREF(func);
+}
+
+
+bool SoPyEngine::hasName(const SbName &name) const
+{
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		if (inputs[i].first == name) return true;
+	}
+
+	for (size_t i = 0; i < outputs.size(); ++i)
+	{
+		if (outputs[i].first == name) return true;
+	}
+
+	return false;
+}
+
+
+void SoPyEngine::addInput(const SbName &name, SoType type)
+{
+	SoField *field = (SoField *) type.createInstance();
+	field->setContainer(this);
+	inputData->addField(this, name.getString(), field);
+	inputs.push_back(std::make_pair(name, field));
+}
+
+
+void SoPyEngine::addOutput(const SbName &name, SoType type)
+{
+	SoEngineOutput *output = new SoEngineOutput();
+	outputData->addOutput(this, name.getString(), output, type);
+	output->setContainer(this);
+	outputs.push_back(std::make_pair(name, output));
+}
+
+
+void SoPyEngine::evaluate()
+{
+	if (!func || !PyCallable_Check(func)) return;
+
+	PyObject *kwds = PyDict_New();
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		PyObject *value = PyEngine::getInputValue(inputs[i].second);
+		if (value)
+		{
+			PyDict_SetItemString(kwds, inputs[i].first.getString(), value);
+			Py_DECREF(value);
+		}
+	}
+
+	PyObject *args = PyTuple_New(0);
+	PyObject *result = PyObject_Call(func, args, kwds);
+	Py_DECREF(args);
+	Py_DECREF(kwds);
+
+	if (result)
+	{
+		if (PyDict_Check(result))
+		{
+			for (size_t i = 0; (i < outputs.size()) && !PyErr_Occurred(); ++i)
+			{
+				PyObject *value = PyDict_GetItemString(result, outputs[i].first.getString());
+				if (value) writeOutput(outputs[i].second, value);
+			}
+		}
+		else if (outputs.size() == 1)
+		{
+			writeOutput(outputs[0].second, result);
+		}
+		else if (result != Py_None)
+		{
+			PyErr_SetString(PyExc_TypeError, "Engine evaluation must return a dictionary of output values");
+		}
+
+		Py_DECREF(result);
+	}
+
+	if (PyErr_Occurred())
+	{
+		// there is no caller to return errors to during engine evaluation
+		PyErr_Print();
+	}
+}
+
+
+void SoPyEngine::writeOutput(SoEngineOutput *output, PyObject *value)
+{
+	if (!output->isEnabled()) return;
+
+	// convert value once and copy it to any further connected fields
+	SoField *first = 0;
+	for (int i = 0; i < output->getNumConnections(); ++i)
+	{
+		SoField *field = (*output)[i];
+		if (field->isReadOnly()) continue;
+
+		if (!first)
+		{
+			if (!PyEngine::setOutputValue(field, value)) return;
+			first = field;
+		}
+		else
+		{
+			field->copyFrom(*first);
+		}
+	}
+}
+
+
+PyTypeObject *PyEngine::getType()
+{
+	static PyTypeObject engineType =
+	{
+		PyVarObject_HEAD_INIT(NULL, 0)
+		"PyEngine",                /* tp_name */
+		sizeof(PySceneObject::Object), /* tp_basicsize */
+		0,                         /* tp_itemsize */
+		0,                         /* tp_dealloc */
+		0,                         /* tp_print */
+		0,                         /* tp_getattr */
+		0,                         /* tp_setattr */
+		0,                         /* tp_reserved */
+		0,                         /* tp_repr */
+		0,                         /* tp_as_number */
+		0,                         /* tp_as_sequence */
+		0,                         /* tp_as_mapping */
+		0,                         /* tp_hash  */
+		0,                         /* tp_call */
+		0,                         /* tp_str */
+		0,                         /* tp_getattro */
+		0,                         /* tp_setattro */
+		0,                         /* tp_as_buffer */
+		Py_TPFLAGS_DEFAULT |
+		Py_TPFLAGS_BASETYPE,       /* tp_flags */
+		"PyEngine(inputs, outputs, evaluate)\n"
+		"\n"
+		"Engine whose inputs and outputs are defined at runtime and whose\n"
+		"evaluation is implemented by a Python function. Like any other engine\n"
+		"it is evaluated lazily when a connected field is read.\n"
+		"\n"
+		"The evaluate function is called with one keyword argument per input.\n"
+		"Numeric multi-value fields are passed as read-only numpy views of the\n"
+		"field data without copying; these views are only valid during the call.\n"
+		"Other fields are passed like field attribute values. The function\n"
+		"returns a dictionary mapping output names to values, or the value\n"
+		"itself if the engine has exactly one output. Numeric arrays are\n"
+		"written to connected multi-value fields in one go.\n"
+		"\n"
+		"Args:\n"
+		"    inputs: Dictionary mapping input names to field types, for\n"
+		"            example {'points': 'MFVec3f', 'scale': 'SFFloat'}.\n"
+		"    outputs: Dictionary mapping output names to field types.\n"
+		"    evaluate: Function computing the outputs from the inputs.\n",  /* tp_doc */
+		0,                         /* tp_traverse */
+		0,                         /* tp_clear */
+		0,                         /* tp_richcompare */
+		0,                         /* tp_weaklistoffset */
+		0,                         /* tp_iter */
+		0,                         /* tp_iternext */
+		0,                         /* tp_methods */
+		0,                         /* tp_members */
+		0,                         /* tp_getset */
+		PySceneObject::getEngineType(), /* tp_base */
+		0,                         /* tp_dict */
+		0,                         /* tp_descr_get */
+		0,                         /* tp_descr_set */
+		0,                         /* tp_dictoffset */
+		(initproc) tp_init,        /* tp_init */
+		0,                         /* tp_alloc */
+		0,                         /* tp_new */
+	};
+
+	return &engineType;
+}
+
+
+void PyEngine::initClass()
+{
+	SoPyEngine::initClass();
+}
+
+
+static bool addEngineFields(SoPyEngine *engine, PyObject *fields, bool isOutput)
+{
+	PyObject *key = NULL, *value = NULL;
+	Py_ssize_t pos = 0;
+
+	while (fields && PyDict_Next(fields, &pos, &key, &value))
+	{
+		const char *name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+		const char *typeName = PyUnicode_Check(value) ? PyUnicode_AsUTF8(value) : NULL;
+		if (!name || !typeName)
+		{
+			PyErr_SetString(PyExc_TypeError, "Engine inputs and outputs must map names to field type names");
+			return false;
+		}
+
+		SoType type = SoType::fromName(typeName);
+		if (type.isBad() || !type.isDerivedFrom(SoField::getClassTypeId()) || !type.canCreateInstance())
+		{
+			PyErr_Format(PyExc_ValueError, "Unknown field type '%s'", typeName);
+			return false;
+		}
+
+		if (engine->hasName(name))
+		{
+			PyErr_Format(PyExc_ValueError, "Duplicate engine input or output name '%s'", name);
+			return false;
+		}
+
+		if (isOutput)
+		{
+			engine->addOutput(name, type);
+		}
+		else
+		{
+			engine->addInput(name, type);
+		}
+	}
+
+	return true;
+}
+
+
+int PyEngine::tp_init(PySceneObject::Object *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *inputs = NULL, *outputs = NULL, *evaluate = NULL;
+	static char *kwlist[] = { "inputs", "outputs", "evaluate", NULL };
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOO", kwlist, &inputs, &outputs, &evaluate))
+	{
+		return -1;
+	}
+
+	if (!inputs && !outputs && !evaluate)
+	{
+		// no arguments when wrapping an existing instance
+		return 0;
+	}
+
+	if ((inputs && !PyDict_Check(inputs)) || (outputs && !PyDict_Check(outputs)))
+	{
+		PyErr_SetString(PyExc_TypeError, "Engine inputs and outputs must be dictionaries");
+		return -1;
+	}
+
+	if (!evaluate || !PyCallable_Check(evaluate))
+	{
+		PyErr_SetString(PyExc_TypeError, "Engine evaluate function must be callable");
+		return -1;
+	}
+
+	SoPyEngine *engine = new SoPyEngine(evaluate);
+	engine->ref();
+
+	if (!addEngineFields(engine, inputs, false) || !addEngineFields(engine, outputs, true))
+	{
+		engine->unref();
+		return -1;
+	}
+
+	if (self->inventorObject)
+	{
+		self->inventorObject->unref();
+	}
+	self->inventorObject = engine;
+
+	return 0;
+}
+
+
+PyObject *PyEngine::getInputValue(SoField *field)
+{
+	PyField::initNumpy();
+
+	ENGINE_INPUT_VIEW(Float, NPY_FLOAT32, 1, field);
+	ENGINE_INPUT_VIEW(Double, NPY_FLOAT64, 1, field);
+	ENGINE_INPUT_VIEW(Int32, NPY_INT32, 1, field);
+	ENGINE_INPUT_VIEW(UInt32, NPY_UINT32, 1, field);
+	ENGINE_INPUT_VIEW(Short, NPY_INT16, 1, field);
+	ENGINE_INPUT_VIEW(UShort, NPY_UINT16, 1, field);
+	ENGINE_INPUT_VIEW(Vec2f, NPY_FLOAT32, 2, field);
+	ENGINE_INPUT_VIEW(Vec3f, NPY_FLOAT32, 3, field);
+	ENGINE_INPUT_VIEW(Vec4f, NPY_FLOAT32, 4, field);
+	ENGINE_INPUT_VIEW(Color, NPY_FLOAT32, 3, field);
+
+	return PyField::getFieldValue(field);
+}
+
+
+bool PyEngine::setOutputValue(SoField *field, PyObject *value)
+{
+	PyField::initNumpy();
+
+	ENGINE_OUTPUT_SET(Float, float, NPY_FLOAT32, 1, field, value);
+	ENGINE_OUTPUT_SET(Double, double, NPY_FLOAT64, 1, field, value);
+	ENGINE_OUTPUT_SET(Int32, int32_t, NPY_INT32, 1, field, value);
+	ENGINE_OUTPUT_SET(UInt32, uint32_t, NPY_UINT32, 1, field, value);
+	ENGINE_OUTPUT_SET(Short, short, NPY_INT16, 1, field, value);
+	ENGINE_OUTPUT_SET(UShort, unsigned short, NPY_UINT16, 1, field, value);
+	ENGINE_OUTPUT_SET(Vec2f, SbVec2f, NPY_FLOAT32, 2, field, value);
+	ENGINE_OUTPUT_SET(Vec3f, SbVec3f, NPY_FLOAT32, 3, field, value);
+	ENGINE_OUTPUT_SET(Vec4f, SbVec4f, NPY_FLOAT32, 4, field, value);
+	ENGINE_OUTPUT_SET(Color, SbColor, NPY_FLOAT32, 3, field, value);
+
+	PyField::setFieldValue(field, value);
+
+	return !PyErr_Occurred();
+}
+
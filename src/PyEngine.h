@@ -0,0 +1,36 @@
+/**
+ * \file
+ * \brief      PyEngine class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+
+class SoField;
+
+
+class PyEngine
+{
+public:
+	static PyTypeObject *getType();
+
+	// registers native engine class in SoDB, called from initSoDB()
+	static void initClass();
+
+	// helper methods for passing field values to and from evaluate functions
+	static PyObject *getInputValue(SoField *field);
+	static bool setOutputValue(SoField *field, PyObject *value);
+
+private:
+	// type implementations
+	static int tp_init(PySceneObject::Object *self, PyObject *args, PyObject *kwds);
+};
+
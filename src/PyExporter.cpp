@@ -0,0 +1,393 @@
+/**
+ * \file
+ * \brief      PyExporter class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include "PyExporter.h"
+#include <stdarg.h>
+#include <string.h>
+#include <float.h>
+#include <string>
+#include <vector>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+#pragma warning ( disable : 4996 ) // fopen and vsnprintf
+
+
+// buffers output and writes it to file in fixed size chunks
+class ChunkWriter
+{
+public:
+	ChunkWriter(FILE *file) : ok(true), file(file), used(0) { buffer.resize(256 * 1024); }
+	~ChunkWriter() { flush(); }
+
+	void write(const void *data, size_t size)
+	{
+		const char *ptr = (const char*) data;
+		while (size > 0)
+		{
+			size_t n = buffer.size() - used;
+			if (n > size) n = size;
+			memcpy(&buffer[used], ptr, n);
+			used += n;
+			ptr += n;
+			size -= n;
+			if (used == buffer.size()) flush();
+		}
+	}
+
+	void print(const char *format, ...)
+	{
+		char line[512];
+		va_list args;
+		va_start(args, format);
+		int n = vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		if (n <= 0) return;
+
+		if ((size_t) n < sizeof(line))
+		{
+			write(line, (size_t) n);
+		}
+		else
+		{
+			// long lines like file names are formatted again into heap buffer
+			std::vector<char> longLine((size_t) n + 1);
+			va_start(args, format);
+			vsnprintf(&longLine[0], longLine.size(), format, args);
+			va_end(args);
+			write(&longLine[0], (size_t) n);
+		}
+	}
+
+	bool flush()
+	{
+		if (used && (fwrite(&buffer[0], 1, used, file) != used)) ok = false;
+		used = 0;
+		return ok;
+	}
+
+	bool ok;
+
+private:
+	FILE *file;
+	std::vector<char> buffer;
+	size_t used;
+};
+
+
+static void appendJSON(std::string &json, const char *format, ...)
+{
+	char str[512];
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(str, sizeof(str), format, args);
+	va_end(args);
+	if (n <= 0) return;
+
+	if ((size_t) n < sizeof(str))
+	{
+		json.append(str, (size_t) n);
+	}
+	else
+	{
+		std::vector<char> longStr((size_t) n + 1);
+		va_start(args, format);
+		vsnprintf(&longStr[0], longStr.size(), format, args);
+		va_end(args);
+		json.append(&longStr[0], (size_t) n);
+	}
+}
+
+
+bool PyExporter::writeOBJ(FILE *file, const char *fileName, const PyGeometry::TriangleSoup &soup)
+{
+	// materials go into library next to OBJ file
+	std::string mtlName = fileName;
+	size_t dot = mtlName.find_last_of('.');
+	if ((dot != std::string::npos) && (mtlName.find_last_of("/\\") == std::string::npos || dot > mtlName.find_last_of("/\\")))
+	{
+		mtlName = mtlName.substr(0, dot);
+	}
+	mtlName += ".mtl";
+
+	FILE *mtlFile = fopen(mtlName.c_str(), "wb");
+	if (!mtlFile) return false;
+
+	{
+		ChunkWriter mtl(mtlFile);
+		for (size_t i = 0; i < soup.materials.size(); ++i)
+		{
+			const PyGeometry::Material &m = soup.materials[i];
+			mtl.print("newmtl material_%d\n", (int) i);
+			mtl.print("Ka %g %g %g\n", m.ambient[0], m.ambient[1], m.ambient[2]);
+			mtl.print("Kd %g %g %g\n", m.diffuse[0], m.diffuse[1], m.diffuse[2]);
+			mtl.print("Ks %g %g %g\n", m.specular[0], m.specular[1], m.specular[2]);
+			mtl.print("Ke %g %g %g\n", m.emissive[0], m.emissive[1], m.emissive[2]);
+			mtl.print("Ns %g\n", m.shininess * 128.f);
+			mtl.print("d %g\n\n", 1.f - m.transparency);
+		}
+		mtl.flush();
+		fclose(mtlFile);
+		if (!mtl.ok) return false;
+	}
+
+	ChunkWriter obj(file);
+	size_t slash = mtlName.find_last_of("/\\");
+	obj.print("# PyInventor export\n");
+	obj.print("mtllib %s\n", slash == std::string::npos ? mtlName.c_str() : mtlName.c_str() + slash + 1);
+
+	size_t numVertices = soup.vertices.size() / 3;
+	for (size_t i = 0; i < numVertices; ++i)
+	{
+		const float *v = &soup.vertices[i * 3];
+		obj.print("v %.7g %.7g %.7g\n", v[0], v[1], v[2]);
+	}
+	for (size_t i = 0; i < numVertices; ++i)
+	{
+		const float *n = &soup.normals[i * 3];
+		obj.print("vn %.5g %.5g %.5g\n", n[0], n[1], n[2]);
+	}
+
+	int32_t material = -1;
+	for (size_t i = 0; i < numVertices / 3; ++i)
+	{
+		if (soup.materialIds[i] != material)
+		{
+			material = soup.materialIds[i];
+			obj.print("usemtl material_%d\n", material);
+		}
+		unsigned long idx = (unsigned long) (i * 3 + 1);
+		obj.print("f %lu//%lu %lu//%lu %lu//%lu\n", idx, idx, idx + 1, idx + 1, idx + 2, idx + 2);
+	}
+
+	return obj.flush();
+}
+
+
+bool PyExporter::writePLY(FILE *file, const PyGeometry::TriangleSoup &soup)
+{
+	size_t numVertices = soup.vertices.size() / 3;
+	ChunkWriter ply(file);
+
+	ply.print("ply\n");
+	ply.print("format binary_little_endian 1.0\n");
+	ply.print("comment PyInventor export\n");
+	ply.print("element vertex %lu\n", (unsigned long) numVertices);
+	ply.print("property float x\nproperty float y\nproperty float z\n");
+	ply.print("property float nx\nproperty float ny\nproperty float nz\n");
+	ply.print("property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n");
+	ply.print("element face %lu\n", (unsigned long) (numVertices / 3));
+	ply.print("property list uchar int vertex_indices\n");
+	ply.print("end_header\n");
+
+	for (size_t i = 0; i < numVertices; ++i)
+	{
+		unsigned char rgba[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			float c = soup.colors[i * 4 + j];
+			rgba[j] = (unsigned char) (c <= 0.f ? 0 : (c >= 1.f ? 255 : c * 255.f + 0.5f));
+		}
+		ply.write(&soup.vertices[i * 3], 3 * sizeof(float));
+		ply.write(&soup.normals[i * 3], 3 * sizeof(float));
+		ply.write(rgba, sizeof(rgba));
+	}
+
+	for (size_t i = 0; i < numVertices / 3; ++i)
+	{
+		unsigned char n = 3;
+		int32_t idx[] = { (int32_t) (i * 3), (int32_t) (i * 3 + 1), (int32_t) (i * 3 + 2) };
+		ply.write(&n, 1);
+		ply.write(idx, sizeof(idx));
+	}
+
+	return ply.flush();
+}
+
+
+bool PyExporter::writeGLB(FILE *file, const PyGeometry::TriangleSoup &soup)
+{
+	size_t numTriangles = soup.shapeIds.size();
+	size_t numMaterials = soup.materials.size();
+
+	// one primitive per material, triangles are bucketed by material
+	std::vector<size_t> first(numMaterials + 1, 0), order(numTriangles);
+	for (size_t i = 0; i < numTriangles; ++i) first[soup.materialIds[i] + 1]++;
+	for (size_t m = 0; m < numMaterials; ++m) first[m + 1] += first[m];
+	std::vector<size_t> fill(first.begin(), first.end() - 1);
+	for (size_t i = 0; i < numTriangles; ++i) order[fill[soup.materialIds[i]]++] = i;
+
+	// JSON chunk describing buffer layout
+	std::string json;
+	appendJSON(json, "{\"asset\":{\"version\":\"2.0\",\"generator\":\"PyInventor\"},\"scene\":0,");
+	size_t binLength = numTriangles * 3 * 3 * sizeof(float) * 2;
+
+	if (numTriangles)
+	{
+		appendJSON(json, "\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],");
+		appendJSON(json, "\"buffers\":[{\"byteLength\":%lu}],", (unsigned long) binLength);
+
+		std::string bufferViews, accessors, primitives, materials;
+		size_t offset = 0;
+		int numPrimitives = 0;
+		for (size_t m = 0; m < numMaterials; ++m)
+		{
+			size_t count = (first[m + 1] - first[m]) * 3;
+			if (!count) continue;
+
+			float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (size_t t = first[m]; t < first[m + 1]; ++t)
+			{
+				const float *v = &soup.vertices[order[t] * 9];
+				for (int j = 0; j < 9; ++j)
+				{
+					if (v[j] < minPos[j % 3]) minPos[j % 3] = v[j];
+					if (v[j] > maxPos[j % 3]) maxPos[j % 3] = v[j];
+				}
+			}
+
+			// positions and normals each get a buffer view and an accessor
+			int accessor = 2 * numPrimitives++;
+			size_t length = count * 3 * sizeof(float);
+			appendJSON(bufferViews, "{\"buffer\":0,\"byteOffset\":%lu,\"byteLength\":%lu,\"target\":34962},", (unsigned long) offset, (unsigned long) length);
+			appendJSON(bufferViews, "{\"buffer\":0,\"byteOffset\":%lu,\"byteLength\":%lu,\"target\":34962},", (unsigned long) (offset + length), (unsigned long) length);
+			offset += 2 * length;
+
+			appendJSON(accessors, "{\"bufferView\":%d,\"componentType\":5126,\"count\":%lu,\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},",
+				accessor, (unsigned long) count, minPos[0], minPos[1], minPos[2], maxPos[0], maxPos[1], maxPos[2]);
+			appendJSON(accessors, "{\"bufferView\":%d,\"componentType\":5126,\"count\":%lu,\"type\":\"VEC3\"},", accessor + 1, (unsigned long) count);
+			appendJSON(primitives, "{\"attributes\":{\"POSITION\":%d,\"NORMAL\":%d},\"material\":%d,\"mode\":4},", accessor, accessor + 1, (int) m);
+		}
+
+		for (size_t m = 0; m < numMaterials; ++m)
+		{
+			const PyGeometry::Material &mat = soup.materials[m];
+			float alpha = 1.f - mat.transparency;
+			appendJSON(materials, "{\"name\":\"material_%d\",\"pbrMetallicRoughness\":{\"baseColorFactor\":[%g,%g,%g,%g],\"metallicFactor\":0,\"roughnessFactor\":%g},\"emissiveFactor\":[%g,%g,%g]%s},",
+				(int) m, mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], alpha, 1.f - mat.shininess,
+				mat.emissive[0], mat.emissive[1], mat.emissive[2], alpha < 1.f ? ",\"alphaMode\":\"BLEND\"" : "");
+		}
+
+		// strip trailing commas
+		bufferViews.resize(bufferViews.size() - 1);
+		accessors.resize(accessors.size() - 1);
+		primitives.resize(primitives.size() - 1);
+		materials.resize(materials.size() - 1);
+
+		json += "\"bufferViews\":[" + bufferViews + "],";
+		json += "\"accessors\":[" + accessors + "],";
+		json += "\"materials\":[" + materials + "],";
+		json += "\"meshes\":[{\"primitives\":[" + primitives + "]}]}";
+	}
+	else
+	{
+		appendJSON(json, "\"scenes\":[{\"nodes\":[]}]}");
+		binLength = 0;
+	}
+
+	while (json.size() % 4) json += ' ';
+
+	uint32_t header[3] = { 0x46546C67, 2, (uint32_t) (12 + 8 + json.size() + (binLength ? 8 + binLength : 0)) };
+	uint32_t jsonChunk[2] = { (uint32_t) json.size(), 0x4E4F534A };
+	uint32_t binChunk[2] = { (uint32_t) binLength, 0x004E4942 };
+
+	ChunkWriter glb(file);
+	glb.write(header, sizeof(header));
+	glb.write(jsonChunk, sizeof(jsonChunk));
+	glb.write(json.data(), json.size());
+
+	if (binLength)
+	{
+		glb.write(binChunk, sizeof(binChunk));
+		for (size_t m = 0; m < numMaterials; ++m)
+		{
+			for (size_t t = first[m]; t < first[m + 1]; ++t)
+			{
+				glb.write(&soup.vertices[order[t] * 9], 9 * sizeof(float));
+			}
+			for (size_t t = first[m]; t < first[m + 1]; ++t)
+			{
+				glb.write(&soup.normals[order[t] * 9], 9 * sizeof(float));
+			}
+		}
+	}
+
+	return glb.flush();
+}
+
+
+PyObject* PyExporter::export_geometry(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *applyTo = NULL;
+	char *fileName = NULL, *format = NULL;
+
+	static char *kwlist[] = { "applyTo", "file", "format", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "Os|z", kwlist, &applyTo, &fileName, &format))
+	{
+		return NULL;
+	}
+
+	// format defaults to file extension
+	std::string ext = format ? format : "";
+	if (ext.empty())
+	{
+		const char *dot = strrchr(fileName, '.');
+		if (dot) ext = dot + 1;
+	}
+	for (size_t i = 0; i < ext.size(); ++i) ext[i] = (char) tolower(ext[i]);
+
+	if ((ext != "obj") && (ext != "ply") && (ext != "glb"))
+	{
+		PyErr_SetString(PyExc_ValueError, "Unsupported export format (must be 'glb', 'ply' or 'obj')");
+		return NULL;
+	}
+
+	PyGeometry::TriangleSoup soup(ext == "ply", ext != "ply");
+	if (!PyGeometry::extractTriangles(applyTo, soup))
+	{
+		PyErr_SetString(PyExc_TypeError, "First argument must be a node or path");
+		return NULL;
+	}
+
+	FILE *file = fopen(fileName, "wb");
+	if (!file)
+	{
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError, fileName);
+	}
+
+	bool success = false;
+	if (ext == "obj")
+	{
+		success = writeOBJ(file, fileName, soup);
+	}
+	else if (ext == "ply")
+	{
+		success = writePLY(file, soup);
+	}
+	else
+	{
+		success = writeGLB(file, soup);
+	}
+	if (fclose(file) != 0)
+	{
+		success = false;
+	}
+
+	if (!success)
+	{
+		// errno is not reliably set by buffered writes
+		PyErr_Format(PyExc_IOError, "Failed to write '%s'", fileName);
+		return NULL;
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
@@ -0,0 +1,31 @@
+/**
+ * \file
+ * \brief      PyExporter class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PyGeometry.h"
+#include <stdio.h>
+
+
+class PyExporter
+{
+public:
+	// module functions
+	static PyObject* export_geometry(PyObject *self, PyObject *args, PyObject *kwds);
+
+private:
+	// writers for supported file formats
+	static bool writeOBJ(FILE *file, const char *fileName, const PyGeometry::TriangleSoup &soup);
+	static bool writePLY(FILE *file, const PyGeometry::TriangleSoup &soup);
+	static bool writeGLB(FILE *file, const PyGeometry::TriangleSoup &soup);
+};
+
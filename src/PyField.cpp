@@ -20,6 +20,8 @@
 #pragma warning ( disable : 4244 ) // possible loss of data when converting int to short in SbVec2s
 #pragma warning ( disable : 4267 ) // possible loss of data in GET/SET macros
 
+// numpy API table is shared by all modules and imported by initNumpy()
+#define PY_ARRAY_UNIQUE_SYMBOL PyInventor_ARRAY_API
 #include <numpy/arrayobject.h>
 #include <numpy/ndarrayobject.h>
 
@@ -191,6 +193,12 @@ PyTypeObject *PyField::getType()
             "Returns:\n"
             "    List of strings that are valid values for this field."
         },
+        { "__reduce__", (PyCFunction)reduce, METH_NOARGS,
+            "Returns state for pickling a field.\n"
+            "\n"
+            "A field is pickled as reference to its name in the pickled\n"
+            "field container.\n"
+        },
         {NULL}  /* Sentinel */
 	};
 
@@ -1116,3 +1124,26 @@ PyObject* PyField::get_enums(Object *self)
     Py_INCREF(Py_None);
     return Py_None;
 }
+
+
+PyObject* PyField::reduce(Object *self)
+{
+    if (self->field && self->field->getContainer())
+    {
+        SbName fieldName("");
+        if (self->field->getContainer()->getFieldName(self->field, fieldName))
+        {
+            PyObject *container = PySceneObject::createWrapper(self->field->getContainer());
+            PyObject *getter = PyObject_GetAttrString(container, "get_field");
+            Py_DECREF(container);
+            if (getter)
+            {
+                return Py_BuildValue("(N(s))", getter, fieldName.getString());
+            }
+            return NULL;
+        }
+    }
+
+    PyErr_SetString(PyExc_TypeError, "Field cannot be pickled");
+    return NULL;
+}
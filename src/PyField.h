@@ -63,5 +63,6 @@ private:
     static PyObject* get_type(Object *self);
     static PyObject* get_container(Object *self);
     static PyObject* get_enums(Object *self);
+    static PyObject* reduce(Object *self);
 };
 
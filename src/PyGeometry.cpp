@@ -0,0 +1,491 @@
+/**
+ * \file
+ * \brief      PyGeometry class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/SoPath.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+#include "PyGeometry.h"
+#include "PyField.h"
+#include "PyPath.h"
+#include "SoPointCloud.h"
+#define PY_ARRAY_UNIQUE_SYMBOL PyInventor_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/ndarrayobject.h>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+
+
+// macro for setting multi-field from numpy array, buffer is adopted by field if it is
+// a private writeable copy, because later edits of the field write into it
+#define MESH_FIELD_COPY(field, ct, num, arr) { (field).setNum(num); (field).setValues(0, num, (const ct *) PyArray_DATA((PyArrayObject*) arr)); }
+#if defined(__COIN__) || defined(TGS_VERSION)
+#define MESH_FIELD_SET(node, field, ct, num, arr, obj) { \
+	if (((PyObject*) (arr) != (obj)) && PyArray_CHKFLAGS((PyArrayObject*) (arr), NPY_ARRAY_OWNDATA | NPY_ARRAY_WRITEABLE)) \
+		{ (field).setValuesPointer(num, (ct *) PyArray_DATA((PyArrayObject*) arr)); PySceneObject::keepAlive(node, arr); } \
+	else MESH_FIELD_COPY(field, ct, num, arr) }
+#else
+#define MESH_FIELD_SET(node, field, ct, num, arr, obj) MESH_FIELD_COPY(field, ct, num, arr)
+#endif
+
+
+PyGeometry::TriangleSoup::TriangleSoup(bool perVertexColors, bool perTriangleMaterials) : withColors(perVertexColors), withMaterials(perTriangleMaterials), hasMatrix(false)
+{
+	// start with room for a moderately sized mesh, vectors grow geometrically
+	vertices.reserve(3 * 3 * 4096);
+	normals.reserve(3 * 3 * 4096);
+	shapeIds.reserve(4096);
+	if (withColors) colors.reserve(3 * 4 * 4096);
+	if (withMaterials) materialIds.reserve(4096);
+}
+
+
+void PyGeometry::triangleCB(void *userdata, SoCallbackAction *action, const SoPrimitiveVertex *v1, const SoPrimitiveVertex *v2, const SoPrimitiveVertex *v3)
+{
+	TriangleSoup *soup = (TriangleSoup*) userdata;
+
+	// normals are transformed with inverse transpose, which is only
+	// recomputed when the model matrix changes
+	const SbMatrix &model = action->getModelMatrix();
+	if (!soup->hasMatrix || (soup->modelMatrix != model))
+	{
+		soup->modelMatrix = model;
+		soup->normalMatrix = model.inverse().transpose();
+		soup->hasMatrix = true;
+	}
+
+	SoNode *shape = (SoNode*) action->getCurPathTail();
+	std::map<SoNode*, int32_t>::iterator it = soup->shapeMap.find(shape);
+	int32_t shapeId = 0;
+	if (it == soup->shapeMap.end())
+	{
+		shapeId = (int32_t) soup->shapes.size();
+		soup->shapeMap[shape] = shapeId;
+		soup->shapes.push_back(shape);
+	}
+	else
+	{
+		shapeId = it->second;
+	}
+	soup->shapeIds.push_back(shapeId);
+
+	if (soup->withMaterials)
+	{
+		// material of first vertex applies to whole triangle
+		Material m;
+		SbColor ambient, diffuse, specular, emissive;
+		action->getMaterial(ambient, diffuse, specular, emissive, m.shininess, m.transparency, v1->getMaterialIndex());
+		for (int i = 0; i < 3; ++i)
+		{
+			m.ambient[i] = ambient[i];
+			m.diffuse[i] = diffuse[i];
+			m.specular[i] = specular[i];
+			m.emissive[i] = emissive[i];
+		}
+
+		// few distinct materials are expected, so search starts with last match
+		int32_t materialId = -1;
+		int32_t last = soup->materialIds.empty() ? 0 : soup->materialIds.back();
+		if (!soup->materials.empty() && !memcmp(&soup->materials[last], &m, sizeof(Material)))
+		{
+			materialId = last;
+		}
+		for (size_t i = 0; (materialId < 0) && (i < soup->materials.size()); ++i)
+		{
+			if (!memcmp(&soup->materials[i], &m, sizeof(Material))) materialId = (int32_t) i;
+		}
+		if (materialId < 0)
+		{
+			materialId = (int32_t) soup->materials.size();
+			soup->materials.push_back(m);
+		}
+		soup->materialIds.push_back(materialId);
+	}
+
+	const SoPrimitiveVertex *v[] = { v1, v2, v3 };
+	for (int i = 0; i < 3; ++i)
+	{
+		SbVec3f p, n;
+		soup->modelMatrix.multVecMatrix(v[i]->getPoint(), p);
+		soup->normalMatrix.multDirMatrix(v[i]->getNormal(), n);
+		n.normalize();
+
+		soup->vertices.insert(soup->vertices.end(), p.getValue(), p.getValue() + 3);
+		soup->normals.insert(soup->normals.end(), n.getValue(), n.getValue() + 3);
+
+		if (soup->withColors)
+		{
+			SbColor ambient, diffuse, specular, emission;
+			float shininess = 0.f, transparency = 0.f;
+			action->getMaterial(ambient, diffuse, specular, emission, shininess, transparency, v[i]->getMaterialIndex());
+			soup->colors.insert(soup->colors.end(), diffuse.getValue(), diffuse.getValue() + 3);
+			soup->colors.push_back(1.f - transparency);
+		}
+	}
+}
+
+
+bool PyGeometry::extractTriangles(PyObject *applyTo, TriangleSoup &soup_out)
+{
+	SoCallbackAction ca;
+	ca.addTriangleCallback(SoShape::getClassTypeId(), triangleCB, &soup_out);
+
+	if (PyNode_Check(applyTo))
+	{
+		SoNode *node = (SoNode*) ((PySceneObject::Object *) applyTo)->inventorObject;
+		if (node)
+		{
+			ca.apply(node);
+			return true;
+		}
+	}
+	else if (PyObject_TypeCheck(applyTo, PyPath::getType()))
+	{
+		SoPath *path = PyPath::getInstance(applyTo);
+		if (path)
+		{
+			ca.apply(path);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+PyObject* PyGeometry::extract_triangles(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *applyTo = NULL;
+	int colors = 0;
+
+	static char *kwlist[] = { "applyTo", "colors", NULL};
+	if (PyArg_ParseTupleAndKeywords(args, kwds, "O|p", kwlist, &applyTo, &colors))
+	{
+		TriangleSoup soup(colors != 0);
+		if (extractTriangles(applyTo, soup))
+		{
+			int numVertices = (int) (soup.vertices.size() / 3);
+			static const float empty[4] = { 0.f, 0.f, 0.f, 0.f };
+
+			PyObject *shapes = PyList_New(soup.shapes.size());
+			for (size_t i = 0; i < soup.shapes.size(); ++i)
+			{
+				PyList_SetItem(shapes, i, PySceneObject::createWrapper(soup.shapes[i]));
+			}
+
+			return Py_BuildValue("(NNNNN)",
+				PyField::getPyObjectArrayFromData(NPY_FLOAT32, numVertices ? &soup.vertices[0] : empty, numVertices, 3),
+				PyField::getPyObjectArrayFromData(NPY_FLOAT32, numVertices ? &soup.normals[0] : empty, numVertices, 3),
+				soup.withColors ? PyField::getPyObjectArrayFromData(NPY_FLOAT32, numVertices ? &soup.colors[0] : empty, numVertices, 4) : (Py_INCREF(Py_None), Py_None),
+				PyField::getPyObjectArrayFromData(NPY_INT32, soup.shapeIds.size() ? &soup.shapeIds[0] : (const int32_t*) empty, (int) soup.shapeIds.size()),
+				shapes);
+		}
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+PyObject *PyGeometry::getArray(PyObject *obj, int type, int numComponents, const char *name)
+{
+	// returns contiguous array of given type with shape (N, numComponents)
+	// or (N) if numComponents is zero, which is the same instance as obj if
+	// no conversion is needed
+	PyArrayObject *arr = (PyArrayObject*) PyArray_FROM_OTF(obj, type, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+	if (arr)
+	{
+		if ((numComponents == 0) ? (PyArray_NDIM(arr) == 1) : ((PyArray_NDIM(arr) == 2) && (PyArray_DIM(arr, 1) == numComponents)))
+		{
+			return (PyObject*) arr;
+		}
+
+		Py_DECREF(arr);
+		PyErr_Format(PyExc_ValueError, numComponents ? "%s must have shape (N, %d)" : "%s must be one-dimensional", name, numComponents);
+	}
+
+	return NULL;
+}
+
+
+PyObject *PyGeometry::getPackedColors(PyObject *obj)
+{
+	// packed RGBA values are used as is, float and byte colors are converted
+	PyArrayObject *arr = (PyArrayObject*) PyArray_FROM_OF(obj, NPY_ARRAY_IN_ARRAY);
+	if (!arr) return NULL;
+
+	if ((PyArray_NDIM(arr) == 1) && (PyArray_TYPE(arr) == NPY_UINT32))
+	{
+		return (PyObject*) arr;
+	}
+
+	int nc = (PyArray_NDIM(arr) == 2) ? (int) PyArray_DIM(arr, 1) : 0;
+	if ((nc != 3) && (nc != 4))
+	{
+		Py_DECREF(arr);
+		PyErr_SetString(PyExc_ValueError, "colors must have shape (N, 3) or (N, 4), or contain packed RGBA values");
+		return NULL;
+	}
+
+	bool isByte = (PyArray_TYPE(arr) == NPY_UINT8);
+	PyArrayObject *src = (PyArrayObject*) PyArray_FROM_OTF((PyObject*) arr, isByte ? NPY_UINT8 : NPY_FLOAT32, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+	Py_DECREF(arr);
+	if (!src) return NULL;
+
+	npy_intp num = PyArray_DIM(src, 0);
+	PyArrayObject *packed = (PyArrayObject*) PyArray_SimpleNew(1, &num, NPY_UINT32);
+	if (packed)
+	{
+		uint32_t *dst = (uint32_t*) PyArray_DATA(packed);
+		for (npy_intp i = 0; i < num; ++i)
+		{
+			uint32_t c[4] = { 0, 0, 0, 255 };
+			for (int j = 0; j < nc; ++j)
+			{
+				if (isByte)
+				{
+					c[j] = ((const unsigned char*) PyArray_DATA(src))[i * nc + j];
+				}
+				else
+				{
+					float f = ((const float*) PyArray_DATA(src))[i * nc + j];
+					c[j] = f <= 0.f ? 0 : (f >= 1.f ? 255 : (uint32_t) (f * 255.f + 0.5f));
+				}
+			}
+			dst[i] = (c[0] << 24) | (c[1] << 16) | (c[2] << 8) | c[3];
+		}
+	}
+	Py_DECREF(src);
+
+	return (PyObject*) packed;
+}
+
+
+PyObject* PyGeometry::mesh(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *verticesObj = NULL, *facesObj = NULL, *normalsObj = NULL, *colorsObj = NULL, *uvsObj = NULL;
+
+	static char *kwlist[] = { "vertices", "faces", "normals", "colors", "uvs", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|OOO", kwlist, &verticesObj, &facesObj, &normalsObj, &colorsObj, &uvsObj))
+	{
+		return NULL;
+	}
+
+	if (!PyField::initNumpy())
+	{
+		return NULL;
+	}
+
+	PyObject *vertices = getArray(verticesObj, NPY_FLOAT32, 3, "vertices");
+	if (!vertices) return NULL;
+
+	// faces are either (M, K) polygons or flat indices with -1 terminators
+	PyArrayObject *faces = (PyArrayObject*) PyArray_FROM_OTF(facesObj, NPY_INT32, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+	if (!faces || ((PyArray_NDIM(faces) != 1) && (PyArray_NDIM(faces) != 2)))
+	{
+		Py_XDECREF(faces);
+		Py_DECREF(vertices);
+		if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "faces must have shape (M, K) or be one-dimensional");
+		return NULL;
+	}
+
+	PyObject *normals = NULL, *colors = NULL, *uvs = NULL;
+	if (normalsObj && (normalsObj != Py_None)) normals = getArray(normalsObj, NPY_FLOAT32, 3, "normals");
+	if (colorsObj && (colorsObj != Py_None) && !PyErr_Occurred()) colors = getPackedColors(colorsObj);
+	if (uvsObj && (uvsObj != Py_None) && !PyErr_Occurred()) uvs = getArray(uvsObj, NPY_FLOAT32, 2, "uvs");
+	if (PyErr_Occurred())
+	{
+		Py_DECREF(vertices);
+		Py_DECREF(faces);
+		Py_XDECREF(normals);
+		Py_XDECREF(colors);
+		Py_XDECREF(uvs);
+		return NULL;
+	}
+
+	int numVertices = (int) PyArray_DIM((PyArrayObject*) vertices, 0);
+	int numFaces = 0;
+	int32_t maxIndex = -1;
+
+	SoIndexedFaceSet *faceSet = new SoIndexedFaceSet();
+	SoVertexProperty *vertexProperty = new SoVertexProperty();
+	faceSet->ref();
+	faceSet->vertexProperty.setValue(vertexProperty);
+
+	if (PyArray_NDIM(faces) == 2)
+	{
+		// write indices with terminators directly into field storage
+		int numPolygons = (int) PyArray_DIM(faces, 0), k = (int) PyArray_DIM(faces, 1);
+		const int32_t *src = (const int32_t*) PyArray_DATA(faces);
+		faceSet->coordIndex.setNum(numPolygons * (k + 1));
+		int32_t *dst = faceSet->coordIndex.startEditing();
+		for (int i = 0; i < numPolygons; ++i)
+		{
+			for (int j = 0; j < k; ++j)
+			{
+				int32_t idx = *src++;
+				if (idx > maxIndex) maxIndex = idx;
+				if (idx < 0) maxIndex = numVertices;
+				*dst++ = idx;
+			}
+			*dst++ = -1;
+		}
+		faceSet->coordIndex.finishEditing();
+		numFaces = numPolygons;
+	}
+	else
+	{
+		int num = (int) PyArray_DIM(faces, 0);
+		const int32_t *src = (const int32_t*) PyArray_DATA(faces);
+		for (int i = 0; i < num; ++i)
+		{
+			if (src[i] > maxIndex) maxIndex = src[i];
+			if (src[i] < -1) maxIndex = numVertices;
+			if ((src[i] == -1) || (i == num - 1)) numFaces++;
+		}
+		if (maxIndex < numVertices)
+		{
+			MESH_FIELD_SET(faceSet, faceSet->coordIndex, int32_t, num, (PyObject*) faces, facesObj);
+		}
+	}
+	Py_DECREF(faces);
+
+	PyObject *result = NULL;
+	if (maxIndex >= numVertices)
+	{
+		PyErr_SetString(PyExc_ValueError, "faces contain indices outside of vertex range");
+	}
+	else if ((normals && (PyArray_DIM((PyArrayObject*) normals, 0) != numVertices) && (PyArray_DIM((PyArrayObject*) normals, 0) != numFaces)) ||
+		(colors && (PyArray_DIM((PyArrayObject*) colors, 0) != numVertices) && (PyArray_DIM((PyArrayObject*) colors, 0) != numFaces)))
+	{
+		PyErr_SetString(PyExc_ValueError, "number of normals and colors must match number of vertices or faces");
+	}
+	else if (uvs && (PyArray_DIM((PyArrayObject*) uvs, 0) != numVertices))
+	{
+		PyErr_SetString(PyExc_ValueError, "number of uvs must match number of vertices");
+	}
+	else
+	{
+		MESH_FIELD_SET(vertexProperty, vertexProperty->vertex, SbVec3f, numVertices, vertices, verticesObj);
+
+		if (normals)
+		{
+			int num = (int) PyArray_DIM((PyArrayObject*) normals, 0);
+			MESH_FIELD_SET(vertexProperty, vertexProperty->normal, SbVec3f, num, normals, normalsObj);
+			vertexProperty->normalBinding = (num == numVertices) ? SoVertexProperty::PER_VERTEX_INDEXED : SoVertexProperty::PER_FACE;
+		}
+
+		if (colors)
+		{
+			int num = (int) PyArray_DIM((PyArrayObject*) colors, 0);
+			MESH_FIELD_SET(vertexProperty, vertexProperty->orderedRGBA, uint32_t, num, colors, colorsObj);
+			vertexProperty->materialBinding = (num == numVertices) ? SoVertexProperty::PER_VERTEX_INDEXED : SoVertexProperty::PER_FACE;
+		}
+
+		if (uvs)
+		{
+			MESH_FIELD_SET(vertexProperty, vertexProperty->texCoord, SbVec2f, numVertices, uvs, uvsObj);
+		}
+
+		result = PySceneObject::createWrapper(faceSet);
+	}
+
+	Py_DECREF(vertices);
+	Py_XDECREF(normals);
+	Py_XDECREF(colors);
+	Py_XDECREF(uvs);
+	faceSet->unref();
+
+	return result;
+}
+
+
+PyObject* PyGeometry::point_cloud(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *pointsObj = NULL, *colorsObj = NULL;
+	const char *file = NULL;
+	int nodePoints = 20000;
+
+	static char *kwlist[] = { "points", "colors", "file", "node_points", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|Ozi", kwlist, &pointsObj, &colorsObj, &file, &nodePoints))
+	{
+		return NULL;
+	}
+
+	if (!PyField::initNumpy())
+	{
+		return NULL;
+	}
+
+	PyObject *points = getArray(pointsObj, NPY_FLOAT32, 3, "points");
+	if (!points) return NULL;
+
+	PyObject *colors = NULL;
+	if (colorsObj && (colorsObj != Py_None)) colors = getPackedColors(colorsObj);
+
+	size_t numPoints = (size_t) PyArray_DIM((PyArrayObject*) points, 0);
+	if (!PyErr_Occurred() && ((uint64_t) numPoints > (uint64_t) UINT32_MAX))
+	{
+		// octree building indexes points with 32-bit integers
+		PyErr_SetString(PyExc_ValueError, "point_cloud supports at most 2^32 - 1 points");
+	}
+	if (PyErr_Occurred() || (colors && ((size_t) PyArray_DIM((PyArrayObject*) colors, 0) != numPoints)))
+	{
+		if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "colors must have one entry per point");
+		Py_DECREF(points);
+		Py_XDECREF(colors);
+		return NULL;
+	}
+
+	// packed colors are unpacked to RGBA bytes as expected by glColorPointer
+	std::vector<unsigned char> rgba(colors ? numPoints * 4 : 0);
+	const uint32_t *packed = colors ? (const uint32_t*) PyArray_DATA((PyArrayObject*) colors) : NULL;
+	for (size_t i = 0; i < rgba.size() / 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j) rgba[i * 4 + j] = (unsigned char) ((packed[i] >> (24 - j * 8)) & 0xff);
+	}
+
+	SoPointCloud::Octree *octree = SoPointCloud::build((const float*) PyArray_DATA((PyArrayObject*) points), colors ? rgba.data() : NULL, numPoints, nodePoints);
+	Py_DECREF(points);
+	Py_XDECREF(colors);
+
+	if (file)
+	{
+		// written octree is streamed from file, points in memory are released
+		bool written = SoPointCloud::write(octree, file);
+		SoPointCloud::destroy(octree);
+		octree = NULL;
+		if (!written)
+		{
+			PyErr_Format(PyExc_IOError, "Cannot write point cloud file %s", file);
+			return NULL;
+		}
+	}
+
+	SoPointCloud *pointCloud = new SoPointCloud();
+	pointCloud->ref();
+	if (octree)
+	{
+		pointCloud->setOctree(octree);
+	}
+	else
+	{
+		pointCloud->filename.setValue(file);
+	}
+
+	PyObject *result = PySceneObject::createWrapper(pointCloud);
+	pointCloud->unref();
+
+	return result;
+}
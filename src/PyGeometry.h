@@ -0,0 +1,68 @@
+/**
+ * \file   
+ * \brief      PyGeometry class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+#include <Inventor/SbLinear.h>
+#include <vector>
+#include <map>
+
+class SoNode;
+class SoCallbackAction;
+class SoPrimitiveVertex;
+
+
+class PyGeometry
+{
+public:
+	// material properties as collected from traversal state
+	struct Material
+	{
+		float ambient[3], diffuse[3], specular[3], emissive[3];
+		float shininess, transparency;
+	};
+
+	// triangles of a scene with vertex attributes in world space
+	struct TriangleSoup
+	{
+		TriangleSoup(bool withColors = false, bool withMaterials = false);
+
+		std::vector<float> vertices;
+		std::vector<float> normals;
+		std::vector<float> colors;
+		std::vector<int32_t> shapeIds;
+		std::vector<SoNode*> shapes;
+		std::vector<int32_t> materialIds;
+		std::vector<Material> materials;
+		bool withColors, withMaterials;
+
+		// traversal state
+		std::map<SoNode*, int32_t> shapeMap;
+		SbMatrix modelMatrix, normalMatrix;
+		bool hasMatrix;
+	};
+
+	// helper method for collecting triangles from node or path
+	static bool extractTriangles(PyObject *applyTo, TriangleSoup &soup_out);
+
+	// module functions
+	static PyObject* extract_triangles(PyObject *self, PyObject *args, PyObject *kwds);
+	static PyObject* mesh(PyObject *self, PyObject *args, PyObject *kwds);
+	static PyObject* point_cloud(PyObject *self, PyObject *args, PyObject *kwds);
+
+private:
+	static PyObject *getArray(PyObject *obj, int type, int numComponents, const char *name);
+	static PyObject *getPackedColors(PyObject *obj);
+	static void triangleCB(void *userdata, SoCallbackAction *action, const SoPrimitiveVertex *v1, const SoPrimitiveVertex *v2, const SoPrimitiveVertex *v3);
+};
+
@@ -19,6 +19,7 @@
 #include <Inventor/actions/SoGLRenderAction.h>
 #include <Inventor/actions/SoGetMatrixAction.h>
 #include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoComplexity.h>
 #include <Inventor/SoInput.h>
 #include <Inventor/SoOffscreenRenderer.h>
 #include <Inventor/engines/SoGate.h>
@@ -31,43 +32,169 @@
 #include "PyEngineOutput.h"
 #include "PyPath.h"
 #include "PyNodekitCatalog.h"
+#include "PySharedScene.h"
+#include "PyGeometry.h"
+#include "PyExporter.h"
+#include "PyChangeLog.h"
+#include "PyEngine.h"
+#include "PyProfiler.h"
+#include "PyOptimizer.h"
+#include "PySimplifier.h"
+#include "PyIsosurface.h"
+#include "PyMeshTools.h"
+#define PY_ARRAY_UNIQUE_SYMBOL PyInventor_ARRAY_API
+#define NO_IMPORT_ARRAY
 #include <numpy/ndarrayobject.h>
 #include <set>
 
 
 #ifndef _WIN32
 #include <unistd.h>
+#include <fcntl.h>
 #else
 #include <Windows.h> // for Sleep()
 #endif
 
 
+// pipe signaled whenever sensors get scheduled, allows hosts to wait on it
+static int wakeupPipe[2] = { -1, -1 };
+
+
+static void sensorQueueChangedCB(void * /*data*/)
+{
+	#ifndef _WIN32
+	if (wakeupPipe[1] >= 0)
+	{
+		char c = 0;
+		ssize_t n = write(wakeupPipe[1], &c, 1); // pipe being full is fine
+		(void) n;
+	}
+	#endif
+}
+
+
+static void clearWakeup()
+{
+	#ifndef _WIN32
+	if (wakeupPipe[0] >= 0)
+	{
+		char buf[256];
+		while (read(wakeupPipe[0], buf, sizeof(buf)) > 0) {}
+	}
+	#endif
+}
+
+
+static double getNextTimeout()
+{
+	// returns seconds until next sensor is due or negative value if nothing is scheduled
+	SoSensorManager *sensorManager = SoDB::getSensorManager();
+	if (sensorManager->isDelaySensorPending() || PyChangeLog::isPending())
+	{
+		return 0.;
+	}
+
+	SbTime tm;
+	if (sensorManager->isTimerSensorPending(tm))
+	{
+		double timeout = (tm - SbTime::getTimeOfDay()).getValue();
+		return timeout > 0. ? timeout : 0.;
+	}
+
+	return -1.;
+}
+
+
 static PyObject* iv_process_queues(PyObject * /*self*/, PyObject * args)
 {
+	PyProfiler::TraceScope trace("inventor.process_queues");
+
 	PySceneObject::initSoDB();
 
-	int idle = true;
-	if (PyArg_ParseTuple(args, "|p", &idle))
+	int idle = true, wait = true;
+	if (PyArg_ParseTuple(args, "|pp", &idle, &wait))
 	{
+		clearWakeup();
 		SoDB::getSensorManager()->processTimerQueue();
 		SoDB::getSensorManager()->processDelayQueue(idle ? TRUE : FALSE);
-		if (idle)
+		PyChangeLog::processAll();
+		if (idle && wait)
+		{
+			// sleep until next timer is due, but no longer than 10 ms
+			double timeout = getNextTimeout();
+			if ((timeout < 0.) || (timeout > 0.01)) timeout = 0.01;
+			if (timeout > 0.)
+			{
+				#ifndef _WIN32
+				usleep((useconds_t) (timeout * 1000000.));
+				#else
+				::Sleep((DWORD) (timeout * 1000.));
+				#endif
+			}
+		}
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+static PyObject* iv_next_timeout(PyObject * /*self*/, PyObject * /*args*/)
+{
+	PyProfiler::TraceScope trace("inventor.next_timeout");
+
+	PySceneObject::initSoDB();
+	clearWakeup();
+
+	double timeout = getNextTimeout();
+	if (timeout >= 0.)
+	{
+		return PyFloat_FromDouble(timeout);
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+static PyObject* iv_wakeup_fd(PyObject * /*self*/, PyObject * /*args*/)
+{
+	PyProfiler::TraceScope trace("inventor.wakeup_fd");
+
+	PySceneObject::initSoDB();
+
+	#ifndef _WIN32
+	if (wakeupPipe[0] < 0)
+	{
+		if (pipe(wakeupPipe) == 0)
 		{
-			#ifndef _WIN32
-			usleep(10000);
-			#else
-			::Sleep(10);
-			#endif
+			for (int i = 0; i < 2; ++i)
+			{
+				fcntl(wakeupPipe[i], F_SETFL, fcntl(wakeupPipe[i], F_GETFL) | O_NONBLOCK);
+				fcntl(wakeupPipe[i], F_SETFD, FD_CLOEXEC);
+			}
+			SoDB::getSensorManager()->setChangedCallback(sensorQueueChangedCB, NULL);
+			PyChangeLog::setChangedCallback(sensorQueueChangedCB, NULL);
+		}
+		else
+		{
+			wakeupPipe[0] = wakeupPipe[1] = -1;
+			return PyErr_SetFromErrno(PyExc_OSError);
 		}
 	}
 
+	return PyLong_FromLong(wakeupPipe[0]);
+	#else
 	Py_INCREF(Py_None);
 	return Py_None;
+	#endif
 }
 
 
 static PyObject* iv_create_classes(PyObject *self, PyObject * /*args*/)
 {
+	PyProfiler::TraceScope trace("inventor.create_classes");
+
 	PySceneObject::initSoDB();
     std::set<SbName> sCreatedWrappers;
 
@@ -94,6 +221,8 @@ static PyObject* iv_create_classes(PyObject *self, PyObject * /*args*/)
 
 PyObject* iv_classes(PyObject * /*self*/, PyObject *args)
 {
+	PyProfiler::TraceScope trace("inventor.classes");
+
 	char *baseTypeName = 0;
 	if (PyArg_ParseTuple(args, "|s", &baseTypeName))
 	{
@@ -134,6 +263,8 @@ PyObject* iv_classes(PyObject * /*self*/, PyObject *args)
 
 PyObject* iv_create_object(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 {
+	PyProfiler::TraceScope trace("inventor.create_object");
+
     SoFieldContainer *inventorObject = NULL;
     char *type = NULL, *name = NULL, *init = NULL;
     PyObject *pointer = NULL;
@@ -208,35 +339,59 @@ PyObject* iv_create_object(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 
 PyObject* iv_read(PyObject * /*self*/, PyObject *args)
 {
-	char *iv = 0;
-	if (PyArg_ParseTuple(args, "s", &iv))
+	PyProfiler::TraceScope trace("inventor.read");
+
+	PyObject *data = 0;
+	if (PyArg_ParseTuple(args, "O", &data))
 	{
-		if (iv)
+		if (PyBytes_Check(data))
 		{
-			SbBool success = TRUE;
-			SoInput in;
-			if (iv[0] == '#')
+			// binary or ascii buffer containing a single root node
+			SoNode *node = PySceneObject::readBuffer(data);
+			if (node)
 			{
-				in.setBuffer(iv, strlen(iv));
+				return PySceneObject::createWrapper(node);
 			}
-			else
+		}
+		else if (PyUnicode_Check(data))
+		{
+			const char *iv = PyUnicode_AsUTF8(data);
+			if (iv)
 			{
-				success = in.openFile(iv);
-			}
+				SbBool success = TRUE;
+				SoInput in;
+				if (iv[0] == '#')
+				{
+					in.setBuffer((void*) iv, strlen(iv));
+				}
+				else
+				{
+					success = in.openFile(iv);
+				}
 
-			if (success)
-			{
-				SoSeparator *root = SoDB::readAll(&in);
-				if (root)
+				if (success)
 				{
-					PyObject *scene = PySceneObject::createWrapper(root);
-					if (scene)
+					SoSeparator *root = SoDB::readAll(&in);
+					if (root)
 					{
-						return scene;
+						PyObject *scene = PySceneObject::createWrapper(root);
+						if (scene)
+						{
+							return scene;
+						}
 					}
 				}
 			}
 		}
+		else
+		{
+			PyErr_SetString(PyExc_TypeError, "read() expects a str or bytes object");
+			return NULL;
+		}
+	}
+	else
+	{
+		return NULL;
 	}
 
 	Py_INCREF(Py_None);
@@ -246,11 +401,14 @@ PyObject* iv_read(PyObject * /*self*/, PyObject *args)
 
 PyObject* iv_write(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 {
+	PyProfiler::TraceScope trace("inventor.write");
+
 	PyObject *applyTo = NULL;
 	char *fileName = NULL;
-	static char *kwlist[] = { "applyTo", "file", NULL};
+	int binary = 0;
+	static char *kwlist[] = { "applyTo", "file", "binary", NULL};
     
-	if (PyArg_ParseTupleAndKeywords(args, kwds, "O|s", kwlist, &applyTo, &fileName))
+	if (PyArg_ParseTupleAndKeywords(args, kwds, "O|zp", kwlist, &applyTo, &fileName, &binary))
 	{
 		if (PyNode_Check(applyTo))
 		{
@@ -261,26 +419,15 @@ PyObject* iv_write(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 				{
 					SoOutput out;
 					out.openFile(fileName);
+					out.setBinary(binary ? TRUE : FALSE);
 					SoWriteAction wa(&out);
 					wa.apply((SoNode*) sceneObj->inventorObject);
 				}
 				else
 				{
-					void *buffer = malloc(1024 * 1024);
-					SoOutput out;
-					out.setBuffer(buffer, 1024 * 1024, realloc);
-					SoWriteAction wa(&out);
-					wa.apply((SoNode*) sceneObj->inventorObject);
-
-					#ifdef getBuffer
-					#undef getBuffer
-					#endif
-					size_t n = 0;
-					if (out.getBuffer(buffer, n))
+					PyObject *s = PySceneObject::writeBuffer((SoNode*) sceneObj->inventorObject, binary != 0);
+					if (s)
 					{
-						PyObject *s = PyUnicode_FromStringAndSize((const char*) buffer, n);
-						free(buffer);
-
 						return s;
 					}
 				}
@@ -295,6 +442,8 @@ PyObject* iv_write(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 
 PyObject* iv_search(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 {
+	PyProfiler::TraceScope trace("inventor.search");
+
 	PyObject *applyTo = NULL, *node = NULL;
 	char *type = NULL, *name = NULL;
 	int searchAll = false, first = true;
@@ -346,6 +495,8 @@ PyObject* iv_search(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 
 PyObject* iv_pick(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 {
+	PyProfiler::TraceScope trace("inventor.pick");
+
 	PyObject *applyTo = NULL;
 	int pickAll = 0; // don't use bool, crashes on OS X / clang
 	int x = -1, y = -1, width = -1, height = -1;
@@ -433,6 +584,8 @@ PyObject* iv_pick(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 
 PyObject* iv_get_matrix(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 {
+	PyProfiler::TraceScope trace("inventor.get_matrix");
+
 	PyObject *applyTo = NULL;
 
 	static char *kwlist[] = { "applyTo", NULL};
@@ -470,6 +623,8 @@ PyObject* iv_get_matrix(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 
 PyObject* iv_render_buffer(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 {
+	PyProfiler::TraceScope trace("inventor.render_buffer");
+
 	// keep reusing same instance once created
 	static SoOffscreenRenderer *offscreenRenderer = 0;
 
@@ -477,9 +632,10 @@ PyObject* iv_render_buffer(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 	int width = -1, height = -1, components = 4;
 	char *file = NULL;
 	PyObject *background = 0;
-	static char *kwlist[] = { "applyTo", "width", "height", "components", "file", "background", NULL};
+	int quality = 0;
+	static char *kwlist[] = { "applyTo", "width", "height", "components", "file", "background", "quality", NULL};
 
-	if (PyArg_ParseTupleAndKeywords(args, kwds, "O|iiisO", kwlist, &applyTo, &width, &height, &components, &file, &background))
+	if (PyArg_ParseTupleAndKeywords(args, kwds, "O|iiisOi", kwlist, &applyTo, &width, &height, &components, &file, &background, &quality))
 	{
 		// if scene manager then use scene node and viewport size from there if undefined
 		int vpWidth = -1, vpHeight = -1;
@@ -519,16 +675,38 @@ PyObject* iv_render_buffer(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 					offscreenRenderer->setComponents(c);
 				}
 
+				// reduced quality pass renders scene below overriding complexity node
+				SoNode *scene = (SoNode*) sceneObj->inventorObject;
+				SoSeparator *qualityRoot = 0;
+				if (quality > 0)
+				{
+					SoComplexity *complexity = new SoComplexity();
+					complexity->setOverride(TRUE);
+					PySceneManager::setQualityComplexity(complexity, quality);
+					qualityRoot = new SoSeparator();
+					qualityRoot->ref();
+					qualityRoot->addChild(complexity);
+					qualityRoot->addChild(scene);
+					scene = qualityRoot;
+				}
+
 				// configure background color
 				PySceneManager::getBackgroundFromObject(background, backgroundColor, &gradientBackground);
 				offscreenRenderer->setBackgroundColor(backgroundColor);
 				if (gradientBackground)
 				{
-					gradientBackground->addChild((SoNode*) sceneObj->inventorObject);
+					gradientBackground->addChild(scene);
 				}
 
 				// render scene
-				if (offscreenRenderer->render(gradientBackground ? gradientBackground : (SoNode*) sceneObj->inventorObject))
+				SbBool rendered = offscreenRenderer->render(gradientBackground ? gradientBackground : scene);
+				if (qualityRoot)
+				{
+					qualityRoot->unref();
+					qualityRoot = 0;
+				}
+
+				if (rendered)
 				{
 					if (gradientBackground)
 					{
@@ -592,6 +770,8 @@ PyObject* iv_render_buffer(PyObject * /*self*/, PyObject *args, PyObject *kwds)
 
 PyObject* iv_render_image(PyObject *self, PyObject *args, PyObject *kwds)
 {
+	PyProfiler::TraceScope trace("inventor.render_image");
+
     static PyObject *imageModule = 0, *fromArrayFunc = 0;
 
     if (!fromArrayFunc)
@@ -638,7 +818,27 @@ PyMODINIT_FUNC PyInit_inventor(void)
             "Processes inventor timer and delay queues.\n"
             "\n"
             "Args:\n"
-            "    Boolean flag indicating if application is idle.\n"
+            "    Boolean flag indicating if application is idle, only then idle\n"
+            "    sensors are processed and the call sleeps until the next timer\n"
+            "    is due, but at most 10 ms.\n"
+            "    Boolean flag allowing the call to sleep when idle, event loops\n"
+            "    waiting on next_timeout() pass False.\n"
+        },
+        { "next_timeout", iv_next_timeout, METH_NOARGS,
+            "Returns the time until process_queues() needs to be called next.\n"
+            "Also clears pending notifications of the wakeup file descriptor.\n"
+            "\n"
+            "Returns:\n"
+            "    Seconds until next timer sensor is due, 0 if delay sensors are\n"
+            "    pending or None if no sensors are scheduled."
+        },
+        { "wakeup_fd", iv_wakeup_fd, METH_NOARGS,
+            "Returns a file descriptor that becomes readable whenever sensors\n"
+            "get scheduled or unscheduled. Event loops can wait on it and then\n"
+            "call next_timeout() to find out when to process the queues.\n"
+            "\n"
+            "Returns:\n"
+            "    File descriptor or None if not supported on this platform."
         },
         { "create_classes", iv_create_classes, METH_VARARGS,
             "Creates Python classes for all registered Inventor scene objects."
@@ -665,10 +865,12 @@ PyMODINIT_FUNC PyInit_inventor(void)
             "    Scene object instance or None."
         },
         { "read", (PyCFunction)iv_read, METH_VARARGS,
-            "Reads a scene graph from string or file.\n"
+            "Reads a scene graph from string, bytes or file.\n"
             "\n"
             "Args:\n"
-            "    String containing scene itself or file path.\n"
+            "    String containing scene itself or file path. If a bytes object\n"
+            "    is passed (for example as returned by write() in binary mode)\n"
+            "    its single root node is read.\n"
             "\n"
             "Returns:\n"
             "    Root node of scene or None on failure."
@@ -679,9 +881,43 @@ PyMODINIT_FUNC PyInit_inventor(void)
             "Args:\n"
             "    applyTo: Node where action is applied.\n"
             "    file: Path to file into which scene is written.\n"
+            "    binary: If True the binary Inventor file format is used.\n"
+            "\n"
+            "Returns:\n"
+            "    Written scene as string (bytes in binary mode) or None is file\n"
+            "    argument was provided."
+        },
+        { "export_shared", (PyCFunction)PySharedScene::export_shared, METH_VARARGS | METH_KEYWORDS,
+            "Exports a scene graph for transport to another process. Bulk data of\n"
+            "numeric multi-value fields and images is moved into a newly created\n"
+            "shared memory block, while the remaining scene is written as a small\n"
+            "binary skeleton that references the arrays by offset.\n"
+            "\n"
+            "Args:\n"
+            "    applyTo: Root node of scene to be exported.\n"
+            "    minSize: Fields with less data than this number of bytes are\n"
+            "             kept in the skeleton. The default is 4096.\n"
+            "\n"
+            "Returns:\n"
+            "    Tuple of skeleton (bytes) and multiprocessing.shared_memory.\n"
+            "    SharedMemory instance. The caller owns the shared memory and is\n"
+            "    responsible for calling close() and unlink() on it."
+        },
+        { "import_shared", (PyCFunction)PySharedScene::import_shared, METH_VARARGS | METH_KEYWORDS,
+            "Rebuilds a scene graph from a skeleton and shared memory block as\n"
+            "returned by export_shared(). Where supported by the Inventor\n"
+            "implementation fields point directly into the shared block instead\n"
+            "of copying it. The block stays exported until the returned root node\n"
+            "is destroyed, so nodes should not be used outside of that scene.\n"
+            "\n"
+            "Args:\n"
+            "    skeleton: Skeleton bytes returned by export_shared().\n"
+            "    buffer: SharedMemory instance or any object supporting the\n"
+            "            buffer protocol that holds the bulk data.\n"
+            "    copy: If True field values are copied from the buffer.\n"
             "\n"
             "Returns:\n"
-            "    Written scene as string or None is file argument was provided."
+            "    Root node of scene."
         },
         { "search", (PyCFunction)iv_search, METH_VARARGS | METH_KEYWORDS,
             "Searches for children in a scene with given name or type.\n"
@@ -724,6 +960,209 @@ PyMODINIT_FUNC PyInit_inventor(void)
             "\n"
             "Returns:\n"
             "    Accumulated transformation matrix."
+        },
+        { "extract_triangles", (PyCFunction)PyGeometry::extract_triangles, METH_VARARGS | METH_KEYWORDS,
+            "Collects all triangles generated by shapes in a graph or path using\n"
+            "the SoCallbackAction. Vertices are returned in world space.\n"
+            "\n"
+            "Args:\n"
+            "    applyTo: Node or path where action is applied.\n"
+            "    colors: If True the diffuse color and alpha of each vertex is\n"
+            "            also returned.\n"
+            "\n"
+            "Returns:\n"
+            "    Tuple of vertices (N,3), normals (N,3), colors (N,4) or None,\n"
+            "    shape index per triangle (N/3) and list of shape nodes the\n"
+            "    indices refer to."
+        },
+        { "mesh", (PyCFunction)PyGeometry::mesh, METH_VARARGS | METH_KEYWORDS,
+            "Creates an IndexedFaceSet with a VertexProperty node from numpy\n"
+            "arrays. Arrays passed in with matching type and layout are copied\n"
+            "into the fields, so later modifications of the arrays don't change\n"
+            "the mesh. Arrays that first need a conversion (other dtype, not\n"
+            "contiguous) are converted into a temporary buffer, which fields\n"
+            "adopt without a second copy where the Inventor implementation\n"
+            "allows it.\n"
+            "\n"
+            "Args:\n"
+            "    vertices: Vertex positions with shape (N,3).\n"
+            "    faces: Vertex indices with shape (M,K) for polygons with K\n"
+            "           vertices or flat array with -1 terminating each face.\n"
+            "    normals: Normals per vertex (N,3) or per face (M,3).\n"
+            "    colors: Colors per vertex or per face as RGB/RGBA floats or\n"
+            "            bytes, or as packed 32-bit RGBA values.\n"
+            "    uvs: Texture coordinates per vertex with shape (N,2).\n"
+            "\n"
+            "Returns:\n"
+            "    IndexedFaceSet node."
+        },
+        { "export_geometry", (PyCFunction)PyExporter::export_geometry, METH_VARARGS | METH_KEYWORDS,
+            "Exports the triangles of a graph or path with transforms baked in\n"
+            "to binary glTF (.glb), binary PLY or Wavefront OBJ. Materials are\n"
+            "mapped to glTF PBR materials, an MTL library next to the OBJ file\n"
+            "or per-vertex colors in PLY files.\n"
+            "\n"
+            "Args:\n"
+            "    applyTo: Node or path where action is applied.\n"
+            "    file: Path to file into which geometry is written.\n"
+            "    format: 'glb', 'ply' or 'obj'. If omitted the format is\n"
+            "            determined by the file extension.\n"
+        },
+        { "optimize", (PyCFunction)PyOptimizer::optimize, METH_VARARGS | METH_KEYWORDS,
+            "Reorganizes a scene graph in place for faster rendering. With the\n"
+            "spatial strategy runs of separators and shapes among the children of\n"
+            "groups are regrouped into a bounding volume hierarchy of separators\n"
+            "with render culling and bounding box caching enabled, and render\n"
+            "caching enabled for the leaves. Other nodes keep their position, so\n"
+            "state inherited by the regrouped children does not change. Only the\n"
+            "drawing order among the regrouped children changes, which matters\n"
+            "only for unsorted transparency.\n"
+            "\n"
+            "Args:\n"
+            "    root: Group or Separator to optimize, groups below are\n"
+            "          optimized as well. Switches, LODs and other group types\n"
+            "          are left untouched.\n"
+            "    strategy: 'spatial'.\n"
+            "    leaf_size: Maximum number of children per leaf separator.\n"
+            "\n"
+            "Returns:\n"
+            "    Number of separators created.\n"
+        },
+        { "flatten", (PyCFunction)PyOptimizer::flatten, METH_VARARGS | METH_KEYWORDS,
+            "Creates a flat copy of a graph or path for faster rendering. All\n"
+            "transforms are baked into vertex coordinates and triangles sharing\n"
+            "the same material are merged into one IndexedFaceSet with a\n"
+            "VertexProperty, preceded by a single Material node. Transparent\n"
+            "materials are placed after opaque ones. Cameras, lights and\n"
+            "Environment nodes are copied in traversal order ahead of the\n"
+            "geometry with their original transform, so lights that were\n"
+            "scoped by a separator now affect the whole result. All other\n"
+            "state is lost: textures and texture coordinates, ShapeHints (the\n"
+            "result uses the default one-sided lighting without culling),\n"
+            "draw styles, as well as lines and points.\n"
+            "\n"
+            "Args:\n"
+            "    applyTo: Node or path to flatten, the original is not modified.\n"
+            "\n"
+            "Returns:\n"
+            "    Tuple with new root separator, list of original shapes and a\n"
+            "    list with one array per new face set that maps each face to\n"
+            "    the index of the original shape, for translating picks.\n"
+        },
+        { "simplify", (PyCFunction)PySimplifier::simplify, METH_VARARGS | METH_KEYWORDS,
+            "Generates a level of detail chain for a subgraph. The triangles of\n"
+            "the subgraph are decimated with quadric error metrics, one thread\n"
+            "per level, and placed into a LevelOfDetail node after the original\n"
+            "subgraph. Transforms are baked into the simplified levels, which\n"
+            "keep per face materials but drop textures, lines and points.\n"
+            "\n"
+            "Args:\n"
+            "    node: Subgraph to simplify, becomes the first child.\n"
+            "    ratios: Decreasing sequence with fraction of triangles kept per\n"
+            "            level, default is [0.5, 0.1, 0.01].\n"
+            "    screen_areas: Optional decreasing sequence with one screen area\n"
+            "                  in pixels per ratio below which the next coarser\n"
+            "                  child is shown. By default a level is used while each of\n"
+            "                  its triangles covers at least 4 pixels.\n"
+            "\n"
+            "Returns:\n"
+            "    LevelOfDetail node.\n"
+        },
+        { "point_cloud", (PyCFunction)PyGeometry::point_cloud, METH_VARARGS | METH_KEYWORDS,
+            "Creates a PointCloud node from an array of points. The points are\n"
+            "organized in an octree whose nodes hold subsamples of their cell,\n"
+            "and each frame the visible nodes with the largest screen-space\n"
+            "error are drawn until the pointBudget field is used up. If a file\n"
+            "is given the octree is written there and streamed from a memory-\n"
+            "mapped file on a background thread. Such files can also be opened\n"
+            "later by setting the filename field of a PointCloud node.\n"
+            "Building the octree copies all points into memory, so the input\n"
+            "must fit into RAM even if a file is written, and is limited to\n"
+            "2^32 - 1 points.\n"
+            "\n"
+            "Args:\n"
+            "    points: Array with shape (N, 3).\n"
+            "    colors: Optional array with shape (N, 3) or (N, 4) of float or\n"
+            "            uint8 values, or packed RGBA values.\n"
+            "    file: Optional path of chunked octree file to write.\n"
+            "    node_points: Maximum number of points per octree node.\n"
+            "\n"
+            "Returns:\n"
+            "    PointCloud node.\n"
+        },
+        { "isosurface", (PyCFunction)PyIsosurface::isosurface, METH_VARARGS | METH_KEYWORDS,
+            "Extracts the isosurface of a volume with marching cubes. The volume\n"
+            "is processed in bricks on all cores, bricks whose samples are all\n"
+            "above or all below the level are skipped after a scan of their\n"
+            "value range. The ranges are kept with the returned shape, when it\n"
+            "is passed again with the same numpy array only bricks the new level\n"
+            "passes through are visited. Arrays modified in place must be passed\n"
+            "as a new array object (e.g. a copy) for their ranges to be rescanned.\n"
+            "Vertices on cube edges are shared between triangles, normals are\n"
+            "taken from the volume gradient and point to lower values.\n"
+            "\n"
+            "Args:\n"
+            "    volume: Array with shape (Z, Y, X), uint8, int16, uint16 and\n"
+            "            float32 samples are read without conversion.\n"
+            "    level: Iso value separating inside (greater) from outside.\n"
+            "    spacing: Tuple with sample distances along x, y and z.\n"
+            "    shape: Optional IndexedFaceSet whose fields are replaced, for\n"
+            "           example the result of a previous call.\n"
+            "\n"
+            "Returns:\n"
+            "    IndexedFaceSet with VertexProperty holding vertices and normals.\n"
+        },
+        { "compute_normals", (PyCFunction)PyMeshTools::compute_normals, METH_VARARGS | METH_KEYWORDS,
+            "Computes vertex normals of an indexed face set on all cores and\n"
+            "writes them in one update, so animated meshes can be given new\n"
+            "normals every frame instead of relying on the normal cache. Faces\n"
+            "are weighted by area, normals are split where adjacent faces meet\n"
+            "at more than the crease angle. If no vertex needs more than one\n"
+            "normal, normalIndex is cleared and normals follow coordIndex.\n"
+            "\n"
+            "Args:\n"
+            "    shape: IndexedFaceSet.\n"
+            "    crease_angle: Angle in radians below which normals are smoothed.\n"
+            "    coordinates: Coordinate3 node holding the vertices if shape has\n"
+            "                 no VertexProperty with vertices.\n"
+            "    normal: Normal node receiving the normals, otherwise they are\n"
+            "            stored in the VertexProperty of shape. A Normal node\n"
+            "            needs a NormalBinding of PER_VERTEX_INDEXED.\n"
+            "\n"
+            "Returns:\n"
+            "    Number of normals.\n"
+        },
+        { "weld", (PyCFunction)PyMeshTools::weld, METH_VARARGS | METH_KEYWORDS,
+            "Merges vertices of an indexed shape that are closer than epsilon,\n"
+            "using a spatial hash searched on all cores. Each vertex is merged\n"
+            "into the lowest vertex index within reach. Per vertex normals,\n"
+            "colors and texture coordinates of the VertexProperty keep their\n"
+            "values through explicit index fields.\n"
+            "\n"
+            "Args:\n"
+            "    shape: Indexed shape with VertexProperty holding its vertices.\n"
+            "    epsilon: Maximum distance of merged vertices, 0 merges only\n"
+            "             identical positions.\n"
+            "\n"
+            "Returns:\n"
+            "    Number of vertices after welding.\n"
+        },
+        { "optimize_vertex_cache", (PyCFunction)PyMeshTools::optimize_vertex_cache, METH_VARARGS | METH_KEYWORDS,
+            "Reorders faces of an indexed shape for the post-transform vertex\n"
+            "cache and numbers vertices in order of first use for fetch\n"
+            "locality. Faces are ordered with Forsyth's linear-speed vertex cache\n"
+            "optimization. Triangle strips are split into triangles, reordered\n"
+            "and joined into new strips. Fields are rewritten in one update each,\n"
+            "attributes bound per face or per vertex follow their faces and\n"
+            "vertices.\n"
+            "\n"
+            "Args:\n"
+            "    shape: IndexedFaceSet or IndexedTriangleStripSet with\n"
+            "           VertexProperty holding its vertices.\n"
+            "    cache_size: Number of vertices in the simulated cache.\n"
+            "\n"
+            "Returns:\n"
+            "    Tuple with average cache misses per triangle before and after.\n"
         },
 		{ "render_buffer", (PyCFunction) iv_render_buffer, METH_VARARGS | METH_KEYWORDS,
             "Renders a scene into an offscreen buffer using the inventor\n"
@@ -741,6 +1180,8 @@ PyMODINIT_FUNC PyInit_inventor(void)
 			"    file: Optional file name to write image buffer into.\n"
 			"    background: Background color. Provide two colors for\n"
 			"                gradient.\n"
+			"    quality: Reduced quality level for fast preview passes of large\n"
+			"             scenes, from 0 (full quality) to 3 (bounding boxes).\n"
             "\n"
             "Returns:\n"
             "    Pixel buffer of rendered scene."
@@ -757,10 +1198,86 @@ PyMODINIT_FUNC PyInit_inventor(void)
                 "    file: Optional file name to write image buffer into.\n"
                 "    background: Background color. Provide two colors for\n"
                 "                gradient.\n"
+                "    quality: Reduced quality level, see render_buffer().\n"
                 "\n"
                 "Returns:\n"
                 "    Image of rendered scene."
         },
+        { "start_engine_profile", (PyCFunction)PyProfiler::start_engine_profile, METH_VARARGS,
+                "Starts counting and timing the evaluations of all engines that are\n"
+                "connected to fields of a scene. While profiling, pass-through probes\n"
+                "are inserted between each engine output and the fields it feeds.\n"
+                "A running profile is discarded.\n"
+                "\n"
+                "Args:\n"
+                "    Root node of scene. Engines are found by following field\n"
+                "    connections upstream from all nodes below root.\n"
+                "\n"
+                "Returns:\n"
+                "    Number of engines being profiled."
+        },
+        { "stop_engine_profile", (PyCFunction)PyProfiler::stop_engine_profile, METH_NOARGS,
+                "Stops engine profiling, restores the original connections and\n"
+                "returns the measurements. Times are given in seconds. Inclusive\n"
+                "time contains the evaluation of upstream engines pulled in by an\n"
+                "engine, exclusive time does not.\n"
+                "\n"
+                "Returns:\n"
+                "    Tuple (engines, types). Engines is a list of dictionaries with\n"
+                "    the keys engine, type, evaluations, propagations, fanout,\n"
+                "    inclusive and exclusive, sorted by inclusive time. Types maps\n"
+                "    engine type names to the same measurements summed over all\n"
+                "    instances, plus the number of instances."
+        },
+        { "start_traversal_profile", (PyCFunction)PyProfiler::start_traversal_profile, METH_VARARGS | METH_KEYWORDS,
+                "Starts recording time and visits of every node traversed by render,\n"
+                "pick, bounding box and search actions, including those applied by\n"
+                "SceneManager.render() and render_buffer(). Nodes are recorded in a\n"
+                "call tree, so a node reached along different paths has one entry\n"
+                "per path. A running profile is discarded.\n"
+                "\n"
+                "Args:\n"
+                "    actions: Optional list of action names to profile, any of\n"
+                "             'GLRender', 'RayPick', 'GetBoundingBox' and 'Search'.\n"
+                "             Defaults to all."
+        },
+        { "stop_traversal_profile", (PyCFunction)PyProfiler::stop_traversal_profile, METH_VARARGS | METH_KEYWORDS,
+                "Stops traversal profiling and returns the call tree. Times are given\n"
+                "in seconds. Inclusive time contains the traversal of children,\n"
+                "exclusive time does not.\n"
+                "\n"
+                "Args:\n"
+                "    format: 'array' (default) returns a numpy structured array with\n"
+                "            the fields parent, depth, action, type, name, visits,\n"
+                "            inclusive and exclusive. Parent is the row index of the\n"
+                "            parent entry or -1. 'collapsed' returns a list of lines\n"
+                "            'Action;Type:name;... microseconds' in the folded stack\n"
+                "            format read by flame graph tools.\n"
+                "\n"
+                "Returns:\n"
+                "    Profile in requested format."
+        },
+        { "start_trace", (PyCFunction)PyProfiler::start_trace, METH_NOARGS,
+                "Starts recording a trace event for every call into the binding:\n"
+                "module functions, field access, wrapper creation, SceneManager\n"
+                "methods and sensor callbacks. While tracing is off the recording\n"
+                "costs a single branch per call."
+        },
+        { "stop_trace", (PyCFunction)PyProfiler::stop_trace, METH_NOARGS,
+                "Stops recording trace events. Events recorded so far are kept until\n"
+                "flush_trace() or start_trace() is called."
+        },
+        { "flush_trace", (PyCFunction)PyProfiler::flush_trace, METH_VARARGS | METH_KEYWORDS,
+                "Writes recorded trace events in Chrome trace event JSON format, which\n"
+                "can be loaded into chrome://tracing or Perfetto, and clears them.\n"
+                "\n"
+                "Args:\n"
+                "    file: Optional name of file to write into.\n"
+                "\n"
+                "Returns:\n"
+                "    Number of events written to file, or JSON string if no file\n"
+                "    name was given."
+        },
         { NULL, NULL, 0, NULL }
 	};
 
@@ -782,6 +1299,8 @@ PyMODINIT_FUNC PyInit_inventor(void)
         "- EngineOutput: Represents an output (needed for connections).\n"
         "- Path: Represents a traversal path (return type of search and pick methods).\n"
         "- NodekitCatalog: Describes notekit catalog entries.\n"
+        "- ChangeLog: Collects changes of many nodes and fields in batches.\n"
+        "- PyEngine: Engine evaluated by a Python function.\n"
         "\n"
         "Furthermore this module creates Python classes for all registered engines\n"
         "and nodes dynamically, thereby enabling access to scene object fields via\n"
@@ -806,6 +1325,8 @@ PyMODINIT_FUNC PyInit_inventor(void)
             PyEngineOutput::getType(),
             PyPath::getType(),
             PyNodekitCatalog::getType(),
+            PyChangeLog::getType(),
+            PyEngine::getType(),
 			NULL,
 		};
 
@@ -813,8 +1334,10 @@ PyMODINIT_FUNC PyInit_inventor(void)
 		{
 			if (PyType_Ready(types[i]) >= 0)
 			{
+				// type names may be qualified with module name
+				const char *name = strrchr(types[i]->tp_name, '.');
 				Py_INCREF(types[i]);
-				PyModule_AddObject(mod, types[i]->tp_name, (PyObject *) types[i]);
+				PyModule_AddObject(mod, name ? name + 1 : types[i]->tp_name, (PyObject *) types[i]);
 			}
 		}
 
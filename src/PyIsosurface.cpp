@@ -0,0 +1,514 @@
+/**
+ * \file
+ * \brief      PyIsosurface class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+#include "PyIsosurface.h"
+#include "PyField.h"
+#define PY_ARRAY_UNIQUE_SYMBOL PyInventor_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/ndarrayobject.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <string.h>
+#include <math.h>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+
+
+// cubes along each axis of a brick, which is the unit of work for threads
+static const size_t BRICK_SIZE = 32;
+
+// corners of the two end points of the 12 cube edges, corner bits are x, y and z
+static int cubeEdges[12][2];
+
+// edge indices of triangles for each of the 256 inside/outside corner configurations
+static int8_t cubeTriangles[256][37];
+static bool tablesReady = false;
+
+
+static void buildTables()
+{
+	if (tablesReady) return;
+
+	// edges are numbered by axis, edges along x first
+	int edgeIndex[8][8];
+	int numEdges = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int c = 0; c < 8; ++c)
+		{
+			if (c & (1 << axis)) continue;
+			cubeEdges[numEdges][0] = c;
+			cubeEdges[numEdges][1] = c | (1 << axis);
+			edgeIndex[c][c | (1 << axis)] = edgeIndex[c | (1 << axis)][c] = numEdges++;
+		}
+	}
+
+	// corners of faces in counterclockwise order seen from outside the cube
+	static const int faces[6][4] = { { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 2, 3, 1 }, { 4, 5, 7, 6 } };
+
+	for (int config = 0; config < 256; ++config)
+	{
+		// on every face a segment leads from the edge where a run of inside
+		// corners ends to the edge where it started. Faces with two diagonal
+		// inside corners have two runs, so neighboring cubes agree on how
+		// ambiguous faces are split and the surface is closed.
+		int next[12];
+		for (int e = 0; e < 12; ++e) next[e] = -1;
+
+		for (int f = 0; f < 6; ++f)
+		{
+			for (int k = 0; k < 4; ++k)
+			{
+				int prev = faces[f][(k + 3) % 4];
+				if (!(config & (1 << faces[f][k])) || (config & (1 << prev))) continue;
+
+				int last = k;
+				while (config & (1 << faces[f][(last + 1) % 4])) last = (last + 1) % 4;
+
+				int entry = edgeIndex[prev][faces[f][k]];
+				int exit = edgeIndex[faces[f][last]][faces[f][(last + 1) % 4]];
+				next[exit] = entry;
+			}
+		}
+
+		// segments form closed loops that are triangulated as fans
+		bool visited[12] = { false };
+		int n = 0;
+		for (int e = 0; e < 12; ++e)
+		{
+			if ((next[e] < 0) || visited[e]) continue;
+
+			int loop[12], length = 0;
+			for (int i = e; !visited[i]; i = next[i])
+			{
+				visited[i] = true;
+				loop[length++] = i;
+			}
+
+			for (int i = 1; i + 1 < length; ++i)
+			{
+				cubeTriangles[config][n++] = (int8_t) loop[0];
+				cubeTriangles[config][n++] = (int8_t) loop[i + 1];
+				cubeTriangles[config][n++] = (int8_t) loop[i];
+			}
+		}
+		cubeTriangles[config][n] = -1;
+	}
+
+	tablesReady = true;
+}
+
+
+template <typename T>
+static inline float sample(const PyIsosurface::Volume &volume, size_t x, size_t y, size_t z)
+{
+	return (float) ((const T *) volume.data)[(z * volume.dims[1] + y) * volume.dims[0] + x];
+}
+
+
+template <typename T>
+static void gradient(const PyIsosurface::Volume &volume, const size_t *p, float *gradient_out)
+{
+	// central differences, one-sided at the border
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		size_t lo[3] = { p[0], p[1], p[2] }, hi[3] = { p[0], p[1], p[2] };
+		if (lo[axis] > 0) lo[axis]--;
+		if (hi[axis] + 1 < volume.dims[axis]) hi[axis]++;
+
+		float distance = (hi[axis] - lo[axis]) * volume.spacing[axis];
+		gradient_out[axis] = (distance > 0.f) ? (sample<T>(volume, hi[0], hi[1], hi[2]) - sample<T>(volume, lo[0], lo[1], lo[2])) / distance : 0.f;
+	}
+}
+
+
+static size_t ownerBrick(const PyIsosurface::Volume &volume, const size_t *p)
+{
+	// points on the far side of the last brick belong to it
+	size_t b[3];
+	for (int i = 0; i < 3; ++i) b[i] = std::min(p[i] / BRICK_SIZE, volume.bricks[i] - 1);
+	return (b[2] * volume.bricks[1] + b[1]) * volume.bricks[0] + b[0];
+}
+
+
+template <typename T>
+static void extractBrick(const PyIsosurface::Volume &volume, size_t index, PyIsosurface::Brick &brick)
+{
+	size_t b[3] = { index % volume.bricks[0], (index / volume.bricks[0]) % volume.bricks[1], index / (volume.bricks[0] * volume.bricks[1]) };
+	size_t begin[3], end[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		begin[i] = b[i] * BRICK_SIZE;
+		end[i] = std::min(begin[i] + BRICK_SIZE, volume.dims[i] - 1);
+	}
+
+	// bricks whose samples are all on one side of the level are skipped,
+	// the value range is only scanned if it isn't known from a previous call
+	float *range = volume.ranges + index * 2;
+	if (!volume.rangesKnown)
+	{
+		float minValue = sample<T>(volume, begin[0], begin[1], begin[2]), maxValue = minValue;
+		for (size_t z = begin[2]; z <= end[2]; ++z)
+		{
+			for (size_t y = begin[1]; y <= end[1]; ++y)
+			{
+				for (size_t x = begin[0]; x <= end[0]; ++x)
+				{
+					float v = sample<T>(volume, x, y, z);
+					if (v < minValue) minValue = v;
+					if (v > maxValue) maxValue = v;
+				}
+			}
+		}
+		range[0] = minValue;
+		range[1] = maxValue;
+	}
+	if ((range[0] > volume.level) || (range[1] <= volume.level)) return;
+
+	for (size_t z = begin[2]; z < end[2]; ++z)
+	{
+		for (size_t y = begin[1]; y < end[1]; ++y)
+		{
+			for (size_t x = begin[0]; x < end[0]; ++x)
+			{
+				float values[8];
+				int config = 0;
+				for (int c = 0; c < 8; ++c)
+				{
+					values[c] = sample<T>(volume, x + (c & 1), y + ((c >> 1) & 1), z + ((c >> 2) & 1));
+					if (values[c] > volume.level) config |= (1 << c);
+				}
+				if ((config == 0) || (config == 255)) continue;
+
+				for (const int8_t *e = cubeTriangles[config]; *e >= 0; ++e)
+				{
+					// edges are identified by their lower end point and axis
+					int c0 = cubeEdges[*e][0], c1 = cubeEdges[*e][1];
+					size_t p0[3] = { x + (c0 & 1), y + ((c0 >> 1) & 1), z + ((c0 >> 2) & 1) };
+					size_t p1[3] = { x + (c1 & 1), y + ((c1 >> 1) & 1), z + ((c1 >> 2) & 1) };
+					uint64_t key = ((p0[2] * volume.dims[1] + p0[1]) * volume.dims[0] + p0[0]) * 3 + (*e / 4);
+
+					if (ownerBrick(volume, p0) != index)
+					{
+						brick.foreignEdges.push_back(key);
+						brick.triangles.push_back(-(int32_t) brick.foreignEdges.size());
+						continue;
+					}
+
+					std::unordered_map<uint64_t, int32_t>::iterator it = brick.ownedEdges.find(key);
+					if (it != brick.ownedEdges.end())
+					{
+						brick.triangles.push_back(it->second);
+						continue;
+					}
+
+					int32_t vertex = (int32_t) (brick.vertices.size() / 3);
+					brick.ownedEdges[key] = vertex;
+					brick.triangles.push_back(vertex);
+
+					// surface normals point to lower values, opposite of the gradient
+					float t = (volume.level - values[c0]) / (values[c1] - values[c0]);
+					float g0[3], g1[3], n[3];
+					gradient<T>(volume, p0, g0);
+					gradient<T>(volume, p1, g1);
+					for (int i = 0; i < 3; ++i)
+					{
+						brick.vertices.push_back((p0[i] + t * (float) (p1[i] - p0[i])) * volume.spacing[i]);
+						n[i] = -(g0[i] + t * (g1[i] - g0[i]));
+					}
+					float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length > 0.f)
+					{
+						n[0] /= length; n[1] /= length; n[2] /= length;
+					}
+					brick.normals.insert(brick.normals.end(), n, n + 3);
+				}
+			}
+		}
+	}
+}
+
+
+template <typename T>
+static void extractBricks(const PyIsosurface::Volume *volume, std::atomic<size_t> *nextBrick, std::vector<PyIsosurface::Brick> *bricks)
+{
+	for (size_t i = (*nextBrick)++; i < bricks->size(); i = (*nextBrick)++)
+	{
+		extractBrick<T>(*volume, i, (*bricks)[i]);
+	}
+}
+
+
+std::map<SoNode*, PyIsosurface::RangeCache*> PyIsosurface::rangeCaches;
+
+
+void PyIsosurface::deleteRangeCache(PyObject *capsule)
+{
+	RangeCache *cache = (RangeCache *) PyCapsule_GetPointer(capsule, "RangeCache");
+	if (cache)
+	{
+		rangeCaches.erase(cache->shape);
+		Py_XDECREF(cache->volumeRef);
+		delete cache;
+	}
+}
+
+
+PyObject* PyIsosurface::isosurface(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *volumeObj = NULL, *spacingObj = NULL, *shapeObj = NULL;
+	float level = 0.f;
+
+	static char *kwlist[] = { "volume", "level", "spacing", "shape", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "Of|OO", kwlist, &volumeObj, &level, &spacingObj, &shapeObj))
+	{
+		return NULL;
+	}
+
+	if (!PyField::initNumpy())
+	{
+		return NULL;
+	}
+
+	Volume volume;
+	volume.level = level;
+	volume.spacing[0] = volume.spacing[1] = volume.spacing[2] = 1.f;
+	if (spacingObj && (spacingObj != Py_None))
+	{
+		PyObject *tuple = PySequence_Check(spacingObj) ? PySequence_Tuple(spacingObj) : NULL;
+		bool valid = tuple && PyArg_ParseTuple(tuple, "fff", &volume.spacing[0], &volume.spacing[1], &volume.spacing[2]);
+		Py_XDECREF(tuple);
+		if (!valid)
+		{
+			PyErr_SetString(PyExc_ValueError, "spacing must be a tuple of three values (x, y, z)");
+			return NULL;
+		}
+	}
+
+	SoIndexedFaceSet *faceSet = NULL;
+	if (shapeObj && (shapeObj != Py_None))
+	{
+		SoNode *node = PyNode_Check(shapeObj) ? (SoNode *) ((PySceneObject::Object *) shapeObj)->inventorObject : NULL;
+		if (!node || !node->isOfType(SoIndexedFaceSet::getClassTypeId()))
+		{
+			PyErr_SetString(PyExc_TypeError, "shape must be an IndexedFaceSet");
+			return NULL;
+		}
+		faceSet = (SoIndexedFaceSet *) node;
+	}
+
+	// common sample types are read directly, others are converted to float
+	PyArrayObject *arr = (PyArrayObject*) PyArray_FROM_OF(volumeObj, NPY_ARRAY_IN_ARRAY);
+	if (arr)
+	{
+		int type = PyArray_TYPE(arr);
+		if ((type != NPY_UINT8) && (type != NPY_INT16) && (type != NPY_UINT16) && (type != NPY_FLOAT32))
+		{
+			PyArrayObject *converted = (PyArrayObject*) PyArray_FROM_OTF((PyObject*) arr, NPY_FLOAT32, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+			Py_DECREF(arr);
+			arr = converted;
+		}
+	}
+	if (!arr || (PyArray_NDIM(arr) != 3))
+	{
+		Py_XDECREF(arr);
+		if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "volume must have shape (Z, Y, X)");
+		return NULL;
+	}
+
+	volume.data = PyArray_DATA(arr);
+	for (int i = 0; i < 3; ++i)
+	{
+		volume.dims[i] = (size_t) PyArray_DIM(arr, 2 - i);
+		volume.bricks[i] = (volume.dims[i] > 1) ? (volume.dims[i] - 2) / BRICK_SIZE + 1 : 0;
+	}
+
+	buildTables();
+
+	// value ranges of bricks are reused if the shape was last extracted from
+	// the same array object with unchanged data pointer, shape and type, so
+	// changing the level only visits bricks the new surface passes through
+	size_t numBricks = volume.bricks[0] * volume.bricks[1] * volume.bricks[2];
+	PyArrayObject *source = PyArray_Check(volumeObj) ? (PyArrayObject*) volumeObj : NULL;
+	std::map<SoNode*, RangeCache*>::iterator cached = faceSet ? rangeCaches.find(faceSet) : rangeCaches.end();
+	RangeCache *cache = (cached != rangeCaches.end()) ? cached->second : NULL;
+	std::vector<float> ranges;
+	volume.rangesKnown = source && cache && cache->volumeRef && (PyWeakref_GetObject(cache->volumeRef) == volumeObj) &&
+		(cache->data == PyArray_DATA(source)) && (cache->type == PyArray_TYPE(source)) && (cache->ranges.size() == numBricks * 2) &&
+		(cache->dims[0] == volume.dims[0]) && (cache->dims[1] == volume.dims[1]) && (cache->dims[2] == volume.dims[2]);
+	if (volume.rangesKnown)
+	{
+		ranges.swap(cache->ranges);
+	}
+	else
+	{
+		ranges.resize(numBricks * 2);
+	}
+	volume.ranges = ranges.empty() ? NULL : &ranges[0];
+
+	// bricks are handed out to threads one at a time, so empty ones cost little
+	std::vector<Brick> bricks(numBricks);
+	std::atomic<size_t> nextBrick(0);
+	int numThreads = std::max(1, std::min((int) std::thread::hardware_concurrency(), (int) bricks.size()));
+	void (*extract)(const Volume *, std::atomic<size_t> *, std::vector<Brick> *) =
+		(PyArray_TYPE(arr) == NPY_UINT8) ? extractBricks<uint8_t> :
+		(PyArray_TYPE(arr) == NPY_INT16) ? extractBricks<int16_t> :
+		(PyArray_TYPE(arr) == NPY_UINT16) ? extractBricks<uint16_t> : extractBricks<float>;
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < numThreads; ++i)
+	{
+		workers.push_back(std::thread(extract, &volume, &nextBrick, &bricks));
+	}
+	extract(&volume, &nextBrick, &bricks);
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i].join();
+	}
+	Py_DECREF(arr);
+
+	// vertices of bricks are concatenated, edges shared between bricks are welded
+	std::vector<int32_t> offsets(bricks.size() + 1, 0);
+	size_t numIndices = 0;
+	for (size_t i = 0; i < bricks.size(); ++i)
+	{
+		offsets[i + 1] = offsets[i] + (int32_t) (bricks[i].vertices.size() / 3);
+		numIndices += bricks[i].triangles.size();
+	}
+	int numVertices = offsets.back();
+
+	std::vector<int32_t> coordIndex;
+	coordIndex.reserve(numIndices / 3 * 4);
+	for (size_t i = 0; i < bricks.size(); ++i)
+	{
+		const Brick &brick = bricks[i];
+		for (size_t j = 0; j + 2 < brick.triangles.size(); j += 3)
+		{
+			int32_t tri[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				int32_t v = brick.triangles[j + k];
+				if (v >= 0)
+				{
+					tri[k] = offsets[i] + v;
+					continue;
+				}
+
+				uint64_t key = brick.foreignEdges[-v - 1];
+				uint64_t point = key / 3;
+				size_t p[3] = { (size_t) (point % volume.dims[0]), (size_t) ((point / volume.dims[0]) % volume.dims[1]), (size_t) (point / (volume.dims[0] * volume.dims[1])) };
+				size_t owner = ownerBrick(volume, p);
+				std::unordered_map<uint64_t, int32_t>::const_iterator it = bricks[owner].ownedEdges.find(key);
+				tri[k] = (it != bricks[owner].ownedEdges.end()) ? offsets[owner] + it->second : -1;
+			}
+
+			if ((tri[0] >= 0) && (tri[1] >= 0) && (tri[2] >= 0))
+			{
+				coordIndex.insert(coordIndex.end(), tri, tri + 3);
+				coordIndex.push_back(-1);
+			}
+		}
+	}
+
+	// fields are written in one bulk update each
+	if (!faceSet)
+	{
+		faceSet = new SoIndexedFaceSet();
+	}
+	faceSet->ref();
+
+	SoVertexProperty *vertexProperty = (faceSet->vertexProperty.getValue() && faceSet->vertexProperty.getValue()->isOfType(SoVertexProperty::getClassTypeId())) ?
+		(SoVertexProperty *) faceSet->vertexProperty.getValue() : new SoVertexProperty();
+
+	vertexProperty->vertex.setNum(numVertices);
+	vertexProperty->normal.setNum(numVertices);
+	SbVec3f *vertices = vertexProperty->vertex.startEditing();
+	SbVec3f *normals = vertexProperty->normal.startEditing();
+	for (size_t i = 0; i < bricks.size(); ++i)
+	{
+		if (bricks[i].vertices.empty()) continue;
+		memcpy((float *) (vertices + offsets[i]), &bricks[i].vertices[0], bricks[i].vertices.size() * sizeof(float));
+		memcpy((float *) (normals + offsets[i]), &bricks[i].normals[0], bricks[i].normals.size() * sizeof(float));
+	}
+	vertexProperty->vertex.finishEditing();
+	vertexProperty->normal.finishEditing();
+	vertexProperty->normalBinding = SoVertexProperty::PER_VERTEX_INDEXED;
+
+	faceSet->coordIndex.setNum((int) coordIndex.size());
+	if (!coordIndex.empty())
+	{
+		memcpy(faceSet->coordIndex.startEditing(), &coordIndex[0], coordIndex.size() * sizeof(int32_t));
+		faceSet->coordIndex.finishEditing();
+	}
+
+	if (faceSet->vertexProperty.getValue() != vertexProperty)
+	{
+		faceSet->vertexProperty = vertexProperty;
+	}
+
+	// the cache lives as long as the shape, arrays are only referenced weakly
+	cached = rangeCaches.find(faceSet);
+	cache = (cached != rangeCaches.end()) ? cached->second : NULL;
+	if (!cache)
+	{
+		cache = new RangeCache();
+		cache->shape = faceSet;
+		cache->volumeRef = NULL;
+		PyObject *capsule = PyCapsule_New(cache, "RangeCache", deleteRangeCache);
+		if (capsule)
+		{
+			rangeCaches[faceSet] = cache;
+			PySceneObject::keepAlive(faceSet, capsule);
+			Py_DECREF(capsule);
+		}
+		else
+		{
+			delete cache;
+			cache = NULL;
+			PyErr_Clear();
+		}
+	}
+	if (cache)
+	{
+		Py_CLEAR(cache->volumeRef);
+		cache->ranges.clear();
+		cache->volumeRef = source ? PyWeakref_NewRef(volumeObj, NULL) : NULL;
+		if (cache->volumeRef)
+		{
+			cache->data = PyArray_DATA(source);
+			cache->type = PyArray_TYPE(source);
+			memcpy(cache->dims, volume.dims, sizeof(cache->dims));
+			cache->ranges.swap(ranges);
+		}
+		else
+		{
+			PyErr_Clear();
+		}
+	}
+
+	PyObject *result = NULL;
+	if (shapeObj && (shapeObj != Py_None))
+	{
+		Py_INCREF(shapeObj);
+		result = shapeObj;
+	}
+	else
+	{
+		result = PySceneObject::createWrapper(faceSet);
+	}
+	faceSet->unref();
+
+	return result;
+}
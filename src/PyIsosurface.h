@@ -0,0 +1,66 @@
+/**
+ * \file
+ * \brief      PyIsosurface class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+#include <vector>
+#include <unordered_map>
+#include <map>
+
+
+class PyIsosurface
+{
+public:
+	// module functions
+	static PyObject* isosurface(PyObject *self, PyObject *args, PyObject *kwds);
+
+	// sampled scalar field with samples indexed [z][y][x]
+	struct Volume
+	{
+		const void *data;
+		size_t dims[3];
+		float spacing[3];
+		float level;
+		size_t bricks[3];
+		float *ranges;
+		bool rangesKnown;
+	};
+
+	// part of the surface extracted from one brick of cubes, vertices on
+	// edges owned by other bricks are referenced by negative indices into
+	// the list of foreign edge keys
+	struct Brick
+	{
+		std::vector<float> vertices;
+		std::vector<float> normals;
+		std::vector<int32_t> triangles;
+		std::vector<uint64_t> foreignEdges;
+		std::unordered_map<uint64_t, int32_t> ownedEdges;
+	};
+
+	// minimum and maximum sample of each brick of the array a shape was last
+	// extracted from, reused while the same array is passed with the shape
+	struct RangeCache
+	{
+		SoNode *shape;
+		PyObject *volumeRef;
+		const void *data;
+		size_t dims[3];
+		int type;
+		std::vector<float> ranges;
+	};
+
+private:
+	static std::map<SoNode*, RangeCache*> rangeCaches;
+	static void deleteRangeCache(PyObject *capsule);
+};
@@ -0,0 +1,960 @@
+/**
+ * \file
+ * \brief      PyMeshTools class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/nodes/SoIndexedShape.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoIndexedTriangleStripSet.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoNormal.h>
+#include "PyMeshTools.h"
+#include <algorithm>
+#include <thread>
+#include <string.h>
+#include <math.h>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+
+
+// smallest number of faces or vertices worth a worker thread
+static const size_t THREAD_CHUNK_SIZE = 16384;
+
+
+// splits [0, num) into one range per core and runs function on each
+template <typename Context>
+static void runParallel(void (*function)(Context *, size_t, size_t), Context *context, size_t num)
+{
+	size_t numThreads = 1;
+	if (num >= 2 * THREAD_CHUNK_SIZE)
+	{
+		size_t cores = std::max(1u, std::thread::hardware_concurrency());
+		numThreads = std::min(cores, num / THREAD_CHUNK_SIZE);
+	}
+
+	size_t chunk = (num + numThreads - 1) / numThreads;
+	std::vector<std::thread> workers;
+	for (size_t start = chunk; start < num; start += chunk)
+	{
+		workers.push_back(std::thread(function, context, start, std::min(num, start + chunk)));
+	}
+	function(context, 0, std::min(num, chunk));
+
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i].join();
+	}
+}
+
+
+static SoNode *getNode(PyObject *obj, SoType type)
+{
+	SoNode *node = (obj && PyNode_Check(obj)) ? (SoNode *) ((PySceneObject::Object *) obj)->inventorObject : NULL;
+	return (node && node->isOfType(type)) ? node : NULL;
+}
+
+
+static void setVectors(SoMFVec3f &field, const SbVec3f *values, size_t num)
+{
+	field.setNum((int) num);
+	if (num)
+	{
+		memcpy((float *) field.startEditing(), values, num * sizeof(SbVec3f));
+		field.finishEditing();
+	}
+}
+
+
+static bool hasIndices(const SoMFInt32 &field)
+{
+	// the default value of a single -1 means coordIndex is used
+	return (field.getNum() > 0) && (field[0] >= 0);
+}
+
+
+static void setIndices(SoMFInt32 &field, const std::vector<int32_t> &indices)
+{
+	field.setNum((int) indices.size());
+	if (!indices.empty())
+	{
+		memcpy(field.startEditing(), &indices[0], indices.size() * sizeof(int32_t));
+		field.finishEditing();
+	}
+}
+
+
+// moves values so that value i is taken from position sources[i], fields
+// with a single value apply to everything and are left alone
+template <typename Field, typename T>
+static void reorderValues(Field &field, const std::vector<int32_t> &sources)
+{
+	int num = field.getNum();
+	if ((num <= 1) || (num < (int) sources.size())) return;
+
+	std::vector<T> values(field.getValues(0), field.getValues(0) + num);
+	T *data = field.startEditing();
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		data[i] = values[sources[i]];
+	}
+	field.finishEditing();
+}
+
+
+static bool isPerFace(int binding)
+{
+	return (binding == SoVertexProperty::PER_PART) || (binding == SoVertexProperty::PER_PART_INDEXED) ||
+		(binding == SoVertexProperty::PER_FACE) || (binding == SoVertexProperty::PER_FACE_INDEXED);
+}
+
+
+// score of a vertex in Forsyth's linear-speed vertex cache optimization,
+// recently used vertices and vertices with few remaining faces are preferred
+static float vertexScore(int cachePosition, int remainingFaces, int cacheSize)
+{
+	if (remainingFaces <= 0) return -1.f;
+
+	float score = 0.f;
+	if (cachePosition >= 0)
+	{
+		score = (cachePosition < 3) ? 0.75f : powf(1.f - (float) (cachePosition - 3) / (float) (cacheSize - 3), 1.5f);
+	}
+
+	return score + 2.f / sqrtf((float) remainingFaces);
+}
+
+
+// returns the third vertex of a triangle containing the directed edge (a, b)
+static int32_t continueStrip(int32_t a, int32_t b, const int32_t *triangle)
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		if ((triangle[k] == a) && (triangle[(k + 1) % 3] == b)) return triangle[(k + 2) % 3];
+	}
+
+	return -1;
+}
+
+
+static void faceNormals(PyMeshTools::NormalContext *context, size_t start, size_t end)
+{
+	const PyMeshTools::Topology &topology = *context->topology;
+
+	for (size_t f = start; f < end; ++f)
+	{
+		// Newell's method, length is twice the polygon area
+		const int32_t *corners = context->coordIndex + topology.faceStarts[f];
+		int32_t n = topology.faceSizes[f];
+		float sum[3] = { 0.f, 0.f, 0.f };
+		for (int32_t k = 0; k < n; ++k)
+		{
+			const float *a = context->vertices[corners[k]].getValue();
+			const float *b = context->vertices[corners[(k + 1) % n]].getValue();
+			sum[0] += (a[1] - b[1]) * (a[2] + b[2]);
+			sum[1] += (a[2] - b[2]) * (a[0] + b[0]);
+			sum[2] += (a[0] - b[0]) * (a[1] + b[1]);
+		}
+
+		SbVec3f normal(sum[0], sum[1], sum[2]);
+		float length = normal.length();
+		context->faceNormals[f] = normal * 0.5f;
+		context->faceUnits[f] = (length > 0.f) ? normal / length : SbVec3f(0.f, 0.f, 0.f);
+	}
+}
+
+
+static void vertexNormals(PyMeshTools::NormalContext *context, size_t start, size_t end)
+{
+	const PyMeshTools::Topology &topology = *context->topology;
+	bool smooth = context->cosCrease <= -1.f;
+
+	for (size_t v = start; v < end; ++v)
+	{
+		int32_t first = topology.vertexStarts[v], last = topology.vertexStarts[v + 1];
+		int32_t count = 0;
+
+		for (int32_t i = first; i < last; ++i)
+		{
+			int32_t corner = topology.vertexCorners[i];
+			int32_t face = topology.cornerFaces[corner];
+
+			// without crease angle all corners of the vertex share one normal
+			if (smooth && (count > 0))
+			{
+				context->cornerSlots[corner] = 0;
+				continue;
+			}
+
+			// area weighted sum of adjacent faces within the crease angle
+			SbVec3f normal(0.f, 0.f, 0.f);
+			for (int32_t j = first; j < last; ++j)
+			{
+				int32_t other = topology.cornerFaces[topology.vertexCorners[j]];
+				if (smooth || (other == face) || (context->faceUnits[face].dot(context->faceUnits[other]) >= context->cosCrease))
+				{
+					normal += context->faceNormals[other];
+				}
+			}
+			float length = normal.length();
+			normal = (length > 0.f) ? normal / length : SbVec3f(0.f, 0.f, 1.f);
+
+			// corners with the same set of faces produce bitwise equal sums
+			int32_t slot = 0;
+			while ((slot < count) && (context->cornerNormals[first + slot] != normal)) slot++;
+			if (slot == count)
+			{
+				context->cornerNormals[first + count++] = normal;
+			}
+			context->cornerSlots[corner] = slot;
+		}
+
+		context->numNormals[v] = count;
+	}
+}
+
+
+static void cellKeys(PyMeshTools::WeldContext *context, size_t start, size_t end)
+{
+	for (size_t v = start; v < end; ++v)
+	{
+		const float *p = context->vertices[v].getValue();
+		if (context->epsilon > 0.f)
+		{
+			int64_t cell[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				double c = floor((double) p[k] / (2.0 * context->epsilon));
+				cell[k] = (int64_t) std::max(-1e18, std::min(1e18, c));
+			}
+			context->keys[v] = ((uint64_t) cell[0] * 73856093ull) ^ ((uint64_t) cell[1] * 19349663ull) ^ ((uint64_t) cell[2] * 83492791ull);
+		}
+		else
+		{
+			// adding zero turns -0 into 0 so that equal positions have equal bits
+			uint32_t bits[3];
+			float q[3] = { p[0] + 0.f, p[1] + 0.f, p[2] + 0.f };
+			memcpy(bits, q, sizeof(bits));
+			context->keys[v] = ((uint64_t) bits[0] * 73856093ull) ^ ((uint64_t) bits[1] * 19349663ull) ^ ((uint64_t) bits[2] * 83492791ull);
+		}
+	}
+}
+
+
+static void weldTargets(PyMeshTools::WeldContext *context, size_t start, size_t end)
+{
+	float epsilon2 = context->epsilon * context->epsilon;
+	int range = (context->epsilon > 0.f) ? 1 : 0;
+	size_t numVertices = context->sorted.size();
+
+	for (size_t v = start; v < end; ++v)
+	{
+		const SbVec3f &p = context->vertices[v];
+		int32_t target = (int32_t) v;
+
+		// cells are twice epsilon wide, so only the closer neighbor along
+		// each axis can hold vertices within reach
+		int64_t cell[3] = { 0, 0, 0 }, step[3] = { 0, 0, 0 };
+		for (int k = 0; (k < 3) && range; ++k)
+		{
+			double c = (double) p[k] / (2.0 * context->epsilon);
+			cell[k] = (int64_t) std::max(-1e18, std::min(1e18, floor(c)));
+			step[k] = (c - floor(c) < 0.5) ? -1 : 1;
+		}
+
+		for (int n = 0; n < (range ? 8 : 1); ++n)
+		{
+			int64_t x = cell[0] + ((n & 1) ? step[0] : 0), y = cell[1] + ((n & 2) ? step[1] : 0), z = cell[2] + ((n & 4) ? step[2] : 0);
+			uint64_t key = range ? ((uint64_t) x * 73856093ull) ^ ((uint64_t) y * 19349663ull) ^ ((uint64_t) z * 83492791ull) : context->keys[v];
+			std::unordered_map<uint64_t, int32_t>::const_iterator it = context->cells.find(key);
+			if (it == context->cells.end()) continue;
+
+			// vertices of a cell are sorted by index
+			for (size_t i = (size_t) it->second; (i < numVertices) && (context->keys[context->sorted[i]] == key); ++i)
+			{
+				int32_t u = context->sorted[i];
+				if (u >= target) break;
+
+				SbVec3f d = context->vertices[u] - p;
+				bool match = range ? (d.dot(d) <= epsilon2) : (context->vertices[u] == p);
+				if (match) target = u;
+			}
+		}
+
+		context->targets[v] = target;
+	}
+}
+
+
+struct CompareKeys
+{
+	const uint64_t *keys;
+	bool operator()(int32_t a, int32_t b) const { return (keys[a] < keys[b]) || ((keys[a] == keys[b]) && (a < b)); }
+};
+
+
+PyObject* PyMeshTools::compute_normals(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *shapeObj = NULL, *coordinatesObj = NULL, *normalObj = NULL;
+	float creaseAngle = 0.5f;
+
+	static char *kwlist[] = { "shape", "crease_angle", "coordinates", "normal", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|fOO", kwlist, &shapeObj, &creaseAngle, &coordinatesObj, &normalObj))
+	{
+		return NULL;
+	}
+
+	if (coordinatesObj == Py_None) coordinatesObj = NULL;
+	if (normalObj == Py_None) normalObj = NULL;
+
+	SoIndexedFaceSet *faceSet = (SoIndexedFaceSet *) getNode(shapeObj, SoIndexedFaceSet::getClassTypeId());
+	SoCoordinate3 *coordinates = (SoCoordinate3 *) getNode(coordinatesObj, SoCoordinate3::getClassTypeId());
+	SoNormal *normal = (SoNormal *) getNode(normalObj, SoNormal::getClassTypeId());
+	if (!faceSet || (coordinatesObj && !coordinates) || (normalObj && !normal))
+	{
+		PyErr_SetString(PyExc_TypeError, "shape must be an IndexedFaceSet, coordinates a Coordinate3 and normal a Normal node");
+		return NULL;
+	}
+
+	SoVertexProperty *vertexProperty = getVertexProperty(faceSet);
+	const SoMFVec3f *vertexField = coordinates ? &coordinates->point : (vertexProperty ? &vertexProperty->vertex : NULL);
+	if (!vertexField || (vertexField->getNum() == 0))
+	{
+		PyErr_SetString(PyExc_ValueError, "shape has no vertices in its VertexProperty, pass a Coordinate3 node as coordinates");
+		return NULL;
+	}
+
+	Topology topology;
+	int numIndices = faceSet->coordIndex.getNum();
+	int numVertices = vertexField->getNum();
+	if (!buildTopology(faceSet->coordIndex.getValues(0), numIndices, numVertices, topology))
+	{
+		PyErr_SetString(PyExc_ValueError, "coordIndex contains indices outside of vertex range");
+		return NULL;
+	}
+
+	NormalContext context;
+	context.coordIndex = faceSet->coordIndex.getValues(0);
+	context.vertices = vertexField->getValues(0);
+	context.topology = &topology;
+	context.cosCrease = (creaseAngle >= 3.14159265f) ? -1.f : cosf(std::max(0.f, creaseAngle));
+	context.faceNormals.resize(topology.faceStarts.size());
+	context.faceUnits.resize(topology.faceStarts.size());
+	context.cornerNormals.resize(topology.vertexCorners.size());
+	context.cornerSlots.resize(numIndices, 0);
+	context.numNormals.resize(numVertices, 0);
+
+	runParallel(faceNormals, &context, topology.faceStarts.size());
+	runParallel(vertexNormals, &context, (size_t) numVertices);
+
+	// a single normal per vertex is indexed like the vertices, otherwise
+	// the normals of each vertex are numbered consecutively
+	bool perVertex = true;
+	for (int v = 0; (v < numVertices) && perVertex; ++v)
+	{
+		if (context.numNormals[v] > 1) perVertex = false;
+	}
+
+	std::vector<SbVec3f> normals;
+	std::vector<int32_t> normalIndex;
+	if (perVertex)
+	{
+		normals.resize(numVertices, SbVec3f(0.f, 0.f, 1.f));
+		for (int v = 0; v < numVertices; ++v)
+		{
+			if (context.numNormals[v]) normals[v] = context.cornerNormals[topology.vertexStarts[v]];
+		}
+	}
+	else
+	{
+		std::vector<int32_t> base(numVertices + 1, 0);
+		for (int v = 0; v < numVertices; ++v)
+		{
+			base[v + 1] = base[v] + context.numNormals[v];
+		}
+
+		normals.resize(base[numVertices]);
+		for (int v = 0; v < numVertices; ++v)
+		{
+			for (int32_t k = 0; k < context.numNormals[v]; ++k)
+			{
+				normals[base[v] + k] = context.cornerNormals[topology.vertexStarts[v] + k];
+			}
+		}
+
+		normalIndex.resize(numIndices);
+		for (int i = 0; i < numIndices; ++i)
+		{
+			normalIndex[i] = (topology.cornerFaces[i] >= 0) ? base[context.coordIndex[i]] + context.cornerSlots[i] : -1;
+		}
+	}
+
+	// results are written in one bulk update per field
+	if (normal)
+	{
+		setVectors(normal->vector, normals.empty() ? NULL : &normals[0], normals.size());
+	}
+	else
+	{
+		if (!vertexProperty)
+		{
+			vertexProperty = new SoVertexProperty();
+			faceSet->vertexProperty = vertexProperty;
+		}
+		setVectors(vertexProperty->normal, normals.empty() ? NULL : &normals[0], normals.size());
+		vertexProperty->normalBinding = SoVertexProperty::PER_VERTEX_INDEXED;
+	}
+
+	faceSet->normalIndex.setNum((int) normalIndex.size());
+	if (!normalIndex.empty())
+	{
+		memcpy(faceSet->normalIndex.startEditing(), &normalIndex[0], normalIndex.size() * sizeof(int32_t));
+		faceSet->normalIndex.finishEditing();
+	}
+
+	return PyLong_FromLong((long) normals.size());
+}
+
+
+PyObject* PyMeshTools::weld(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *shapeObj = NULL;
+	float epsilon = 0.f;
+
+	static char *kwlist[] = { "shape", "epsilon", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|f", kwlist, &shapeObj, &epsilon))
+	{
+		return NULL;
+	}
+
+	SoIndexedShape *shape = (SoIndexedShape *) getNode(shapeObj, SoIndexedShape::getClassTypeId());
+	if (!shape)
+	{
+		PyErr_SetString(PyExc_TypeError, "shape must be an indexed shape");
+		return NULL;
+	}
+
+	SoVertexProperty *vertexProperty = getVertexProperty(shape);
+	if (!vertexProperty)
+	{
+		PyErr_SetString(PyExc_ValueError, "shape must have a VertexProperty holding its vertices");
+		return NULL;
+	}
+
+	int numVertices = vertexProperty->vertex.getNum();
+	int numIndices = shape->coordIndex.getNum();
+	const int32_t *coordIndex = shape->coordIndex.getValues(0);
+	for (int i = 0; i < numIndices; ++i)
+	{
+		if (coordIndex[i] >= numVertices)
+		{
+			PyErr_SetString(PyExc_ValueError, "coordIndex contains indices outside of vertex range");
+			return NULL;
+		}
+	}
+
+	WeldContext context;
+	context.vertices = vertexProperty->vertex.getValues(0);
+	context.epsilon = std::max(0.f, epsilon);
+	context.keys.resize(numVertices);
+	context.sorted.resize(numVertices);
+	context.targets.resize(numVertices);
+
+	runParallel(cellKeys, &context, (size_t) numVertices);
+
+	for (int v = 0; v < numVertices; ++v)
+	{
+		context.sorted[v] = v;
+	}
+	CompareKeys compare = { numVertices ? &context.keys[0] : NULL };
+	std::sort(context.sorted.begin(), context.sorted.end(), compare);
+	for (int i = numVertices - 1; i >= 0; --i)
+	{
+		context.cells[context.keys[context.sorted[i]]] = i;
+	}
+
+	runParallel(weldTargets, &context, (size_t) numVertices);
+
+	// targets have lower indices, so following them in order resolves chains
+	std::vector<int32_t> remap(numVertices);
+	int32_t numWelded = 0;
+	for (int v = 0; v < numVertices; ++v)
+	{
+		int32_t target = context.targets[v];
+		remap[v] = (target == v) ? numWelded++ : remap[target];
+	}
+
+	if (numWelded < numVertices)
+	{
+		// attributes indexed through coordIndex keep the original indices
+		if ((vertexProperty->normal.getNum() > 0) && (vertexProperty->normalBinding.getValue() == SoVertexProperty::PER_VERTEX_INDEXED) && !hasIndices(shape->normalIndex))
+		{
+			shape->normalIndex.setValues(0, numIndices, coordIndex);
+		}
+		if ((vertexProperty->orderedRGBA.getNum() > 1) && (vertexProperty->materialBinding.getValue() == SoVertexProperty::PER_VERTEX_INDEXED) && !hasIndices(shape->materialIndex))
+		{
+			shape->materialIndex.setValues(0, numIndices, coordIndex);
+		}
+		if ((vertexProperty->texCoord.getNum() > 0) && !hasIndices(shape->textureCoordIndex))
+		{
+			shape->textureCoordIndex.setValues(0, numIndices, coordIndex);
+		}
+
+		int32_t *indices = shape->coordIndex.startEditing();
+		for (int i = 0; i < numIndices; ++i)
+		{
+			if (indices[i] >= 0) indices[i] = remap[indices[i]];
+		}
+		shape->coordIndex.finishEditing();
+
+		// remaining vertices only move towards the front
+		SbVec3f *vertices = vertexProperty->vertex.startEditing();
+		for (int v = 0; v < numVertices; ++v)
+		{
+			if (context.targets[v] == v) vertices[remap[v]] = vertices[v];
+		}
+		vertexProperty->vertex.finishEditing();
+		vertexProperty->vertex.setNum(numWelded);
+	}
+
+	return PyLong_FromLong((long) numWelded);
+}
+
+
+PyObject* PyMeshTools::optimize_vertex_cache(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *shapeObj = NULL;
+	int cacheSize = 32;
+
+	static char *kwlist[] = { "shape", "cache_size", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist, &shapeObj, &cacheSize))
+	{
+		return NULL;
+	}
+
+	SoIndexedShape *shape = (SoIndexedShape *) getNode(shapeObj, SoIndexedFaceSet::getClassTypeId());
+	if (!shape) shape = (SoIndexedShape *) getNode(shapeObj, SoIndexedTriangleStripSet::getClassTypeId());
+	if (!shape)
+	{
+		PyErr_SetString(PyExc_TypeError, "shape must be an IndexedFaceSet or IndexedTriangleStripSet");
+		return NULL;
+	}
+
+	SoVertexProperty *vertexProperty = getVertexProperty(shape);
+	if (!vertexProperty)
+	{
+		PyErr_SetString(PyExc_ValueError, "shape must have a VertexProperty holding its vertices");
+		return NULL;
+	}
+
+	// strips are rebuilt from single triangles, which only works if all
+	// attributes are indexed like the vertices
+	bool strips = shape->isOfType(SoIndexedTriangleStripSet::getClassTypeId());
+	if (strips && (hasIndices(shape->normalIndex) || hasIndices(shape->materialIndex) || hasIndices(shape->textureCoordIndex) ||
+		((vertexProperty->normal.getNum() > 1) && (isPerFace(vertexProperty->normalBinding.getValue()) || (vertexProperty->normalBinding.getValue() == SoVertexProperty::PER_VERTEX))) ||
+		((vertexProperty->orderedRGBA.getNum() > 1) && (isPerFace(vertexProperty->materialBinding.getValue()) || (vertexProperty->materialBinding.getValue() == SoVertexProperty::PER_VERTEX)))))
+	{
+		PyErr_SetString(PyExc_ValueError, "strips can only be reordered if all attributes are bound per vertex through coordIndex");
+		return NULL;
+	}
+
+	cacheSize = std::max(4, cacheSize);
+	int numVertices = vertexProperty->vertex.getNum();
+	int numIndices = shape->coordIndex.getNum();
+	const int32_t *coordIndex = shape->coordIndex.getValues(0);
+
+	std::vector<int32_t> triangles;
+	Topology topology;
+	bool valid = strips ? expandStrips(coordIndex, numIndices, numVertices, triangles) : true;
+	const int32_t *faces = strips ? (triangles.empty() ? NULL : &triangles[0]) : coordIndex;
+	int numFaceIndices = strips ? (int) triangles.size() : numIndices;
+	if (!valid || !buildTopology(faces, numFaceIndices, numVertices, topology))
+	{
+		PyErr_SetString(PyExc_ValueError, "coordIndex contains indices outside of vertex range");
+		return NULL;
+	}
+
+	double missesBefore = cacheMisses(coordIndex, numIndices, numVertices, cacheSize);
+
+	std::vector<int32_t> order;
+	orderFaces(faces, topology, cacheSize, order);
+
+	// faces in new order, each followed by a terminator, corners remember
+	// their position in the original coordIndex
+	std::vector<int32_t> indices, corners;
+	indices.reserve(numFaceIndices + 1);
+	corners.reserve(numFaceIndices + 1);
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		int32_t start = topology.faceStarts[order[i]];
+		for (int32_t k = 0; k < topology.faceSizes[order[i]]; ++k)
+		{
+			indices.push_back(faces[start + k]);
+			corners.push_back(start + k);
+		}
+		indices.push_back(-1);
+		corners.push_back(-1);
+	}
+
+	if (strips)
+	{
+		std::vector<int32_t> ordered;
+		ordered.swap(indices);
+		buildStrips(ordered, indices);
+	}
+	else
+	{
+		// attributes of faces and corners move with their faces
+		SoMFInt32 *indexFields[] = { &shape->normalIndex, &shape->materialIndex, &shape->textureCoordIndex };
+		for (int j = 0; j < 3; ++j)
+		{
+			if (!hasIndices(*indexFields[j])) continue;
+			if (indexFields[j]->getNum() == numIndices)
+			{
+				std::vector<int32_t> values(indexFields[j]->getValues(0), indexFields[j]->getValues(0) + numIndices);
+				std::vector<int32_t> reordered(corners.size());
+				for (size_t i = 0; i < corners.size(); ++i)
+				{
+					reordered[i] = (corners[i] >= 0) ? values[corners[i]] : -1;
+				}
+				setIndices(*indexFields[j], reordered);
+			}
+			else
+			{
+				reorderValues<SoMFInt32, int32_t>(*indexFields[j], order);
+			}
+		}
+
+		// values bound per corner without index are numbered over the corners only
+		std::vector<int32_t> cornerNumbers(numIndices, 0), cornerSources;
+		for (int i = 0, n = 0; i < numIndices; ++i)
+		{
+			cornerNumbers[i] = n;
+			if (topology.cornerFaces[i] >= 0) n++;
+		}
+		cornerSources.reserve(corners.size());
+		for (size_t i = 0; i < corners.size(); ++i)
+		{
+			if (corners[i] >= 0) cornerSources.push_back(cornerNumbers[corners[i]]);
+		}
+
+		int normalBinding = vertexProperty->normalBinding.getValue();
+		if ((normalBinding == SoVertexProperty::PER_FACE) || (normalBinding == SoVertexProperty::PER_PART)) reorderValues<SoMFVec3f, SbVec3f>(vertexProperty->normal, order);
+		if (normalBinding == SoVertexProperty::PER_VERTEX) reorderValues<SoMFVec3f, SbVec3f>(vertexProperty->normal, cornerSources);
+
+		int materialBinding = vertexProperty->materialBinding.getValue();
+		if ((materialBinding == SoVertexProperty::PER_FACE) || (materialBinding == SoVertexProperty::PER_PART)) reorderValues<SoMFUInt32, uint32_t>(vertexProperty->orderedRGBA, order);
+		if (materialBinding == SoVertexProperty::PER_VERTEX) reorderValues<SoMFUInt32, uint32_t>(vertexProperty->orderedRGBA, cornerSources);
+	}
+
+	// vertices are numbered in order of first use for fetch locality,
+	// unused vertices keep their order at the end
+	std::vector<int32_t> newIndices(numVertices, -1), vertexOrder;
+	vertexOrder.reserve(numVertices);
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		if ((indices[i] >= 0) && (newIndices[indices[i]] < 0))
+		{
+			newIndices[indices[i]] = (int32_t) vertexOrder.size();
+			vertexOrder.push_back(indices[i]);
+		}
+	}
+	for (int v = 0; v < numVertices; ++v)
+	{
+		if (newIndices[v] < 0)
+		{
+			newIndices[v] = (int32_t) vertexOrder.size();
+			vertexOrder.push_back(v);
+		}
+	}
+
+	// attributes indexed through coordIndex follow the vertices if there is
+	// one per vertex, otherwise they keep the current indices explicitly
+	if ((vertexProperty->normal.getNum() > 0) && (vertexProperty->normalBinding.getValue() == SoVertexProperty::PER_VERTEX_INDEXED) && !hasIndices(shape->normalIndex))
+	{
+		if (vertexProperty->normal.getNum() >= numVertices) reorderValues<SoMFVec3f, SbVec3f>(vertexProperty->normal, vertexOrder);
+		else setIndices(shape->normalIndex, indices);
+	}
+	if ((vertexProperty->orderedRGBA.getNum() > 1) && (vertexProperty->materialBinding.getValue() == SoVertexProperty::PER_VERTEX_INDEXED) && !hasIndices(shape->materialIndex))
+	{
+		if (vertexProperty->orderedRGBA.getNum() >= numVertices) reorderValues<SoMFUInt32, uint32_t>(vertexProperty->orderedRGBA, vertexOrder);
+		else setIndices(shape->materialIndex, indices);
+	}
+	if ((vertexProperty->texCoord.getNum() > 0) && !hasIndices(shape->textureCoordIndex))
+	{
+		if (vertexProperty->texCoord.getNum() >= numVertices) reorderValues<SoMFVec2f, SbVec2f>(vertexProperty->texCoord, vertexOrder);
+		else setIndices(shape->textureCoordIndex, indices);
+	}
+
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		if (indices[i] >= 0) indices[i] = newIndices[indices[i]];
+	}
+	reorderValues<SoMFVec3f, SbVec3f>(vertexProperty->vertex, vertexOrder);
+	setIndices(shape->coordIndex, indices);
+
+	double missesAfter = cacheMisses(indices.empty() ? NULL : &indices[0], (int) indices.size(), numVertices, cacheSize);
+
+	return Py_BuildValue("(dd)", missesBefore, missesAfter);
+}
+
+
+bool PyMeshTools::buildTopology(const int32_t *coordIndex, int numIndices, int numVertices, Topology &topology_out)
+{
+	topology_out.cornerFaces.assign(numIndices, -1);
+	topology_out.vertexStarts.assign(numVertices + 1, 0);
+
+	// faces are runs of indices separated by negative values
+	bool open = false;
+	for (int i = 0; i < numIndices; ++i)
+	{
+		int32_t index = coordIndex[i];
+		if (index < 0)
+		{
+			open = false;
+			continue;
+		}
+		if (index >= numVertices) return false;
+
+		if (!open)
+		{
+			topology_out.faceStarts.push_back(i);
+			topology_out.faceSizes.push_back(0);
+			open = true;
+		}
+		topology_out.faceSizes.back()++;
+		topology_out.cornerFaces[i] = (int32_t) topology_out.faceStarts.size() - 1;
+		topology_out.vertexStarts[index + 1]++;
+	}
+
+	for (int v = 0; v < numVertices; ++v)
+	{
+		topology_out.vertexStarts[v + 1] += topology_out.vertexStarts[v];
+	}
+
+	std::vector<int32_t> next(topology_out.vertexStarts.begin(), topology_out.vertexStarts.end() - 1);
+	topology_out.vertexCorners.resize(topology_out.vertexStarts[numVertices]);
+	for (int i = 0; i < numIndices; ++i)
+	{
+		if (topology_out.cornerFaces[i] >= 0)
+		{
+			topology_out.vertexCorners[next[coordIndex[i]]++] = i;
+		}
+	}
+
+	return true;
+}
+
+
+bool PyMeshTools::expandStrips(const int32_t *coordIndex, int numIndices, int numVertices, std::vector<int32_t> &triangles_out)
+{
+	// every other triangle of a strip is flipped, degenerate ones are dropped
+	int start = 0;
+	for (int i = 0; i < numIndices; ++i)
+	{
+		int32_t c = coordIndex[i];
+		if (c < 0)
+		{
+			start = i + 1;
+			continue;
+		}
+		if (c >= numVertices) return false;
+		if (i - start < 2) continue;
+
+		int32_t a = coordIndex[i - 2], b = coordIndex[i - 1];
+		if ((i - start) % 2 == 1) std::swap(a, b);
+		if ((a == b) || (b == c) || (a == c)) continue;
+
+		triangles_out.push_back(a);
+		triangles_out.push_back(b);
+		triangles_out.push_back(c);
+		triangles_out.push_back(-1);
+	}
+
+	return true;
+}
+
+
+void PyMeshTools::orderFaces(const int32_t *coordIndex, const Topology &topology, int cacheSize, std::vector<int32_t> &order_out)
+{
+	size_t numFaces = topology.faceStarts.size();
+	size_t numVertices = topology.vertexStarts.size() - 1;
+
+	std::vector<int32_t> remaining(numVertices), cachePositions(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	std::vector<char> emitted(numFaces, 0);
+	for (size_t v = 0; v < numVertices; ++v)
+	{
+		remaining[v] = topology.vertexStarts[v + 1] - topology.vertexStarts[v];
+		vertexScores[v] = vertexScore(-1, remaining[v], cacheSize);
+	}
+
+	int32_t best = -1;
+	float bestScore = -1.f;
+	for (size_t f = 0; f < numFaces; ++f)
+	{
+		float score = 0.f;
+		for (int32_t k = 0; k < topology.faceSizes[f]; ++k)
+		{
+			score += vertexScores[coordIndex[topology.faceStarts[f] + k]];
+		}
+		if (score > bestScore)
+		{
+			best = (int32_t) f;
+			bestScore = score;
+		}
+	}
+
+	std::vector<int32_t> cache, newCache;
+	size_t next = 0;
+	order_out.clear();
+	order_out.reserve(numFaces);
+	while (order_out.size() < numFaces)
+	{
+		if (best < 0)
+		{
+			// no face touches the cache, continue with any remaining face
+			while (emitted[next]) next++;
+			best = (int32_t) next;
+		}
+
+		order_out.push_back(best);
+		emitted[best] = 1;
+
+		// vertices of the face move to the front of the cache, -2 marks
+		// vertices already placed
+		const int32_t *corners = coordIndex + topology.faceStarts[best];
+		newCache.clear();
+		for (int32_t k = 0; k < topology.faceSizes[best]; ++k)
+		{
+			remaining[corners[k]]--;
+			if (cachePositions[corners[k]] != -2)
+			{
+				cachePositions[corners[k]] = -2;
+				newCache.push_back(corners[k]);
+			}
+		}
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			if (cachePositions[cache[i]] != -2)
+			{
+				cachePositions[cache[i]] = -2;
+				newCache.push_back(cache[i]);
+			}
+		}
+		for (size_t i = 0; i < newCache.size(); ++i)
+		{
+			int32_t v = newCache[i];
+			cachePositions[v] = (i < (size_t) cacheSize) ? (int32_t) i : -1;
+			vertexScores[v] = vertexScore(cachePositions[v], remaining[v], cacheSize);
+		}
+		if (newCache.size() > (size_t) cacheSize) newCache.resize(cacheSize);
+		cache.swap(newCache);
+
+		// only faces using cached vertices changed their score
+		best = -1;
+		bestScore = -1.f;
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			int32_t v = cache[i];
+			for (int32_t j = topology.vertexStarts[v]; j < topology.vertexStarts[v + 1]; ++j)
+			{
+				int32_t f = topology.cornerFaces[topology.vertexCorners[j]];
+				if (emitted[f]) continue;
+
+				float score = 0.f;
+				for (int32_t k = 0; k < topology.faceSizes[f]; ++k)
+				{
+					score += vertexScores[coordIndex[topology.faceStarts[f] + k]];
+				}
+				if (score > bestScore)
+				{
+					best = f;
+					bestScore = score;
+				}
+			}
+		}
+	}
+}
+
+
+void PyMeshTools::buildStrips(const std::vector<int32_t> &triangles, std::vector<int32_t> &strips_out)
+{
+	// triangles are stored as (a, b, c, -1) and are appended to the current
+	// strip as long as they share its last edge with matching orientation
+	size_t numTriangles = triangles.size() / 4;
+	strips_out.clear();
+	strips_out.reserve(triangles.size());
+
+	size_t t = 0;
+	while (t < numTriangles)
+	{
+		const int32_t *first = &triangles[t * 4];
+		int rotation = 0;
+		for (int r = 0; (r < 3) && (t + 1 < numTriangles); ++r)
+		{
+			if (continueStrip(first[(r + 2) % 3], first[(r + 1) % 3], &triangles[(t + 1) * 4]) >= 0)
+			{
+				rotation = r;
+				break;
+			}
+		}
+
+		size_t start = strips_out.size();
+		for (int k = 0; k < 3; ++k)
+		{
+			strips_out.push_back(first[(rotation + k) % 3]);
+		}
+
+		for (++t; t < numTriangles; ++t)
+		{
+			// odd triangles of a strip run along the last edge backwards
+			size_t length = strips_out.size() - start;
+			int32_t a = strips_out[start + length - 2], b = strips_out[start + length - 1];
+			int32_t c = (length % 2) ? continueStrip(b, a, &triangles[t * 4]) : continueStrip(a, b, &triangles[t * 4]);
+			if (c < 0) break;
+			strips_out.push_back(c);
+		}
+		strips_out.push_back(-1);
+	}
+}
+
+
+double PyMeshTools::cacheMisses(const int32_t *indices, int numIndices, int numVertices, int cacheSize)
+{
+	// FIFO cache, a vertex stays cached until cacheSize further misses
+	std::vector<int64_t> loaded(numVertices, -(int64_t) cacheSize);
+	int64_t misses = 0, triangles = 0;
+	int run = 0;
+	for (int i = 0; i <= numIndices; ++i)
+	{
+		if ((i == numIndices) || (indices[i] < 0) || (indices[i] >= numVertices))
+		{
+			if (run > 2) triangles += run - 2;
+			run = 0;
+			continue;
+		}
+
+		run++;
+		if (misses - loaded[indices[i]] >= cacheSize)
+		{
+			loaded[indices[i]] = misses++;
+		}
+	}
+
+	return triangles ? (double) misses / (double) triangles : 0.0;
+}
+
+
+SoVertexProperty *PyMeshTools::getVertexProperty(SoVertexShape *shape)
+{
+	SoNode *node = shape->vertexProperty.getValue();
+	return (node && node->isOfType(SoVertexProperty::getClassTypeId())) ? (SoVertexProperty *) node : NULL;
+}
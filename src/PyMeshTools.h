@@ -0,0 +1,78 @@
+/**
+ * \file
+ * \brief      PyMeshTools class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+#include <Inventor/SbLinear.h>
+#include <vector>
+#include <unordered_map>
+
+class SoVertexShape;
+class SoVertexProperty;
+
+
+class PyMeshTools
+{
+public:
+	// module functions
+	static PyObject* compute_normals(PyObject *self, PyObject *args, PyObject *kwds);
+	static PyObject* weld(PyObject *self, PyObject *args, PyObject *kwds);
+	static PyObject* optimize_vertex_cache(PyObject *self, PyObject *args, PyObject *kwds);
+
+	// polygons of a coordIndex field and the corners referencing each vertex,
+	// corners are positions in coordIndex
+	struct Topology
+	{
+		std::vector<int32_t> faceStarts;
+		std::vector<int32_t> faceSizes;
+		std::vector<int32_t> cornerFaces;
+		std::vector<int32_t> vertexStarts;
+		std::vector<int32_t> vertexCorners;
+	};
+
+	// input and intermediate results of normal generation shared by threads,
+	// distinct normals of a vertex are collected in the slots of its corners
+	struct NormalContext
+	{
+		const int32_t *coordIndex;
+		const SbVec3f *vertices;
+		const Topology *topology;
+		float cosCrease;
+		std::vector<SbVec3f> faceNormals;
+		std::vector<SbVec3f> faceUnits;
+		std::vector<SbVec3f> cornerNormals;
+		std::vector<int32_t> cornerSlots;
+		std::vector<int32_t> numNormals;
+	};
+
+	// vertices hashed into cells twice as wide as epsilon, each vertex finds
+	// the lowest index within reach in its own and neighboring cells
+	struct WeldContext
+	{
+		const SbVec3f *vertices;
+		float epsilon;
+		std::vector<uint64_t> keys;
+		std::vector<int32_t> sorted;
+		std::unordered_map<uint64_t, int32_t> cells;
+		std::vector<int32_t> targets;
+	};
+
+private:
+	// internal
+	static bool buildTopology(const int32_t *coordIndex, int numIndices, int numVertices, Topology &topology_out);
+	static bool expandStrips(const int32_t *coordIndex, int numIndices, int numVertices, std::vector<int32_t> &triangles_out);
+	static void orderFaces(const int32_t *coordIndex, const Topology &topology, int cacheSize, std::vector<int32_t> &order_out);
+	static void buildStrips(const std::vector<int32_t> &triangles, std::vector<int32_t> &strips_out);
+	static double cacheMisses(const int32_t *indices, int numIndices, int numVertices, int cacheSize);
+	static SoVertexProperty *getVertexProperty(SoVertexShape *shape);
+};
@@ -0,0 +1,387 @@
+/**
+ * \file
+ * \brief      PyOptimizer class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+#include <Inventor/nodes/SoTransformSeparator.h>
+#include <Inventor/nodes/SoMatrixTransform.h>
+#include <Inventor/nodes/SoCamera.h>
+#include <Inventor/nodes/SoLight.h>
+#include <Inventor/nodes/SoEnvironment.h>
+#include "PyOptimizer.h"
+#include "PyField.h"
+#include "PyPath.h"
+#define PY_ARRAY_UNIQUE_SYMBOL PyInventor_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/ndarrayobject.h>
+#include <algorithm>
+#include <map>
+#include <cstring>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+
+
+// orders spatial items by center along one axis
+struct CompareCenter
+{
+	CompareCenter(int a) : axis(a) {}
+	bool operator()(const PyOptimizer::SpatialItem &a, const PyOptimizer::SpatialItem &b) const { return a.center[axis] < b.center[axis]; }
+	int axis;
+};
+
+
+// orders welded vertices by position and normal, only equality matters
+struct CompareVertex
+{
+	bool operator()(const PyOptimizer::FlatVertex &a, const PyOptimizer::FlatVertex &b) const { return memcmp(&a, &b, sizeof(PyOptimizer::FlatVertex)) < 0; }
+};
+
+
+bool PyOptimizer::isReorderable(SoNode *node)
+{
+	// only plain groups, derived classes like switches or LODs depend on child order
+	return (node->getTypeId() == SoGroup::getClassTypeId()) || (node->getTypeId() == SoSeparator::getClassTypeId());
+}
+
+
+bool PyOptimizer::isSelfContained(SoNode *node)
+{
+	// separators and shapes don't leave state behind, so their order among
+	// each other only matters for blending of unsorted transparent objects
+	return node->isOfType(SoSeparator::getClassTypeId()) || node->isOfType(SoShape::getClassTypeId());
+}
+
+
+SoSeparator *PyOptimizer::buildHierarchy(std::vector<SpatialItem> &items, size_t begin, size_t end, int leafSize, int &count_inout)
+{
+	SoSeparator *sep = new SoSeparator();
+	sep->renderCulling = SoSeparator::ON;
+	sep->boundingBoxCaching = SoSeparator::ON;
+	count_inout++;
+
+	if (end - begin <= (size_t) leafSize)
+	{
+		// leaves are static, cache their rendering
+		sep->renderCaching = SoSeparator::ON;
+		for (size_t i = begin; i < end; ++i)
+		{
+			sep->addChild(items[i].node);
+		}
+		return sep;
+	}
+
+	// split at median of longest axis of item centers
+	SbBox3f bounds;
+	for (size_t i = begin; i < end; ++i)
+	{
+		bounds.extendBy(items[i].center);
+	}
+
+	float dx = 0.f, dy = 0.f, dz = 0.f;
+	bounds.getSize(dx, dy, dz);
+	int axis = (dx >= dy) && (dx >= dz) ? 0 : (dy >= dz ? 1 : 2);
+
+	size_t mid = begin + (end - begin) / 2;
+	std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end, CompareCenter(axis));
+
+	sep->addChild(buildHierarchy(items, begin, mid, leafSize, count_inout));
+	sep->addChild(buildHierarchy(items, mid, end, leafSize, count_inout));
+
+	return sep;
+}
+
+
+int PyOptimizer::optimizeSpatial(SoGroup *group, int leafSize, SoGetBoundingBoxAction &bba, std::set<SoNode*> &visited)
+{
+	int count = 0;
+
+	for (int i = 0; i < group->getNumChildren(); ++i)
+	{
+		SoNode *child = group->getChild(i);
+		if (isReorderable(child) && visited.insert(child).second)
+		{
+			count += optimizeSpatial((SoGroup *) child, leafSize, bba, visited);
+		}
+	}
+
+	// runs of self-contained children between state changing nodes are
+	// replaced by a hierarchy, the other children keep their position
+	std::vector<SoNode*> children;
+	std::vector<SpatialItem> run, empty;
+	bool changed = false;
+
+	for (int i = 0; i <= group->getNumChildren(); ++i)
+	{
+		SoNode *child = (i < group->getNumChildren()) ? group->getChild(i) : NULL;
+		if (child && isSelfContained(child))
+		{
+			SpatialItem item;
+			item.node = child;
+			bba.apply(child);
+			item.box = bba.getBoundingBox();
+			if (item.box.isEmpty())
+			{
+				empty.push_back(item);
+			}
+			else
+			{
+				item.center = item.box.getCenter();
+				run.push_back(item);
+			}
+			continue;
+		}
+
+		if (run.size() > (size_t) leafSize)
+		{
+			children.push_back(buildHierarchy(run, 0, run.size(), leafSize, count));
+			changed = true;
+		}
+		else
+		{
+			for (size_t j = 0; j < run.size(); ++j) children.push_back(run[j].node);
+		}
+
+		for (size_t j = 0; j < empty.size(); ++j) children.push_back(empty[j].node);
+		if (child) children.push_back(child);
+
+		run.clear();
+		empty.clear();
+	}
+
+	if (changed)
+	{
+		for (size_t i = 0; i < children.size(); ++i) children[i]->ref();
+		group->removeAllChildren();
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			group->addChild(children[i]);
+			children[i]->unref();
+		}
+	}
+
+	return count;
+}
+
+
+PyObject* PyOptimizer::optimize(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *root = NULL;
+	const char *strategy = "spatial";
+	int leafSize = 8;
+
+	static char *kwlist[] = { "root", "strategy", "leaf_size", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|si", kwlist, &root, &strategy, &leafSize))
+	{
+		return NULL;
+	}
+
+	SoNode *node = PyNode_Check(root) ? (SoNode *) ((PySceneObject::Object *) root)->inventorObject : NULL;
+	if (!node || !isReorderable(node))
+	{
+		PyErr_SetString(PyExc_TypeError, "Root must be a Group or Separator");
+		return NULL;
+	}
+
+	if (strcmp(strategy, "spatial"))
+	{
+		PyErr_SetString(PyExc_ValueError, "Unknown strategy, must be 'spatial'");
+		return NULL;
+	}
+
+	SoGetBoundingBoxAction bba(SbViewportRegion(512, 512));
+	std::set<SoNode*> visited;
+	visited.insert(node);
+
+	return PyLong_FromLong(optimizeSpatial((SoGroup *) node, leafSize > 0 ? leafSize : 1, bba, visited));
+}
+
+
+
+bool PyOptimizer::isTransparent(const PyGeometry::Material &material)
+{
+	return material.transparency > 0.f;
+}
+
+
+SoNode *PyOptimizer::createMaterial(const PyGeometry::Material &material)
+{
+	SoMaterial *mat = new SoMaterial();
+	mat->ambientColor.setValue(SbColor(material.ambient));
+	mat->diffuseColor.setValue(SbColor(material.diffuse));
+	mat->specularColor.setValue(SbColor(material.specular));
+	mat->emissiveColor.setValue(SbColor(material.emissive));
+	mat->shininess.setValue(material.shininess);
+	mat->transparency.setValue(material.transparency);
+	return mat;
+}
+
+
+SoNode *PyOptimizer::createFaceSet(const PyGeometry::TriangleSoup &soup, const std::vector<int32_t> &triangles)
+{
+	// triangle soup repeats shared vertices, weld those with identical position and normal
+	std::map<FlatVertex, int32_t, CompareVertex> vertexMap;
+	std::vector<SbVec3f> vertices, normals;
+	std::vector<int32_t> coordIndex;
+	coordIndex.reserve(triangles.size() * 4);
+
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		for (size_t j = 0; j < 3; ++j)
+		{
+			size_t v = (size_t) triangles[i] * 3 + j;
+			FlatVertex vertex;
+			memcpy(vertex.position, &soup.vertices[v * 3], sizeof(vertex.position));
+			memcpy(vertex.normal, &soup.normals[v * 3], sizeof(vertex.normal));
+
+			std::map<FlatVertex, int32_t, CompareVertex>::iterator it = vertexMap.find(vertex);
+			if (it == vertexMap.end())
+			{
+				int32_t index = (int32_t) vertices.size();
+				vertexMap[vertex] = index;
+				vertices.push_back(SbVec3f(vertex.position));
+				normals.push_back(SbVec3f(vertex.normal));
+				coordIndex.push_back(index);
+			}
+			else
+			{
+				coordIndex.push_back(it->second);
+			}
+		}
+		coordIndex.push_back(-1);
+	}
+
+	SoVertexProperty *vertexProperty = new SoVertexProperty();
+	vertexProperty->vertex.setValues(0, (int) vertices.size(), &vertices[0]);
+	vertexProperty->normal.setValues(0, (int) normals.size(), &normals[0]);
+	vertexProperty->normalBinding = SoVertexProperty::PER_VERTEX_INDEXED;
+
+	SoIndexedFaceSet *faceSet = new SoIndexedFaceSet();
+	faceSet->coordIndex.setValues(0, (int) coordIndex.size(), &coordIndex[0]);
+	faceSet->vertexProperty = vertexProperty;
+
+	return faceSet;
+}
+
+
+SoCallbackAction::Response PyOptimizer::keepStateCB(void *userdata, SoCallbackAction *action, const SoNode *node)
+{
+	// copies keep the transform they had in the original graph, a transform
+	// separator limits it to the copy while camera and light stay in effect
+	SoGroup *root = (SoGroup *) userdata;
+	SoNode *copy = node->copy();
+	const SbMatrix &matrix = action->getModelMatrix();
+	if (matrix == SbMatrix::identity())
+	{
+		root->addChild(copy);
+	}
+	else
+	{
+		SoTransformSeparator *sep = new SoTransformSeparator();
+		SoMatrixTransform *transform = new SoMatrixTransform();
+		transform->matrix.setValue(matrix);
+		sep->addChild(transform);
+		sep->addChild(copy);
+		root->addChild(sep);
+	}
+
+	return SoCallbackAction::CONTINUE;
+}
+
+
+PyObject* PyOptimizer::flatten(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *applyTo = NULL;
+
+	static char *kwlist[] = { "applyTo", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &applyTo))
+	{
+		return NULL;
+	}
+
+	PyGeometry::TriangleSoup soup(false, true);
+	if (!PyGeometry::extractTriangles(applyTo, soup))
+	{
+		PyErr_SetString(PyExc_TypeError, "Argument must be a node or path");
+		return NULL;
+	}
+
+	// bucket triangles by material, opaque materials are drawn first so
+	// that transparent geometry blends over everything else
+	std::vector<std::vector<int32_t> > buckets(soup.materials.size());
+	for (size_t i = 0; i < soup.materialIds.size(); ++i)
+	{
+		buckets[soup.materialIds[i]].push_back((int32_t) i);
+	}
+
+	std::vector<size_t> order;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (size_t i = 0; i < soup.materials.size(); ++i)
+		{
+			if (!buckets[i].empty() && (isTransparent(soup.materials[i]) == (pass == 1)))
+			{
+				order.push_back(i);
+			}
+		}
+	}
+
+	SoSeparator *root = new SoSeparator();
+	root->ref();
+
+	// cameras, lights and environment are kept ahead of the merged geometry
+	SoCallbackAction ca;
+	ca.addPreCallback(SoCamera::getClassTypeId(), keepStateCB, root);
+	ca.addPreCallback(SoLight::getClassTypeId(), keepStateCB, root);
+	ca.addPreCallback(SoEnvironment::getClassTypeId(), keepStateCB, root);
+	if (PyNode_Check(applyTo))
+	{
+		ca.apply((SoNode*) ((PySceneObject::Object *) applyTo)->inventorObject);
+	}
+	else
+	{
+		ca.apply(PyPath::getInstance(applyTo));
+	}
+
+	PyObject *faceShapes = PyList_New(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const std::vector<int32_t> &triangles = buckets[order[i]];
+		root->addChild(createMaterial(soup.materials[order[i]]));
+		root->addChild(createFaceSet(soup, triangles));
+
+		// face index in new face set to index of original shape
+		std::vector<int32_t> shapeIds(triangles.size());
+		for (size_t j = 0; j < triangles.size(); ++j)
+		{
+			shapeIds[j] = soup.shapeIds[triangles[j]];
+		}
+		PyList_SetItem(faceShapes, i, PyField::getPyObjectArrayFromData(NPY_INT32, &shapeIds[0], (int) shapeIds.size()));
+	}
+
+	PyObject *shapes = PyList_New(soup.shapes.size());
+	for (size_t i = 0; i < soup.shapes.size(); ++i)
+	{
+		PyList_SetItem(shapes, i, PySceneObject::createWrapper(soup.shapes[i]));
+	}
+
+	PyObject *result = Py_BuildValue("(NNN)", PySceneObject::createWrapper(root), shapes, faceShapes);
+	root->unref();
+
+	return result;
+}
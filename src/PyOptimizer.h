@@ -0,0 +1,61 @@
+/**
+ * \file
+ * \brief      PyOptimizer class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+#include "PyGeometry.h"
+#include <Inventor/SbLinear.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <vector>
+#include <set>
+
+class SoNode;
+class SoGroup;
+class SoSeparator;
+class SoGetBoundingBoxAction;
+
+
+class PyOptimizer
+{
+public:
+	// module functions
+	static PyObject* optimize(PyObject *self, PyObject *args, PyObject *kwds);
+	static PyObject* flatten(PyObject *self, PyObject *args, PyObject *kwds);
+
+	// child of a group placed into the spatial hierarchy
+	struct SpatialItem
+	{
+		SoNode *node;
+		SbBox3f box;
+		SbVec3f center;
+	};
+
+	// vertex of a flattened mesh, compared bitwise when welding
+	struct FlatVertex
+	{
+		float position[3];
+		float normal[3];
+	};
+
+private:
+	// internal
+	static bool isReorderable(SoNode *node);
+	static bool isSelfContained(SoNode *node);
+	static int optimizeSpatial(SoGroup *group, int leafSize, SoGetBoundingBoxAction &bba, std::set<SoNode*> &visited);
+	static SoSeparator *buildHierarchy(std::vector<SpatialItem> &items, size_t begin, size_t end, int leafSize, int &count_inout);
+	static bool isTransparent(const PyGeometry::Material &material);
+	static SoNode *createMaterial(const PyGeometry::Material &material);
+	static SoNode *createFaceSet(const PyGeometry::TriangleSoup &soup, const std::vector<int32_t> &triangles);
+	static SoCallbackAction::Response keepStateCB(void *userdata, SoCallbackAction *action, const SoNode *node);
+};
+
@@ -12,6 +12,7 @@
 
 #include <Inventor/SoPath.h>
 #include <Inventor/nodes/SoNode.h>
+#include <Inventor/misc/SoChildList.h>
 #include <Inventor/SbName.h>
 #include "PyPath.h"
 
@@ -22,6 +23,17 @@
 
 PyTypeObject *PyPath::getType()
 {
+    static PyMethodDef methods[] =
+    {
+        { "__reduce__", (PyCFunction)reduce, METH_NOARGS,
+            "Returns state for pickling a path.\n"
+            "\n"
+            "The path is stored as its head node (including the whole subgraph)\n"
+            "and the child indices leading to the tail.\n"
+        },
+        { NULL }  /* Sentinel */
+    };
+
     static PySequenceMethods sequence_methods[] =
     {
         (lenfunc)sq_length,       /* sq_length */
@@ -39,7 +51,7 @@ PyTypeObject *PyPath::getType()
 	static PyTypeObject pathType = 
 	{
 		PyVarObject_HEAD_INIT(NULL, 0)
-		"Path",                    /* tp_name */
+		"inventor.Path",           /* tp_name (qualified so paths can be pickled) */
 		sizeof(Object),            /* tp_basicsize */
 		0,                         /* tp_itemsize */
 		(destructor) tp_dealloc,   /* tp_dealloc */
@@ -62,14 +74,15 @@ PyTypeObject *PyPath::getType()
         "Represents a traversal path.\n"
         "\n"
         "This object describes a traversal path and is used as return type\n"
-        "of search actions.\n",    /* tp_doc */
+        "of search actions. A path can also be constructed from a head node\n"
+        "and a sequence of child indices.\n",    /* tp_doc */
 		0,                         /* tp_traverse */
 		0,                         /* tp_clear */
         (richcmpfunc)tp_richcompare, /* tp_richcompare */
         0,                         /* tp_weaklistoffset */
 		0,                         /* tp_iter */
 		0,                         /* tp_iternext */
-		0,                         /* tp_methods */
+		methods,                   /* tp_methods */
 		0,                         /* tp_members */
 		0,                         /* tp_getset */
 		0,                         /* tp_base */
@@ -109,9 +122,62 @@ PyObject* PyPath::tp_new(PyTypeObject *type, PyObject* /*args*/, PyObject* /*kwd
 }
 
 
-int PyPath::tp_init(Object * /*self*/, PyObject * /*args*/, PyObject * /*kwds*/)
+int PyPath::tp_init(Object *self, PyObject *args, PyObject * /*kwds*/)
 {
-	Py_INCREF(Py_None);
+    PyObject *head = 0, *indices = 0;
+    if (args && !PyArg_ParseTuple(args, "|OO", &head, &indices))
+    {
+        return -1;
+    }
+
+    if (!head || (head == Py_None))
+    {
+        return 0;
+    }
+
+    if (!PyNode_Check(head) || !((PySceneObject::Object*) head)->inventorObject)
+    {
+        PyErr_SetString(PyExc_TypeError, "Path head must be a Node");
+        return -1;
+    }
+    if (indices && (indices != Py_None) && !PySequence_Check(indices))
+    {
+        PyErr_SetString(PyExc_TypeError, "Path indices must be a sequence of child indices");
+        return -1;
+    }
+
+    SoPath *path = new SoPath((SoNode*) ((PySceneObject::Object*) head)->inventorObject);
+    path->ref();
+
+    Py_ssize_t num = (indices && (indices != Py_None)) ? PySequence_Size(indices) : 0;
+    for (Py_ssize_t i = 0; i < num; ++i)
+    {
+        PyObject *item = PySequence_GetItem(indices, i);
+        long index = (item && PyLong_Check(item)) ? PyLong_AsLong(item) : -1;
+        bool isIndex = item && PyLong_Check(item) && !PyErr_Occurred();
+        Py_XDECREF(item);
+
+        SoNode *tail = path->getTail();
+        if (!isIndex)
+        {
+            if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "Path indices must be integers");
+        }
+        else if (!tail->getChildren() || (index < 0) || (index >= tail->getChildren()->getLength()))
+        {
+            PyErr_Format(PyExc_IndexError, "Path index %ld out of range for %s", index, tail->getTypeId().getName().getString());
+        }
+        else
+        {
+            path->append((int) index);
+            continue;
+        }
+
+        path->unref();
+        return -1;
+    }
+
+    ((PyPath*) self)->setInstance(path);
+    path->unref();
 
 	return 0;
 }
@@ -233,3 +299,23 @@ PyObject *PyPath::sq_item(Object *self, Py_ssize_t idx)
 
     return NULL;
 }
+
+
+PyObject* PyPath::reduce(Object *self)
+{
+    if (self->path && self->path->getLength())
+    {
+        PyObject *indices = PyTuple_New(self->path->getLength() - 1);
+        for (int i = 1; i < self->path->getLength(); ++i)
+        {
+            PyTuple_SetItem(indices, i - 1, PyLong_FromLong(self->path->getIndex(i)));
+        }
+
+        PyObject *head = PySceneObject::createWrapper(self->path->getHead());
+        Py_INCREF(Py_TYPE(self));
+        return Py_BuildValue("(N(NN))", Py_TYPE(self), head, indices);
+    }
+
+    PyErr_SetString(PyExc_TypeError, "Empty path cannot be pickled");
+    return NULL;
+}
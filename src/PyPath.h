@@ -38,6 +38,9 @@ private:
 	static int tp_init(Object *self, PyObject *args, PyObject *kwds);
     static PyObject *tp_richcompare(Object *a, PyObject *b, int op);
 
+    // methods
+    static PyObject* reduce(Object *self);
+
     // sequence implementation
     static Py_ssize_t sq_length(Object *self);
     static int sq_contains(Object *self, PyObject *item);
@@ -0,0 +1,951 @@
+/**
+ * \file
+ * \brief      PyProfiler class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/SoPath.h>
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/actions/SoRayPickAction.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/lists/SoActionMethodList.h>
+#include <Inventor/lists/SoTypeList.h>
+#include <Inventor/engines/SoEngine.h>
+#include <Inventor/engines/SoOutputData.h>
+#include <Inventor/fields/SoFieldData.h>
+#include <Inventor/sensors/SoFieldSensor.h>
+#include <Inventor/nodes/SoNode.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/elements/SoViewVolumeElement.h>
+#include <Inventor/elements/SoViewportRegionElement.h>
+#include "PyProfiler.h"
+#include "PyField.h"
+#define PY_ARRAY_UNIQUE_SYMBOL PyInventor_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/ndarrayobject.h>
+#include <set>
+#include <map>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <mutex>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+
+
+// pass-through engine inserted behind an engine output to time its evaluation
+class SoEngineProbe : public SoEngine
+{
+public:
+	static void initClass();
+	static SoType getClassTypeId() { return classTypeId; }
+	virtual SoType getTypeId() const { return classTypeId; }
+	virtual const SoFieldData *getFieldData() const { return inputData; }
+	virtual const SoEngineOutputData *getOutputData() const { return outputData; }
+
+	SoEngineProbe(SoEngineOutput *source, PyProfiler::EngineStats *stats);
+
+	SoField *input;
+	SoEngineOutput output;
+	SoEngineOutput *source;
+	std::vector<SoField*> slaves;
+
+protected:
+	virtual ~SoEngineProbe();
+	virtual void evaluate();
+
+private:
+	static SoType classTypeId;
+
+	SoFieldData *inputData;
+	SoEngineOutputData *outputData;
+	PyProfiler::EngineStats *stats;
+};
+
+
+// state of running engine profile
+static std::vector<PyProfiler::EngineStats*> engineStats;
+static std::vector<SoEngineProbe*> engineProbes;
+
+// time spent in nested probes, one entry per probe currently evaluating
+static std::vector<double> childTimes;
+
+
+// gives access to the method table of an action class
+template <class T> class ActionMethods : public T
+{
+public:
+	static SoActionMethodList *get() { return T::getClassActionMethods(); }
+};
+
+
+template <int A> static void profiledMethod(SoAction *action, SoNode *node)
+{
+	PyProfiler::traverseProfiled(A, action, node);
+}
+
+
+// action classes whose node traversal can be profiled
+static struct
+{
+	const char *name;
+	SoActionMethodList *(*getMethods)();
+	void (*addMethod)(const SoType, SoActionMethod);
+	SoActionMethod profiled;
+	std::vector<SoActionMethod> original;
+	SoTypeList types;
+	int users;
+	bool profiling;
+} profiledActions[] =
+{
+	{ "GLRender", ActionMethods<SoGLRenderAction>::get, SoGLRenderAction::addMethod, profiledMethod<0>, std::vector<SoActionMethod>(), SoTypeList(), 0, false },
+	{ "RayPick", ActionMethods<SoRayPickAction>::get, SoRayPickAction::addMethod, profiledMethod<1>, std::vector<SoActionMethod>(), SoTypeList(), 0, false },
+	{ "GetBoundingBox", ActionMethods<SoGetBoundingBoxAction>::get, SoGetBoundingBoxAction::addMethod, profiledMethod<2>, std::vector<SoActionMethod>(), SoTypeList(), 0, false },
+	{ "Search", ActionMethods<SoSearchAction>::get, SoSearchAction::addMethod, profiledMethod<3>, std::vector<SoActionMethod>(), SoTypeList(), 0, false },
+};
+
+static const int NUM_PROFILED_ACTIONS = sizeof(profiledActions) / sizeof(profiledActions[0]);
+
+
+// measurements of one node in the traversal call tree, nodes reached
+// along different paths have separate entries
+struct TraversalEntry
+{
+	Py_ssize_t parent;
+	int action;
+	const char *type;
+	const char *name;
+	Py_ssize_t visits;
+	double inclusive, exclusive;
+};
+
+// state of running traversal profile
+static std::vector<TraversalEntry> traversalEntries;
+static std::map<std::pair<Py_ssize_t, SoNode*>, Py_ssize_t> traversalIndex;
+static std::vector<std::pair<Py_ssize_t, double> > traversalStack;
+
+PyProfiler::RenderCounters *PyProfiler::renderCounters = NULL;
+
+
+// trace events are only written by the thread that owns the buffer and
+// only read by flush_trace(), all instrumented entry points hold the GIL
+struct TraceEvent
+{
+	const char *name;
+	double start, end;
+};
+
+struct TraceBuffer
+{
+	int threadId;
+	std::vector<TraceEvent> events;
+};
+
+static std::mutex traceMutex;
+static std::vector<TraceBuffer*> traceBuffers;
+static thread_local TraceBuffer *threadTraceBuffer = NULL;
+static double traceStart = 0.;
+
+bool PyProfiler::tracing = false;
+
+
+SoType SoEngineProbe::classTypeId;
+
+
+void SoEngineProbe::initClass()
+{
+	if (classTypeId.isBad())
+	{
+		classTypeId = SoType::createType(SoEngine::getClassTypeId(), "EngineProbe");
+	}
+}
+
+
+SoEngineProbe::SoEngineProbe(SoEngineOutput *sourceOutput, PyProfiler::EngineStats *profiledStats) : source(sourceOutput), stats(profiledStats)
+{
+	input = (SoField *) source->getConnectionType().createInstance();
+	input->setContainer(this);
+
+	inputData = new SoFieldData();
+	inputData->addField(this, "input", input);
+	outputData = new SoEngineOutputData();
+	outputData->addOutput(this, "output", &output, source->getConnectionType());
+	output.setContainer(this);
+
+	isBuiltIn = FALSE;
+}
+
+
+SoEngineProbe::~SoEngineProbe()
+{
+	delete input;
+	delete inputData;
+	delete outputData;
+}
+
+
+void SoEngineProbe::evaluate()
+{
+	// reading the input evaluates the profiled engine if it is out of date,
+	// probes of upstream engines evaluated meanwhile report their time
+	double start = PyProfiler::getTime();
+	childTimes.push_back(0.);
+	input->evaluate();
+	double inclusive = PyProfiler::getTime() - start;
+	double children = childTimes.back();
+	childTimes.pop_back();
+	if (!childTimes.empty())
+	{
+		childTimes.back() += inclusive;
+	}
+
+	if (stats->dirty)
+	{
+		stats->evaluations++;
+		stats->dirty = false;
+	}
+	stats->inclusive += inclusive;
+	stats->exclusive += inclusive - children;
+
+	if (!source->isEnabled()) return;
+
+	for (int i = 0; i < output.getNumConnections(); ++i)
+	{
+		SoField *field = output[i];
+		if (!field->isReadOnly()) field->copyFrom(*input);
+	}
+}
+
+
+double PyProfiler::getTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void PyProfiler::collectEngines(SoNode *root, std::vector<SoEngine*> &engines_out)
+{
+	std::set<SoFieldContainer*> visited;
+	std::vector<SoFieldContainer*> pending;
+
+	SoSearchAction sa;
+	sa.setType(SoNode::getClassTypeId());
+	sa.setSearchingAll(TRUE);
+	sa.setInterest(SoSearchAction::ALL);
+	sa.apply(root);
+
+	SoPathList &pl = sa.getPaths();
+	for (int i = 0; i < pl.getLength(); ++i)
+	{
+		SoNode *node = pl[i]->getTail();
+		if (node && visited.insert(node).second)
+		{
+			pending.push_back(node);
+		}
+	}
+
+	// follow connections from node fields upstream through engine inputs
+	while (!pending.empty())
+	{
+		SoFieldContainer *container = pending.back();
+		pending.pop_back();
+
+		SoFieldList fields;
+		container->getFields(fields);
+		for (int i = 0; i < fields.getLength(); ++i)
+		{
+			SoEngineOutput *output = 0;
+			if (fields[i]->isConnectedFromEngine() && fields[i]->getConnectedEngine(output) && output)
+			{
+				SoEngine *engine = output->getContainer();
+				if (engine && visited.insert(engine).second)
+				{
+					engines_out.push_back(engine);
+					pending.push_back(engine);
+				}
+			}
+		}
+	}
+}
+
+
+void PyProfiler::insertProbes(EngineStats *stats)
+{
+	SoEngineOutputList outputs;
+	stats->engine->getOutputs(outputs);
+
+	for (int i = 0; i < outputs.getLength(); ++i)
+	{
+		SoEngineOutput *output = outputs[i];
+		SoFieldList slaves;
+		output->getForwardConnections(slaves);
+		if (!slaves.getLength()) continue;
+
+		stats->fanout += slaves.getLength();
+
+		SoEngineProbe *probe = new SoEngineProbe(output, stats);
+		probe->ref();
+		probe->input->connectFrom(output);
+
+		for (int j = 0; j < slaves.getLength(); ++j)
+		{
+			SoField *slave = slaves[j];
+			slave->getContainer()->ref();
+			slave->disconnect(output);
+			if (slave->isConnected())
+			{
+				slave->appendConnection(&probe->output);
+			}
+			else
+			{
+				slave->connectFrom(&probe->output);
+			}
+			probe->slaves.push_back(slave);
+		}
+
+		engineProbes.push_back(probe);
+	}
+}
+
+
+void PyProfiler::removeProbes()
+{
+	for (size_t i = 0; i < engineProbes.size(); ++i)
+	{
+		SoEngineProbe *probe = engineProbes[i];
+		for (size_t j = 0; j < probe->slaves.size(); ++j)
+		{
+			// slaves rewired while profiling keep their new connection
+			SoField *slave = probe->slaves[j];
+			SoEngineOutput *master = NULL;
+			if (slave->isConnectedFromEngine() && slave->getConnectedEngine(master) && (master == &probe->output))
+			{
+				slave->disconnect(&probe->output);
+				if (slave->isConnected())
+				{
+					slave->appendConnection(probe->source);
+				}
+				else
+				{
+					slave->connectFrom(probe->source);
+				}
+			}
+			slave->getContainer()->unref();
+		}
+
+		probe->input->disconnect();
+		probe->unref();
+	}
+	engineProbes.clear();
+
+	for (size_t i = 0; i < engineStats.size(); ++i)
+	{
+		for (size_t j = 0; j < engineStats[i]->sensors.size(); ++j)
+		{
+			delete engineStats[i]->sensors[j];
+		}
+		engineStats[i]->engine->unref();
+		delete engineStats[i];
+	}
+	engineStats.clear();
+}
+
+
+void PyProfiler::inputChangedCB(void *userdata, SoSensor * /*sensor*/)
+{
+	EngineStats *stats = (EngineStats *) userdata;
+	stats->propagations++;
+	stats->dirty = true;
+}
+
+
+// measurements summed over all engines of one type
+struct TypeTotals
+{
+	TypeTotals() : instances(0), evaluations(0), propagations(0), fanout(0), inclusive(0.), exclusive(0.) {}
+
+	Py_ssize_t instances, evaluations, propagations, fanout;
+	double inclusive, exclusive;
+};
+
+
+static bool compareInclusive(const PyProfiler::EngineStats *a, const PyProfiler::EngineStats *b)
+{
+	return a->inclusive > b->inclusive;
+}
+
+
+PyObject *PyProfiler::getEngineTable()
+{
+	std::vector<EngineStats*> sorted(engineStats);
+	std::stable_sort(sorted.begin(), sorted.end(), compareInclusive);
+
+	PyObject *engines = PyList_New(sorted.size());
+	std::map<std::string, TypeTotals> totals;
+
+	for (size_t i = 0; i < sorted.size(); ++i)
+	{
+		EngineStats *stats = sorted[i];
+		const char *typeName = stats->engine->getTypeId().getName().getString();
+
+		PyList_SetItem(engines, i, Py_BuildValue("{s:N,s:s,s:n,s:n,s:n,s:d,s:d}",
+			"engine", PySceneObject::createWrapper(stats->engine),
+			"type", typeName,
+			"evaluations", stats->evaluations,
+			"propagations", stats->propagations,
+			"fanout", stats->fanout,
+			"inclusive", stats->inclusive,
+			"exclusive", stats->exclusive));
+
+		TypeTotals &total = totals[typeName];
+		total.instances++;
+		total.evaluations += stats->evaluations;
+		total.propagations += stats->propagations;
+		total.fanout += stats->fanout;
+		total.inclusive += stats->inclusive;
+		total.exclusive += stats->exclusive;
+	}
+
+	PyObject *types = PyDict_New();
+	for (std::map<std::string, TypeTotals>::iterator it = totals.begin(); it != totals.end(); ++it)
+	{
+		PyObject *total = Py_BuildValue("{s:n,s:n,s:n,s:n,s:d,s:d}",
+			"instances", it->second.instances,
+			"evaluations", it->second.evaluations,
+			"propagations", it->second.propagations,
+			"fanout", it->second.fanout,
+			"inclusive", it->second.inclusive,
+			"exclusive", it->second.exclusive);
+		PyDict_SetItemString(types, it->first.c_str(), total);
+		Py_DECREF(total);
+	}
+
+	return Py_BuildValue("(NN)", engines, types);
+}
+
+
+PyObject* PyProfiler::start_engine_profile(PyObject * /*self*/, PyObject *args)
+{
+	PyObject *root = NULL;
+	if (!PyArg_ParseTuple(args, "O", &root))
+	{
+		return NULL;
+	}
+
+	SoNode *node = PyNode_Check(root) ? (SoNode *) ((PySceneObject::Object *) root)->inventorObject : NULL;
+	if (!node)
+	{
+		PyErr_SetString(PyExc_TypeError, "Root must be a node");
+		return NULL;
+	}
+
+	// discard results of previous run
+	removeProbes();
+	SoEngineProbe::initClass();
+
+	std::vector<SoEngine*> engines;
+	collectEngines(node, engines);
+
+	for (size_t i = 0; i < engines.size(); ++i)
+	{
+		EngineStats *stats = new EngineStats();
+		stats->engine = engines[i];
+		stats->engine->ref();
+		stats->evaluations = stats->propagations = stats->fanout = 0;
+		stats->inclusive = stats->exclusive = 0.;
+		stats->dirty = true;
+
+		SoFieldList inputs;
+		stats->engine->getFields(inputs);
+		for (int j = 0; j < inputs.getLength(); ++j)
+		{
+			SoFieldSensor *sensor = new SoFieldSensor(inputChangedCB, stats);
+			sensor->setPriority(0);
+			sensor->attach(inputs[j]);
+			stats->sensors.push_back(sensor);
+		}
+
+		engineStats.push_back(stats);
+	}
+
+	for (size_t i = 0; i < engineStats.size(); ++i)
+	{
+		insertProbes(engineStats[i]);
+	}
+
+	return PyLong_FromSsize_t(engineStats.size());
+}
+
+
+PyObject* PyProfiler::stop_engine_profile(PyObject * /*self*/, PyObject * /*args*/)
+{
+	PyObject *table = getEngineTable();
+	removeProbes();
+
+	return table;
+}
+
+
+void PyProfiler::traverseProfiled(int actionIndex, SoAction *action, SoNode *node)
+{
+	// look up original method, types created while profiling use the one of their parent
+	std::vector<SoActionMethod> &original = profiledActions[actionIndex].original;
+	SoActionMethod method = NULL;
+	for (SoType type = node->getTypeId(); !method && !type.isBad(); type = type.getParent())
+	{
+		size_t index = SoNode::getActionMethodIndex(type);
+		if (index < original.size()) method = original[index];
+	}
+
+	if (!method) return;
+
+	if (!profiledActions[actionIndex].profiling)
+	{
+		if (renderCounters && (actionIndex == 0))
+		{
+			countRender(method, action, node);
+		}
+		else
+		{
+			method(action, node);
+		}
+		return;
+	}
+
+	// roots of each action have negative parent
+	Py_ssize_t parent = traversalStack.empty() ? -1 - actionIndex : traversalStack.back().first;
+	std::map<std::pair<Py_ssize_t, SoNode*>, Py_ssize_t>::iterator it = traversalIndex.find(std::make_pair(parent, node));
+	Py_ssize_t entry = 0;
+	if (it == traversalIndex.end())
+	{
+		TraversalEntry e = { parent, actionIndex, node->getTypeId().getName().getString(), node->getName().getString(), 0, 0., 0. };
+		entry = traversalEntries.size();
+		traversalEntries.push_back(e);
+		traversalIndex[std::make_pair(parent, node)] = entry;
+	}
+	else
+	{
+		entry = it->second;
+	}
+
+	traversalStack.push_back(std::make_pair(entry, 0.));
+	double start = getTime();
+	if (renderCounters && (actionIndex == 0))
+	{
+		countRender(method, action, node);
+	}
+	else
+	{
+		method(action, node);
+	}
+	double inclusive = getTime() - start;
+	double children = traversalStack.back().second;
+	traversalStack.pop_back();
+	if (!traversalStack.empty())
+	{
+		traversalStack.back().second += inclusive;
+	}
+
+	TraversalEntry &e = traversalEntries[entry];
+	e.visits++;
+	e.inclusive += inclusive;
+	e.exclusive += inclusive - children;
+}
+
+
+void PyProfiler::countRender(SoActionMethod method, SoAction *action, SoNode *node)
+{
+	// a separator with children that renders without traversing them was
+	// either culled or served from its render cache
+	Py_ssize_t nodes = ++renderCounters->nodes;
+	method(action, node);
+	if (node->isOfType(SoSeparator::getClassTypeId()) && ((SoSeparator *) node)->getNumChildren())
+	{
+		if (renderCounters->nodes == nodes)
+		{
+			if (isCulled(action, (SoSeparator *) node))
+			{
+				renderCounters->culled++;
+			}
+			else
+			{
+				renderCounters->cacheHits++;
+			}
+		}
+		else if (((SoSeparator *) node)->renderCaching.getValue() != SoSeparator::OFF)
+		{
+			renderCounters->cacheMisses++;
+		}
+	}
+}
+
+
+bool PyProfiler::isCulled(SoAction *action, SoSeparator *separator)
+{
+	// without render cache skipping children means the separator was culled,
+	// otherwise its bounding box is tested against the view volume like
+	// the separator did, state is the one the separator was traversed with
+	if (separator->renderCaching.getValue() == SoSeparator::OFF) return true;
+	if (separator->renderCulling.getValue() == SoSeparator::OFF) return false;
+
+	SoState *state = action->getState();
+	static SoGetBoundingBoxAction *bba = 0;
+	if (!bba)
+	{
+		bba = new SoGetBoundingBoxAction(SoViewportRegionElement::get(state));
+	}
+	else
+	{
+		bba->setViewportRegion(SoViewportRegionElement::get(state));
+	}
+
+	bba->apply(separator);
+	SbBox3f box = bba->getBoundingBox();
+	if (box.isEmpty()) return false;
+
+	box.transform(SoModelMatrixElement::get(state));
+	return !SoViewVolumeElement::get(state).intersect(box);
+}
+
+
+void PyProfiler::installMethods(int actionIndex)
+{
+	if (profiledActions[actionIndex].users++) return;
+
+	// remember resolved method of every node type before replacing it
+	SoTypeList &types = profiledActions[actionIndex].types;
+	SoType::getAllDerivedFrom(SoNode::getClassTypeId(), types);
+
+	SoActionMethodList *methods = profiledActions[actionIndex].getMethods();
+	methods->setUp();
+	std::vector<SoActionMethod> &original = profiledActions[actionIndex].original;
+	for (int i = 0; i < types.getLength(); ++i)
+	{
+		size_t index = SoNode::getActionMethodIndex(types[i]);
+		if (index >= original.size()) original.resize(index + 1, NULL);
+		original[index] = (*methods)[(int) index];
+	}
+
+	for (int i = 0; i < types.getLength(); ++i)
+	{
+		profiledActions[actionIndex].addMethod(types[i], profiledActions[actionIndex].profiled);
+	}
+}
+
+
+void PyProfiler::removeMethods(int actionIndex)
+{
+	if (--profiledActions[actionIndex].users) return;
+
+	SoTypeList &types = profiledActions[actionIndex].types;
+	std::vector<SoActionMethod> &original = profiledActions[actionIndex].original;
+	for (int i = 0; i < types.getLength(); ++i)
+	{
+		size_t index = SoNode::getActionMethodIndex(types[i]);
+		if (index < original.size())
+		{
+			profiledActions[actionIndex].addMethod(types[i], original[index]);
+		}
+	}
+
+	original.clear();
+	types.truncate(0);
+}
+
+
+void PyProfiler::enableRenderCounters(bool enable)
+{
+	if (enable)
+	{
+		installMethods(0);
+	}
+	else
+	{
+		removeMethods(0);
+	}
+}
+
+
+void PyProfiler::clearTraversalProfile()
+{
+	for (int a = 0; a < NUM_PROFILED_ACTIONS; ++a)
+	{
+		if (profiledActions[a].profiling)
+		{
+			profiledActions[a].profiling = false;
+			removeMethods(a);
+		}
+	}
+
+	traversalEntries.clear();
+	traversalIndex.clear();
+	traversalStack.clear();
+}
+
+
+PyObject *PyProfiler::getTraversalArray()
+{
+	size_t typeLength = 1, nameLength = 1, actionLength = 1;
+	for (size_t i = 0; i < traversalEntries.size(); ++i)
+	{
+		typeLength = std::max(typeLength, strlen(traversalEntries[i].type));
+		nameLength = std::max(nameLength, strlen(traversalEntries[i].name));
+		actionLength = std::max(actionLength, strlen(profiledActions[traversalEntries[i].action].name));
+	}
+
+	std::vector<int> depth(traversalEntries.size(), 0);
+	PyObject *rows = PyList_New(traversalEntries.size());
+	for (size_t i = 0; i < traversalEntries.size(); ++i)
+	{
+		const TraversalEntry &e = traversalEntries[i];
+		if (e.parent >= 0) depth[i] = depth[e.parent] + 1;
+		PyList_SetItem(rows, i, Py_BuildValue("(nisssndd)", e.parent >= 0 ? e.parent : -1, depth[i],
+			profiledActions[e.action].name, e.type, e.name, e.visits, e.inclusive, e.exclusive));
+	}
+
+	PyObject *fields = Py_BuildValue("[(ss)(ss)(sN)(sN)(sN)(ss)(ss)(ss)]",
+		"parent", "i8",
+		"depth", "i4",
+		"action", PyUnicode_FromFormat("U%zu", actionLength),
+		"type", PyUnicode_FromFormat("U%zu", typeLength),
+		"name", PyUnicode_FromFormat("U%zu", nameLength),
+		"visits", "i8",
+		"inclusive", "f8",
+		"exclusive", "f8");
+
+	PyArray_Descr *descr = NULL;
+	PyObject *result = NULL;
+	if (PyArray_DescrConverter(fields, &descr))
+	{
+		result = PyArray_FromAny(rows, descr, 1, 1, 0, NULL);
+	}
+
+	Py_DECREF(fields);
+	Py_DECREF(rows);
+
+	return result;
+}
+
+
+PyObject *PyProfiler::getTraversalStacks()
+{
+	// one line per call tree entry in collapsed stack format: frames separated by
+	// semicolons followed by exclusive time in microseconds
+	std::vector<std::string> stacks(traversalEntries.size());
+	PyObject *lines = PyList_New(0);
+	for (size_t i = 0; i < traversalEntries.size(); ++i)
+	{
+		const TraversalEntry &e = traversalEntries[i];
+		std::ostringstream frame;
+		if (e.parent >= 0)
+		{
+			frame << stacks[e.parent] << ";";
+		}
+		if ((e.parent < 0) || (traversalEntries[e.parent].action != e.action))
+		{
+			frame << profiledActions[e.action].name << ";";
+		}
+		frame << e.type;
+		if (*e.name) frame << ":" << e.name;
+		stacks[i] = frame.str();
+
+		long long weight = (long long) (e.exclusive * 1e6 + 0.5);
+		if (weight > 0)
+		{
+			PyObject *line = PyUnicode_FromFormat("%s %lld", stacks[i].c_str(), weight);
+			PyList_Append(lines, line);
+			Py_DECREF(line);
+		}
+	}
+
+	return lines;
+}
+
+
+PyObject* PyProfiler::start_traversal_profile(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = { "actions", NULL };
+	PyObject *actions = NULL;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &actions))
+	{
+		return NULL;
+	}
+
+	bool enabled[NUM_PROFILED_ACTIONS];
+	for (int a = 0; a < NUM_PROFILED_ACTIONS; ++a)
+	{
+		enabled[a] = (actions == NULL) || (actions == Py_None);
+	}
+
+	if (!enabled[0])
+	{
+		PyObject *seq = PySequence_Fast(actions, "Actions must be a sequence of action names");
+		if (!seq) return NULL;
+
+		for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); ++i)
+		{
+			PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+			const char *name = PyUnicode_Check(item) ? PyUnicode_AsUTF8(item) : NULL;
+			int a = 0;
+			while ((a < NUM_PROFILED_ACTIONS) && (!name || strcmp(name, profiledActions[a].name))) ++a;
+			if (a == NUM_PROFILED_ACTIONS)
+			{
+				PyErr_SetString(PyExc_ValueError, "Unknown action, must be one of GLRender, RayPick, GetBoundingBox or Search");
+				Py_DECREF(seq);
+				return NULL;
+			}
+			enabled[a] = true;
+		}
+		Py_DECREF(seq);
+	}
+
+	// discard results of previous run
+	clearTraversalProfile();
+
+	for (int a = 0; a < NUM_PROFILED_ACTIONS; ++a)
+	{
+		if (enabled[a])
+		{
+			installMethods(a);
+			profiledActions[a].profiling = true;
+		}
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+PyObject* PyProfiler::stop_traversal_profile(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = { "format", NULL };
+	const char *format = "array";
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &format))
+	{
+		return NULL;
+	}
+
+	PyObject *result = NULL;
+	if (!strcmp(format, "array"))
+	{
+		result = PyField::initNumpy() ? getTraversalArray() : NULL;
+	}
+	else if (!strcmp(format, "collapsed"))
+	{
+		result = getTraversalStacks();
+	}
+	else
+	{
+		PyErr_SetString(PyExc_ValueError, "Format must be 'array' or 'collapsed'");
+		return NULL;
+	}
+
+	clearTraversalProfile();
+
+	return result;
+}
+
+
+void PyProfiler::addTraceEvent(const char *name, double start, double end)
+{
+	if (!threadTraceBuffer)
+	{
+		// first event of this thread, buffers are kept until process exits
+		std::lock_guard<std::mutex> lock(traceMutex);
+		threadTraceBuffer = new TraceBuffer();
+		threadTraceBuffer->threadId = (int) traceBuffers.size() + 1;
+		traceBuffers.push_back(threadTraceBuffer);
+	}
+
+	TraceEvent e = { name, start, end };
+	threadTraceBuffer->events.push_back(e);
+}
+
+
+PyObject* PyProfiler::start_trace(PyObject * /*self*/, PyObject * /*args*/)
+{
+	if (!tracing)
+	{
+		std::lock_guard<std::mutex> lock(traceMutex);
+		for (size_t i = 0; i < traceBuffers.size(); ++i)
+		{
+			traceBuffers[i]->events.clear();
+		}
+		traceStart = getTime();
+		tracing = true;
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+PyObject* PyProfiler::stop_trace(PyObject * /*self*/, PyObject * /*args*/)
+{
+	tracing = false;
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+PyObject* PyProfiler::flush_trace(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = { "file", NULL };
+	const char *fileName = NULL;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &fileName))
+	{
+		return NULL;
+	}
+
+	// chrome trace event format with complete events, times in microseconds
+	std::ostringstream json;
+	json.precision(3);
+	json << std::fixed << "{\"traceEvents\":[";
+
+	Py_ssize_t numEvents = 0;
+	{
+		std::lock_guard<std::mutex> lock(traceMutex);
+		for (size_t i = 0; i < traceBuffers.size(); ++i)
+		{
+			std::vector<TraceEvent> &events = traceBuffers[i]->events;
+			for (size_t j = 0; j < events.size(); ++j)
+			{
+				json << (numEvents++ ? ",\n" : "\n")
+					<< "{\"name\":\"" << events[j].name << "\",\"cat\":\"inventor\",\"ph\":\"X\""
+					<< ",\"ts\":" << (events[j].start - traceStart) * 1e6
+					<< ",\"dur\":" << (events[j].end - events[j].start) * 1e6
+					<< ",\"pid\":1,\"tid\":" << traceBuffers[i]->threadId << "}";
+			}
+			events.clear();
+		}
+	}
+
+	json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	if (fileName)
+	{
+		std::ofstream file(fileName);
+		file << json.str();
+		if (!file)
+		{
+			PyErr_SetString(PyExc_IOError, "Failed to write trace file");
+			return NULL;
+		}
+
+		return PyLong_FromSsize_t(numEvents);
+	}
+
+	return PyUnicode_FromString(json.str().c_str());
+}
+
@@ -0,0 +1,105 @@
+/**
+ * \file
+ * \brief      PyProfiler class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+#include <vector>
+
+class SoNode;
+class SoEngine;
+class SoField;
+class SoFieldSensor;
+class SoSensor;
+class SoAction;
+class SoSeparator;
+
+
+class PyProfiler
+{
+public:
+	// module functions
+	static PyObject* start_engine_profile(PyObject *self, PyObject *args);
+	static PyObject* stop_engine_profile(PyObject *self, PyObject *args);
+	static PyObject* start_traversal_profile(PyObject *self, PyObject *args, PyObject *kwds);
+	static PyObject* stop_traversal_profile(PyObject *self, PyObject *args, PyObject *kwds);
+	static PyObject* start_trace(PyObject *self, PyObject *args);
+	static PyObject* stop_trace(PyObject *self, PyObject *args);
+	static PyObject* flush_trace(PyObject *self, PyObject *args, PyObject *kwds);
+
+	// measurements of one engine while profiling
+	typedef struct
+	{
+		SoEngine *engine;
+		std::vector<SoFieldSensor*> sensors;
+		Py_ssize_t evaluations, propagations, fanout;
+		double inclusive, exclusive;
+		bool dirty;
+	} EngineStats;
+
+	// monotonic time in seconds
+	static double getTime();
+
+	// records a trace event spanning the lifetime of the scope while tracing is on
+	class TraceScope
+	{
+	public:
+		TraceScope(const char *eventName) : name(NULL), start(0.)
+		{
+			if (tracing)
+			{
+				name = eventName;
+				start = getTime();
+			}
+		}
+
+		~TraceScope()
+		{
+			if (name) addTraceEvent(name, start, getTime());
+		}
+
+	private:
+		const char *name;
+		double start;
+	};
+
+	static bool tracing;
+	static void addTraceEvent(const char *name, double start, double end);
+
+	// counters of render traversal, set while a scene manager collects detailed statistics
+	typedef struct
+	{
+		Py_ssize_t nodes, cacheHits, cacheMisses, culled;
+	} RenderCounters;
+
+	static RenderCounters *renderCounters;
+	static void enableRenderCounters(bool enable);
+
+	// called instead of the action method of every node type while profiling
+	static void traverseProfiled(int actionIndex, SoAction *action, SoNode *node);
+
+private:
+	// internal
+	static void collectEngines(SoNode *root, std::vector<SoEngine*> &engines_out);
+	static void insertProbes(EngineStats *stats);
+	static void removeProbes();
+	static PyObject *getEngineTable();
+	static void inputChangedCB(void *userdata, SoSensor *sensor);
+	static void installMethods(int actionIndex);
+	static void removeMethods(int actionIndex);
+	static void clearTraversalProfile();
+	static void countRender(void (*method)(SoAction *, SoNode *), SoAction *action, SoNode *node);
+	static bool isCulled(SoAction *action, SoSeparator *separator);
+	static PyObject *getTraversalArray();
+	static PyObject *getTraversalStacks();
+};
+
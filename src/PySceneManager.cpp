@@ -17,14 +17,19 @@
 #include <Inventor/events/SoMotion3Event.h>
 #include <Inventor/nodes/SoNode.h>
 #include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoComplexity.h>
 #include <Inventor/engines/SoEngine.h>
 #include <Inventor/elements/SoGLLazyElement.h> // for GL.h, whose location is distribution specific under system/ or sys/
 #include <Inventor/fields/SoMFColor.h>
 #include <Inventor/actions/SoSearchAction.h>
 #include <Inventor/actions/SoGLRenderAction.h>
 #include <Inventor/actions/SoHandleEventAction.h>
+#include <Inventor/actions/SoGetPrimitiveCountAction.h>
 #include <Inventor/projectors/SbSphereSheetProjector.h>
 #include <Inventor/SoDB.h>
+#include <Inventor/sensors/SoOneShotSensor.h>
+#include <Inventor/sensors/SoAlarmSensor.h>
+#include <Inventor/sensors/SoIdleSensor.h>
 
 #ifdef TGS_VERSION
 #include <Inventor/events/SoMouseWheelEvent.h>
@@ -51,6 +56,10 @@ class SoGLContext;
 
 #include "PySceneManager.h"
 #include "PyField.h"
+#include "PyProfiler.h"
+#define PY_ARRAY_UNIQUE_SYMBOL PyInventor_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/ndarrayobject.h>
 
 #pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
 #pragma warning ( disable : 4244 ) // possible loss of data when converting int to short in SbVec2s
@@ -74,6 +83,51 @@ PyTypeObject *PySceneManager::getType()
 		{"background", T_OBJECT_EX, offsetof(Object, backgroundColor), 0,
             "Background color. Also two colors can be given thereby creating a\n"
 			"gradient background.\n"
+        },
+		{"finish", T_BOOL, offsetof(Object, finish), 0,
+            "If True render() waits for OpenGL to complete drawing (glFinish)\n"
+            "instead of only flushing, so frame statistics include GPU time.\n"
+        },
+		{"detailed_stats", T_BOOL, offsetof(Object, detailedStats), 0,
+            "If True render() also counts traversed nodes, render cache hits\n"
+            "and misses and the triangles of the scene for frame_stats(). This\n"
+            "adds some overhead to every render traversal.\n"
+        },
+		{"coalesce_moves", T_BOOL, offsetof(Object, coalesceMoves), 0,
+            "If True consecutive mouse_move() calls are merged and only the last\n"
+            "position is sent into the scene, either when the application is\n"
+            "idle, before the next frame is rendered or before the next button,\n"
+            "key or motion event so that the event order is kept.\n"
+        },
+		{"frame_interval", T_DOUBLE, offsetof(Object, frameInterval), 0,
+            "Minimum time in seconds between two invocations of the redisplay\n"
+            "callback, e.g. 1/60 to pace redraws to the display refresh rate.\n"
+            "Redraws requested earlier are delayed. Zero (default) disables\n"
+            "pacing.\n"
+        },
+		{"adaptive_quality", T_BOOL, offsetof(Object, adaptiveQuality), 0,
+            "If True rendering quality is reduced while the camera is moved or\n"
+            "an object is dragged, whenever the frame time exceeds the target.\n"
+            "Full quality is restored when the interaction ends.\n"
+        },
+		{"target_frame_time", T_DOUBLE, offsetof(Object, targetFrameTime), 0,
+            "Frame time in seconds that adaptive quality aims for (default 1/30).\n"
+        },
+		{"quality_level", T_INT, offsetof(Object, qualityLevel), READONLY,
+            "Current degradation level of adaptive quality: 0 = full quality,\n"
+            "1 = screen space complexity and unsorted transparency, 2 = coarse\n"
+            "complexity and textures, 3 = bounding boxes only.\n"
+        },
+		{"progressive", T_BOOL, offsetof(Object, progressive), 0,
+            "If True and a full quality frame took longer than the progressive\n"
+            "budget, a scene change is first rendered at a reduced quality level\n"
+            "and then refined one level per redraw while the application is\n"
+            "idle (see process_queues()).\n"
+        },
+		{"progressive_budget", T_DOUBLE, offsetof(Object, progressiveBudget), 0,
+            "Frame time in seconds the first progressive pass should stay within\n"
+            "(default 0.1). The start level is chosen from the ratio of the last\n"
+            "full quality frame time to this budget.\n"
         },
 		{NULL}  /* Sentinel */
 	};
@@ -162,6 +216,27 @@ PyTypeObject *PySceneManager::getType()
             "Return:\n"
             "    True if a node was grabbing events. Otherwise False.\n"
         },
+        { "frame_stats", (PyCFunction) frame_stats, METH_VARARGS | METH_KEYWORDS,
+            "Returns statistics of the frames rendered by this scene manager.\n"
+            "Averages are taken over the last 60 frames, times are in seconds.\n"
+            "Traversal time is spent in the render traversal, finish time in\n"
+            "glFlush() or glFinish() (see finish attribute). Redraw requests\n"
+            "count how often the redisplay callback was invoked, frames how\n"
+            "often render() was called. Nodes, triangles and cache counts are\n"
+            "only collected with detailed_stats set. A separator with children\n"
+            "that rendered without traversing them counts as culled if it is\n"
+            "outside the view volume (or has no render cache) and as cache hit\n"
+            "otherwise.\n"
+            "\n"
+            "Args:\n"
+            "    reset: If True statistics are cleared after the snapshot.\n"
+            "\n"
+            "Return:\n"
+            "    Numpy record with the fields frame_time, average_frame_time,\n"
+            "    traversal_time, average_traversal_time, finish_time,\n"
+            "    average_finish_time, frames, redraw_requests, nodes, triangles,\n"
+            "    cache_hits, cache_misses and culled.\n"
+        },
         {NULL}  /* Sentinel */
 	};
 
@@ -218,6 +293,35 @@ PyTypeObject *PySceneManager::getType()
 
 void PySceneManager::tp_dealloc(Object* self)
 {
+	if (self->qualityLevel)
+	{
+		setQualityLevel(self, 0);
+	}
+
+	if (self->renderRoot)
+	{
+		self->renderRoot->unref();
+		self->renderRoot = 0;
+	}
+
+	if (self->moveSensor)
+	{
+		delete self->moveSensor;
+		self->moveSensor = 0;
+	}
+
+	if (self->pacingSensor)
+	{
+		delete self->pacingSensor;
+		self->pacingSensor = 0;
+	}
+
+	if (self->refineSensor)
+	{
+		delete self->refineSensor;
+		self->refineSensor = 0;
+	}
+
 	if (self->sceneManager)
 	{
 		delete self->sceneManager;
@@ -236,6 +340,12 @@ void PySceneManager::tp_dealloc(Object* self)
 		self->gradientBackground = 0;
 	}
 
+	if (self->countersEnabled)
+	{
+		PyProfiler::enableRenderCounters(false);
+		self->countersEnabled = false;
+	}
+
 	SOGLCONTEXT_UNREF(self->context);
 
 	Py_XDECREF(self->scene);
@@ -260,6 +370,31 @@ PyObject* PySceneManager::tp_new(PyTypeObject *type, PyObject* /*args*/, PyObjec
 		self->context = 0;
 		self->manipMode = Object::SCENE;
 		self->isManipulating = false;
+		memset(&self->stats, 0, sizeof(self->stats));
+		self->statsCount = 0;
+		self->statsNodeId = 0;
+		self->finish = 0;
+		self->detailedStats = 0;
+		self->countersEnabled = false;
+		self->coalesceMoves = 0;
+		self->movePending = false;
+		self->moveSensor = 0;
+		self->frameInterval = 0.;
+		self->lastRedraw = 0.;
+		self->pacingSensor = 0;
+		self->adaptiveQuality = 0;
+		self->targetFrameTime = 1. / 30.;
+		self->qualityLevel = 0;
+		self->savedTransparencyType = 0;
+		self->savedNumPasses = 1;
+		self->renderRoot = 0;
+		self->qualityComplexity = 0;
+		self->progressive = 0;
+		self->progressiveBudget = 0.1;
+		self->fullFrameTime = 0.;
+		self->refining = false;
+		self->refineRedraw = false;
+		self->refineSensor = 0;
 	}
 
     return (PyObject *) self;
@@ -274,15 +409,30 @@ int PySceneManager::tp_init(Object *self, PyObject *args, PyObject *kwds)
 	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &background))
         return -1;
 
+	// scene is rendered below a complexity node that degrades it while the
+	// quality level is above 0, so every level takes the same render path
+	self->qualityComplexity = new SoComplexity();
+	self->qualityComplexity->enableNotify(FALSE);
+	setQualityComplexity(self->qualityComplexity, 0);
+	self->renderRoot = new SoSeparator();
+	self->renderRoot->ref();
+	self->renderRoot->renderCaching = SoSeparator::OFF;
+	self->renderRoot->addChild(self->qualityComplexity);
+
 	self->scene = PySceneObject::createWrapper(new SoSeparator);
 	self->sceneManager = new SoSceneManager();
 	if (self->scene && self->sceneManager)
 	{
-		self->sceneManager->setSceneGraph((SoNode*) ((PySceneObject::Object*) self->scene)->inventorObject);
+		self->renderRoot->addChild((SoNode*) ((PySceneObject::Object*) self->scene)->inventorObject);
+		self->sceneManager->setSceneGraph(self->renderRoot);
 	}
 	self->sceneManager->setRenderCallback(renderCBFunc, self);
 	self->sceneManager->activate();
 
+	self->moveSensor = new SoOneShotSensor(moveCBFunc, self);
+	self->pacingSensor = new SoAlarmSensor(pacingCBFunc, self);
+	self->refineSensor = new SoIdleSensor(refineCBFunc, self);
+
 	self->sphereSheetProjector = new SbSphereSheetProjector();
 	if (self->sphereSheetProjector)
 	{
@@ -312,6 +462,8 @@ int PySceneManager::tp_init(Object *self, PyObject *args, PyObject *kwds)
 
 int PySceneManager::tp_setattro(Object* self, PyObject *attrname, PyObject *value)
 {
+	PyProfiler::TraceScope trace("SceneManager.setattr");
+
 	int result = 0;
 
 	result = PyObject_GenericSetAttr((PyObject*) self, attrname, value);
@@ -324,7 +476,14 @@ int PySceneManager::tp_setattro(Object* self, PyObject *attrname, PyObject *valu
 			SoFieldContainer *fc = ((PySceneObject::Object*) self->scene)->inventorObject;
 			if (fc && fc->isOfType(SoNode::getClassTypeId()))
 			{
-				self->sceneManager->setSceneGraph((SoNode*) fc);
+				if (self->renderRoot->getNumChildren() > 1)
+				{
+					self->renderRoot->replaceChild(1, (SoNode*) fc);
+				}
+				else
+				{
+					self->renderRoot->addChild((SoNode*) fc);
+				}
 				self->sceneManager->scheduleRedraw();
 			}
 			else
@@ -362,8 +521,58 @@ PyObject* PySceneManager::init_gl(Object * /*self*/, PyObject * /*args*/)
 
 void PySceneManager::renderCBFunc(void *userdata, SoSceneManager * /*mgr*/)
 {
+	PyProfiler::TraceScope trace("SceneManager.redraw");
+
 	Object *self = (Object *) userdata;
-	if ((self != NULL) && (self->renderCallback != NULL) && PyCallable_Check(self->renderCallback))
+	if (self != NULL)
+	{
+		self->stats.redrawRequests++;
+
+		if (self->refineRedraw)
+		{
+			self->refineRedraw = false;
+		}
+		else if (self->progressive && (self->fullFrameTime > self->progressiveBudget) && !isInteracting(self))
+		{
+			// scene changed, start refinement over with a pass coarse enough for budget
+			double ratio = self->fullFrameTime / self->progressiveBudget;
+			self->refining = true;
+			setQualityLevel(self, ratio > 4. ? 3 : (ratio > 2. ? 2 : 1));
+		}
+
+		if (self->frameInterval > 0.)
+		{
+			// delay redraw until a full interval has passed since the last one
+			double now = PyProfiler::getTime();
+			double next = self->lastRedraw + self->frameInterval;
+			if (now < next)
+			{
+				if (!self->pacingSensor->isScheduled())
+				{
+					self->pacingSensor->setTimeFromNow(SbTime(next - now));
+					self->pacingSensor->schedule();
+				}
+				return;
+			}
+			self->lastRedraw = now;
+		}
+
+		invokeRedraw(self);
+	}
+}
+
+
+void PySceneManager::pacingCBFunc(void *userdata, SoSensor * /*sensor*/)
+{
+	Object *self = (Object *) userdata;
+	self->lastRedraw = PyProfiler::getTime();
+	invokeRedraw(self);
+}
+
+
+void PySceneManager::invokeRedraw(Object *self)
+{
+	if ((self->renderCallback != NULL) && PyCallable_Check(self->renderCallback))
 	{
 		PyObject *value = PyObject_CallObject(self->renderCallback, NULL);
 		if (value != NULL)
@@ -374,24 +583,116 @@ void PySceneManager::renderCBFunc(void *userdata, SoSceneManager * /*mgr*/)
 }
 
 
+void PySceneManager::moveCBFunc(void *userdata, SoSensor * /*sensor*/)
+{
+	flushMove((Object *) userdata);
+}
+
+
+void PySceneManager::flushMove(Object *self)
+{
+	if (self->movePending)
+	{
+		self->movePending = false;
+		if (self->moveSensor->isScheduled())
+		{
+			self->moveSensor->unschedule();
+		}
+
+		SoLocation2Event ev;
+		ev.setTime(self->moveTime);
+		ev.setPosition(self->movePosition);
+		processEvent(self, &ev);
+	}
+}
+
+
 PyObject* PySceneManager::render(Object *self, PyObject *args)
 {
+	PyProfiler::TraceScope trace("SceneManager.render");
+
     int clearColor = true, clearZ = true;
     if (PyArg_ParseTuple(args, "|pp", &clearColor, &clearZ))
 	{
         SOGLCONTEXT_CREATE(self->context);
         SOGLCONTEXT_BIND(self->context);
 
+		// deliver merged mouse moves once per frame
+		flushMove(self);
+
+		// node and cache counters hook into render traversal only while needed
+		if ((self->detailedStats != 0) != self->countersEnabled)
+		{
+			self->countersEnabled = (self->detailedStats != 0);
+			PyProfiler::enableRenderCounters(self->countersEnabled);
+		}
+
+		PyProfiler::RenderCounters counters = { 0, 0, 0, 0 };
+		if (self->countersEnabled)
+		{
+			PyProfiler::renderCounters = &counters;
+		}
+
+		double start = PyProfiler::getTime();
+
 		if (clearColor && self->gradientBackground && self->sceneManager->getGLRenderAction())
 		{
 			self->sceneManager->getGLRenderAction()->apply(self->gradientBackground);
 			clearColor = false;
 		}
 
+		SoNode *root = getSceneNode(self);
 		self->sceneManager->render(clearColor ? TRUE : FALSE, clearZ ? TRUE : FALSE);
-        
-        // need to flush or nothing will be shown on OS X
-        glFlush();
+		double traversed = PyProfiler::getTime();
+		PyProfiler::renderCounters = NULL;
+
+		if (self->finish)
+		{
+			glFinish();
+		}
+		else
+		{
+			// need to flush or nothing will be shown on OS X
+			glFlush();
+		}
+
+		recordFrame(self, traversed - start, PyProfiler::getTime() - traversed);
+		if (!self->qualityLevel)
+		{
+			self->fullFrameTime = self->stats.frameTime;
+		}
+
+		adaptQuality(self);
+
+		if (self->refining)
+		{
+			// next finer pass is rendered when application is idle
+			if (self->qualityLevel)
+			{
+				self->refineSensor->schedule();
+			}
+			else
+			{
+				self->refining = false;
+			}
+		}
+
+		if (self->countersEnabled)
+		{
+			self->stats.nodes = counters.nodes;
+			self->stats.cacheHits = counters.cacheHits;
+			self->stats.cacheMisses = counters.cacheMisses;
+			self->stats.culled = counters.culled;
+
+			// triangle count is only updated when the scene changed
+			if (root && (root->getNodeId() != self->statsNodeId))
+			{
+				SoGetPrimitiveCountAction pca(self->sceneManager->getViewportRegion());
+				pca.apply(root);
+				self->stats.triangles = pca.getTriangleCount();
+				self->statsNodeId = root->getNodeId();
+			}
+		}
     }
 
     Py_INCREF(Py_None);
@@ -401,6 +702,8 @@ PyObject* PySceneManager::render(Object *self, PyObject *args)
 
 PyObject* PySceneManager::resize(Object *self, PyObject *args)
 {
+	PyProfiler::TraceScope trace("SceneManager.resize");
+
     int width = 0, height = 0;
     if (PyArg_ParseTuple(args, "ii", &width, &height))
 	{
@@ -415,15 +718,22 @@ PyObject* PySceneManager::resize(Object *self, PyObject *args)
 }
 
 
+SoNode *PySceneManager::getSceneNode(Object *self)
+{
+	// application scene below complexity node of render root
+	return (self && self->renderRoot && (self->renderRoot->getNumChildren() > 1)) ? self->renderRoot->getChild(1) : 0;
+}
+
+
 SoCamera *PySceneManager::getCamera(Object *self)
 {
 	SoCamera *camera = 0;
-	if (self && self->sceneManager)
+	if (self && getSceneNode(self))
 	{
 		SoSearchAction search;
 		search.setType(SoCamera::getClassTypeId());
 		search.setInterest(SoSearchAction::FIRST);
-		search.apply(self->sceneManager->getSceneGraph());
+		search.apply(getSceneNode(self));
 
 		if (search.getPath())
 		{
@@ -489,14 +799,24 @@ void PySceneManager::processEvent(Object *self, SoEvent *e)
 			}
 		}
 	}
+
+	if (self->qualityLevel && !self->refining && !isInteracting(self))
+	{
+		// interaction ended, redraw in full quality
+		setQualityLevel(self, 0);
+		self->sceneManager->scheduleRedraw();
+	}
 }
 
 
 PyObject* PySceneManager::mouse_button(Object *self, PyObject *args)
 {
+	PyProfiler::TraceScope trace("SceneManager.mouse_button");
+
     int button = 0, state = 0, x = 0, y = 0;
     if (PyArg_ParseTuple(args, "iiii", &button, &state, &x, &y))
 	{
+		flushMove(self);
 		y = self->sceneManager->getWindowSize()[1] - y;
 
 		if ((button > 2) && (self->manipMode == Object::CAMERA))
@@ -546,15 +866,31 @@ PyObject* PySceneManager::mouse_button(Object *self, PyObject *args)
 
 PyObject* PySceneManager::mouse_move(Object *self, PyObject *args)
 {
+	PyProfiler::TraceScope trace("SceneManager.mouse_move");
+
     int x = 0, y = 0;
     if (PyArg_ParseTuple(args, "ii", &x, &y))
 	{
 		y = self->sceneManager->getWindowSize()[1] - y;
 
-		SoLocation2Event ev;
-		ev.setTime(SbTime::getTimeOfDay());
-		ev.setPosition(SbVec2s(x, y));
-		processEvent(self, &ev);
+		if (self->coalesceMoves)
+		{
+			// only remember latest position, delivered when idle or before next event
+			self->movePending = true;
+			self->movePosition = SbVec2s(x, y);
+			self->moveTime = SbTime::getTimeOfDay();
+			if (!self->moveSensor->isScheduled())
+			{
+				self->moveSensor->schedule();
+			}
+		}
+		else
+		{
+			SoLocation2Event ev;
+			ev.setTime(SbTime::getTimeOfDay());
+			ev.setPosition(SbVec2s(x, y));
+			processEvent(self, &ev);
+		}
 	}
 
     Py_INCREF(Py_None);
@@ -569,6 +905,8 @@ PyObject* PySceneManager::motion3(Object *self, PyObject *args)
     PyObject *translationObj = NULL, *rotationObj = NULL;
     if (PyArg_ParseTuple(args, "OOf", &translationObj, &rotationObj, &radians))
     {
+        flushMove(self);
+
         SoMotion3Event ev;
 
         if (PyField::getFloatsFromPyObject(translationObj, 3, vector))
@@ -593,9 +931,13 @@ PyObject* PySceneManager::motion3(Object *self, PyObject *args)
 
 PyObject* PySceneManager::key(Object *self, PyObject *args)
 {
+	PyProfiler::TraceScope trace("SceneManager.key");
+
     char key;
     if (PyArg_ParseTuple(args, "c", &key))
 	{
+		flushMove(self);
+
 		bool mapped = true;
 		SoKeyboardEvent ev;
 		ev.setTime(SbTime::getTimeOfDay());
@@ -649,6 +991,8 @@ PyObject* PySceneManager::key(Object *self, PyObject *args)
 
 PyObject* PySceneManager::view_all(Object *self, PyObject *args)
 {
+	PyProfiler::TraceScope trace("SceneManager.view_all");
+
 	long ok = 0;
 
 	PyObject *applyTo = NULL;
@@ -656,7 +1000,7 @@ PyObject* PySceneManager::view_all(Object *self, PyObject *args)
 	{
 		if (!applyTo || PyNode_Check(applyTo))
 		{
-			SoNode *applyToNode = self->sceneManager->getSceneGraph();
+			SoNode *applyToNode = getSceneNode(self);
 
 			PySceneObject::Object *sceneObj = (PySceneObject::Object *)	applyTo;
 			if (sceneObj && sceneObj->inventorObject)
@@ -683,6 +1027,8 @@ PyObject* PySceneManager::view_all(Object *self, PyObject *args)
 
 PyObject* PySceneManager::interaction(Object *self, PyObject *args)
 {
+	PyProfiler::TraceScope trace("SceneManager.interaction");
+
     int mode = 0;
     if (PyArg_ParseTuple(args, "i", &mode))
 	{
@@ -837,3 +1183,181 @@ PyObject* PySceneManager::release_grabber(Object *self)
 
     return PyBool_FromLong(isGrabbing);
 }
+
+
+PyObject* PySceneManager::frame_stats(Object *self, PyObject *args, PyObject *kwds)
+{
+	PyProfiler::TraceScope trace("SceneManager.frame_stats");
+
+	static char *kwlist[] = { "reset", NULL };
+	int reset = false;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset))
+	{
+		return NULL;
+	}
+
+	if (!PyField::initNumpy())
+	{
+		return NULL;
+	}
+
+	PyObject *fields = Py_BuildValue("[(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)]",
+		"frame_time", "f8", "average_frame_time", "f8",
+		"traversal_time", "f8", "average_traversal_time", "f8",
+		"finish_time", "f8", "average_finish_time", "f8",
+		"frames", "p", "redraw_requests", "p",
+		"nodes", "p", "triangles", "p", "cache_hits", "p", "cache_misses", "p", "culled", "p");
+
+	PyArray_Descr *descr = NULL;
+	PyObject *result = NULL;
+	if (PyArray_DescrConverter(fields, &descr))
+	{
+		result = PyArray_NewFromDescr(&PyArray_Type, descr, 0, NULL, NULL, NULL, 0, NULL);
+		if (result)
+		{
+			memcpy(PyArray_DATA((PyArrayObject *) result), &self->stats, sizeof(FrameStats));
+		}
+	}
+	Py_DECREF(fields);
+
+	if (reset)
+	{
+		memset(&self->stats, 0, sizeof(self->stats));
+		self->statsCount = 0;
+		self->statsNodeId = 0;
+	}
+
+	return result;
+}
+
+
+void PySceneManager::recordFrame(Object *self, double traversalTime, double finishTime)
+{
+	FrameStats &stats = self->stats;
+	int slot = (int) (stats.frames % STATS_WINDOW);
+	self->statsHistory[0][slot] = traversalTime + finishTime;
+	self->statsHistory[1][slot] = traversalTime;
+	self->statsHistory[2][slot] = finishTime;
+	if (self->statsCount < STATS_WINDOW) self->statsCount++;
+	stats.frames++;
+
+	double sum[3] = { 0., 0., 0. };
+	for (int i = 0; i < self->statsCount; ++i)
+	{
+		sum[0] += self->statsHistory[0][i];
+		sum[1] += self->statsHistory[1][i];
+		sum[2] += self->statsHistory[2][i];
+	}
+
+	stats.frameTime = traversalTime + finishTime;
+	stats.traversalTime = traversalTime;
+	stats.finishTime = finishTime;
+	stats.averageFrameTime = sum[0] / self->statsCount;
+	stats.averageTraversalTime = sum[1] / self->statsCount;
+	stats.averageFinishTime = sum[2] / self->statsCount;
+}
+
+
+bool PySceneManager::isInteracting(Object *self)
+{
+	return self->isManipulating || (self->sceneManager->getHandleEventAction()->getGrabber() != NULL);
+}
+
+
+void PySceneManager::adaptQuality(Object *self)
+{
+	if (!self->adaptiveQuality || !isInteracting(self))
+	{
+		if (self->qualityLevel && !self->refining) setQualityLevel(self, 0);
+		return;
+	}
+
+	// interaction takes over from progressive refinement
+	self->refining = false;
+
+	// step degradation level up or down with hysteresis around target
+	double frameTime = self->stats.frameTime;
+	if ((frameTime > self->targetFrameTime) && (self->qualityLevel < 3))
+	{
+		setQualityLevel(self, self->qualityLevel + 1);
+	}
+	else if ((frameTime < self->targetFrameTime * 0.5) && (self->qualityLevel > 0))
+	{
+		setQualityLevel(self, self->qualityLevel - 1);
+	}
+}
+
+
+void PySceneManager::setQualityLevel(Object *self, int level)
+{
+	if (level == self->qualityLevel) return;
+
+	SoGLRenderAction *action = self->sceneManager->getGLRenderAction();
+	if (!self->qualityLevel)
+	{
+		self->savedTransparencyType = action->getTransparencyType();
+		self->savedNumPasses = action->getNumPasses();
+	}
+
+	self->qualityLevel = level;
+	if (!level)
+	{
+		action->setTransparencyType((SoGLRenderAction::TransparencyType) self->savedTransparencyType);
+		action->setNumPasses(self->savedNumPasses);
+	}
+	else
+	{
+		// skip transparency sorting and multipass antialiasing
+		action->setTransparencyType(SoGLRenderAction::BLEND);
+		action->setNumPasses(1);
+	}
+
+	setQualityComplexity(self->qualityComplexity, level);
+}
+
+
+void PySceneManager::refineCBFunc(void *userdata, SoSensor * /*sensor*/)
+{
+	Object *self = (Object *) userdata;
+	if (self->refining && self->qualityLevel)
+	{
+		setQualityLevel(self, self->qualityLevel - 1);
+		self->refineRedraw = true;
+		self->sceneManager->scheduleRedraw();
+	}
+}
+
+
+void PySceneManager::setQualityComplexity(SoComplexity *complexity, int level)
+{
+	// at full quality all fields are ignored and the node has no effect,
+	// it doesn't notify so level changes don't trigger redraws by themselves
+	if (!complexity) return;
+	complexity->setOverride(level ? TRUE : FALSE);
+	complexity->type.setIgnored(level ? FALSE : TRUE);
+	complexity->value.setIgnored(level ? FALSE : TRUE);
+	complexity->textureQuality.setIgnored(level ? FALSE : TRUE);
+
+	switch (level)
+	{
+	case 0:
+		complexity->type = SoComplexity::OBJECT_SPACE;
+		complexity->value = 0.5f;
+		complexity->textureQuality = 0.5f;
+		break;
+	case 1:
+		complexity->type = SoComplexity::SCREEN_SPACE;
+		complexity->value = 0.3f;
+		complexity->textureQuality = 0.5f;
+		break;
+	case 2:
+		complexity->type = SoComplexity::SCREEN_SPACE;
+		complexity->value = 0.1f;
+		complexity->textureQuality = 0.1f;
+		break;
+	default:
+		complexity->type = SoComplexity::BOUNDING_BOX;
+		complexity->value = 0.f;
+		complexity->textureQuality = 0.f;
+	}
+}
@@ -14,11 +14,17 @@
 
 #include "PySceneObject.h"
 #include <Inventor/nodes/SoCamera.h>
+#include <Inventor/SbTime.h>
 
 class SoSceneManager;
 class SoSeparator;
 class SbSphereSheetProjector;
 class SoEvent;
+class SoSensor;
+class SoOneShotSensor;
+class SoAlarmSensor;
+class SoIdleSensor;
+class SoComplexity;
 
 // for VSG Inventor use of context class is required
 class SoGLContext;
@@ -30,8 +36,22 @@ public:
 	static PyTypeObject *getType();
 	static bool getScene(PyObject* self, PyObject *&scene_out, int &viewportWidth_out, int &viewportHeight_out, SbColor &backgroundColor_out, SoSeparator **backgroundScene_out = 0);
 	static SbBool getBackgroundFromObject(PyObject *object, SbColor &color_out, SoSeparator **scene_inout);
+	static void setQualityComplexity(SoComplexity *complexity, int level);
 
 private:
+	// number of frames averaged in statistics
+	static const int STATS_WINDOW = 60;
+
+	typedef struct
+	{
+		// layout matches the record returned by frame_stats()
+		double frameTime, averageFrameTime;
+		double traversalTime, averageTraversalTime;
+		double finishTime, averageFinishTime;
+		Py_ssize_t frames, redrawRequests;
+		Py_ssize_t nodes, triangles, cacheHits, cacheMisses, culled;
+	} FrameStats;
+
 	typedef struct 
 	{
 		PyObject_HEAD
@@ -47,6 +67,34 @@ private:
 			CAMERA
 		} manipMode;
 		bool isManipulating;
+		FrameStats stats;
+		double statsHistory[3][STATS_WINDOW];
+		int statsCount;
+		uint32_t statsNodeId;
+		char finish;
+		char detailedStats;
+		bool countersEnabled;
+		char coalesceMoves;
+		bool movePending;
+		SbVec2s movePosition;
+		SbTime moveTime;
+		SoOneShotSensor *moveSensor;
+		double frameInterval;
+		double lastRedraw;
+		SoAlarmSensor *pacingSensor;
+		char adaptiveQuality;
+		double targetFrameTime;
+		int qualityLevel;
+		int savedTransparencyType;
+		int savedNumPasses;
+		SoSeparator *renderRoot;
+		SoComplexity *qualityComplexity;
+		char progressive;
+		double progressiveBudget;
+		double fullFrameTime;
+		bool refining;
+		bool refineRedraw;
+		SoIdleSensor *refineSensor;
 	} Object;
 
 	// type implementations
@@ -67,11 +115,22 @@ private:
 	static PyObject* interaction(Object *self, PyObject *args);
     static PyObject* is_grabbing(Object *self);
     static PyObject* release_grabber(Object *self);
+	static PyObject* frame_stats(Object *self, PyObject *args, PyObject *kwds);
 
 	// internal
 	static void renderCBFunc(void *userdata, SoSceneManager *mgr);
+	static void pacingCBFunc(void *userdata, SoSensor *sensor);
+	static void moveCBFunc(void *userdata, SoSensor *sensor);
+	static void invokeRedraw(Object *self);
+	static void flushMove(Object *self);
+	static bool isInteracting(Object *self);
+	static void adaptQuality(Object *self);
+	static void setQualityLevel(Object *self, int level);
+	static void refineCBFunc(void *userdata, SoSensor *sensor);
 	static void processEvent(Object *self, SoEvent *e);
+	static SoNode *getSceneNode(Object *self);
 	static SoCamera *getCamera(Object *self);
 	static void rotateCamera(SoCamera *camera, SbRotation orient);
+	static void recordFrame(Object *self, double traversalTime, double finishTime);
 };
 
@@ -23,7 +23,11 @@
 #include <Inventor/fields/SoFields.h>
 #include <Inventor/actions/SoSearchAction.h>
 #include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/actions/SoWriteAction.h>
 #include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/sensors/SoNodeSensor.h>
 #include <Inventor/SoInteraction.h>
 #include <Inventor/errors/SoErrors.h>
 
@@ -35,12 +39,17 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "PySceneObject.h"
 #include "PyField.h"
 #include "PyEngineOutput.h"
 #include "PyPath.h"
 #include "PyNodekitCatalog.h"
+#include "PyEngine.h"
+#include "SoExpressionEngine.h"
+#include "SoPointCloud.h"
+#include "PyProfiler.h"
 
 #pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
 
@@ -284,6 +293,18 @@ PyTypeObject *PySceneObject::getFieldContainerType()
             "\n"
             "Returns:\n"
             "    Internal pointer to field container instance.\n"
+        },
+        {"__reduce__", (PyCFunction) reduce, METH_NOARGS,
+            "Returns state for pickling a scene object.\n"
+            "\n"
+            "Nodes are serialized with all children in the binary Inventor file\n"
+            "format, so they can be passed to multiprocessing workers. Engines\n"
+            "are recreated from their type and field values.\n"
+            "Each node is written on its own, sharing is only kept within its\n"
+            "graph. Pickling a node together with one of its descendants, e.g.\n"
+            "[root, root[0]], stores the descendant twice and unpickles two\n"
+            "separate copies, so pickle the common root only and look up\n"
+            "descendants after unpickling.\n"
         },
 		{NULL}  /* Sentinel */
 	};
@@ -546,6 +567,10 @@ PyTypeObject *PySceneObject::getWrapperType(const char *typeName)
     {
         return getEngineType();
     }
+    else if (SbName("PyEngine") == typeName)
+    {
+        return PyEngine::getType();
+    }
     else if ((SbName("FieldContainer") == typeName) || (SbName("GlobalField") == typeName))
     {
         return getFieldContainerType();
@@ -629,6 +654,8 @@ PyTypeObject *PySceneObject::getWrapperType(const char *typeName)
 
 PyObject *PySceneObject::createWrapper(SoFieldContainer *instance, bool createClone)
 {
+	PyProfiler::TraceScope trace("SceneObject.createWrapper");
+
     if (instance)
     {
         PyObject *obj = 0;
@@ -675,6 +702,10 @@ void PySceneObject::initSoDB()
 		SoDB::init();
 		SoInteraction::init();
 #endif
+		PyEngine::initClass();
+		SoExpressionEngine::initClass();
+		SoPointCloud::initClass();
+
 		// VSG inventor performs HW check in first call to SoGLRenderAction
 		SoGLRenderAction aR(SbViewportRegion(1, 1));
 
@@ -896,6 +927,8 @@ void PySceneObject::setInstance(Object *self, SoFieldContainer *obj)
 
 PyObject* PySceneObject::tp_getattro(Object* self, PyObject *attrname)
 {
+	PyProfiler::TraceScope trace("SceneObject.getattr");
+
 	const char *fieldName = PyUnicode_AsUTF8(attrname);
 	if (self->inventorObject && fieldName)
 	{
@@ -952,6 +985,8 @@ PyObject* PySceneObject::tp_getattro(Object* self, PyObject *attrname)
 
 int PySceneObject::tp_setattro(Object* self, PyObject *attrname, PyObject *value)
 {
+	PyProfiler::TraceScope trace("SceneObject.setattr");
+
 	const char *fieldName = PyUnicode_AsUTF8(attrname);
 	if (self->inventorObject && fieldName)
 	{
@@ -1778,3 +1813,160 @@ PyObject* PySceneObject::get_nodekit_catalog(Object *self)
     Py_INCREF(Py_None);
     return Py_None;
 }
+
+
+PyObject *PySceneObject::writeBuffer(SoNode *node, bool binary)
+{
+    PyObject *result = NULL;
+    size_t size = 1024 * 1024;
+    void *buffer = malloc(size);
+
+    SoOutput out;
+    out.setBinary(binary ? TRUE : FALSE);
+    out.setBuffer(buffer, size, realloc);
+    SoWriteAction wa(&out);
+    wa.apply(node);
+
+    #ifdef getBuffer
+    #undef getBuffer
+    #endif
+    size_t n = 0;
+    if (out.getBuffer(buffer, n))
+    {
+        if (binary)
+        {
+            result = PyBytes_FromStringAndSize((const char*) buffer, n);
+        }
+        else
+        {
+            result = PyUnicode_FromStringAndSize((const char*) buffer, n);
+        }
+    }
+    free(buffer);
+
+    return result;
+}
+
+
+SoNode *PySceneObject::readBuffer(PyObject *data)
+{
+    char *buffer = 0;
+    Py_ssize_t size = 0;
+    if (!PyBytes_Check(data) || (PyBytes_AsStringAndSize(data, &buffer, &size) != 0))
+    {
+        return NULL;
+    }
+
+    initSoDB();
+
+    SoInput in;
+    in.setBuffer(buffer, size);
+    SoNode *node = 0;
+    if (!SoDB::read(&in, node) || !node)
+    {
+        return NULL;
+    }
+
+    return node;
+}
+
+
+PyObject* PySceneObject::reduce(Object *self)
+{
+    if (self->inventorObject && self->inventorObject->isOfType(SoNode::getClassTypeId()))
+    {
+        SoNode *node = (SoNode*) self->inventorObject;
+
+        // nodes shared within the graph are written once and referenced by
+        // USE, so they are shared again after reading
+        PyObject *data = writeBuffer(node, true);
+        if (!data)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to serialize scene object");
+            return NULL;
+        }
+
+        PyObject *module = PyImport_ImportModule("inventor");
+        PyObject *reader = module ? PyObject_GetAttrString(module, "read") : NULL;
+        Py_XDECREF(module);
+        if (!reader)
+        {
+            Py_DECREF(data);
+            return NULL;
+        }
+
+        return Py_BuildValue("(N(N))", reader, data);
+    }
+    else if (self->inventorObject && self->inventorObject->isOfType(SoEngine::getClassTypeId()) &&
+        !self->inventorObject->isOfType(SoGate::getClassTypeId()) &&
+        !self->inventorObject->isOfType(SoConcatenate::getClassTypeId()) &&
+        !self->inventorObject->isOfType(SoSelectOne::getClassTypeId()))
+    {
+        SbString value;
+        self->inventorObject->get(value);
+
+        PyObject *module = PyImport_ImportModule("inventor");
+        PyObject *creator = module ? PyObject_GetAttrString(module, "create_object") : NULL;
+        Py_XDECREF(module);
+        if (!creator)
+        {
+            return NULL;
+        }
+
+        return Py_BuildValue("(N(ss))", creator, self->inventorObject->getTypeId().getName().getString(), value.getString());
+    }
+
+    PyErr_SetString(PyExc_TypeError, "Scene object cannot be pickled");
+    return NULL;
+}
+
+
+// Python objects whose lifetime is bound to a node (e.g. buffers referenced by fields),
+// the sensor ignores changes of the node and only reports its deletion
+class KeepAliveSensor : public SoNodeSensor
+{
+public:
+    std::vector<PyObject*> objects;
+    virtual void notify(SoNotList * /*list*/) {}
+};
+
+static std::map<SoNode*, KeepAliveSensor*> keepAliveSensors;
+static std::vector<KeepAliveSensor*> deadKeepAliveSensors;
+
+
+static void keepAliveDeleteCB(void *userdata, SoSensor * /*sensor*/)
+{
+    // sensor can't be deleted from within its delete callback, so it is
+    // deleted on next call of keepAlive()
+    KeepAliveSensor *sensor = (KeepAliveSensor*) userdata;
+    keepAliveSensors.erase(sensor->getAttachedNode());
+    for (size_t i = 0; i < sensor->objects.size(); ++i)
+    {
+        Py_DECREF(sensor->objects[i]);
+    }
+    sensor->objects.clear();
+    deadKeepAliveSensors.push_back(sensor);
+}
+
+
+void PySceneObject::keepAlive(SoNode *node, PyObject *object)
+{
+    for (size_t i = 0; i < deadKeepAliveSensors.size(); ++i)
+    {
+        delete deadKeepAliveSensors[i];
+    }
+    deadKeepAliveSensors.clear();
+
+    if (node && object)
+    {
+        KeepAliveSensor *&sensor = keepAliveSensors[node];
+        if (!sensor)
+        {
+            sensor = new KeepAliveSensor();
+            sensor->setDeleteCallback(keepAliveDeleteCB, sensor);
+            sensor->attach(node);
+        }
+        Py_INCREF(object);
+        sensor->objects.push_back(object);
+    }
+}
@@ -30,6 +30,7 @@
 
 
 class SoFieldContainer;
+class SoNode;
 
 
 class PySceneObject
@@ -44,6 +45,13 @@ public:
 
 	static int setFields(SoFieldContainer *fieldContainer, char *value);
 
+	// helper methods for reading/writing scene graphs from/to memory
+	static PyObject *writeBuffer(SoNode *node, bool binary);
+	static SoNode *readBuffer(PyObject *data);
+
+	// holds a reference to a Python object until node is destroyed
+	static void keepAlive(SoNode *node, PyObject *object);
+
 	static void initSoDB();
 
 	typedef struct 
@@ -100,6 +108,7 @@ private:
 
     // generic field container
     static PyObject* internal_pointer(Object *self);
+    static PyObject* reduce(Object *self);
 
     // SoTransformManip
     static PyObject* replace_node(Object *self, PyObject *args);
@@ -13,13 +13,26 @@
 #include <Inventor/sensors/SoSensors.h>
 #include <Inventor/fields/SoFieldContainer.h>
 #include <Inventor/nodes/SoSelection.h>
+#include <Inventor/fields/SoFields.h>
 #include "PySensor.h"
 #include "PyPath.h"
+#include "PyProfiler.h"
+#include <math.h>
+#include <chrono>
 
 #pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
 #pragma warning ( disable : 4244 ) // possible loss of data when converting int to short in SbVec2s
 
 
+// macro for reading scalar single-field value
+#define SOFIELD_GET_SCALAR(t, f, v) \
+	if (f->isOfType(SoSF ## t ::getClassTypeId())) { v[0] = (double) ((SoSF ## t *) f)->getValue(); return 1; }
+
+// macro for reading vector single-field value
+#define SOFIELD_GET_VECTOR(t, n, f, v) \
+	if (f->isOfType(SoSF ## t ::getClassTypeId())) { const float *d = ((SoSF ## t *) f)->getValue().getValue(); for (int i = 0; i < n; ++i) v[i] = d[i]; return n; }
+
+
 PyTypeObject *PySensor::getType()
 {
 	static PyMemberDef members[] = 
@@ -29,6 +42,16 @@ PyTypeObject *PySensor::getType()
             "\n"
             "An object can be assigned to that property which is called when a\n"
             "sensor is triggered.\n"
+        },
+		{"jitter", T_DOUBLE, offsetof(Object, jitter), READONLY,
+            "Lateness in seconds of the last tick of a monotonic timer.\n"
+        },
+		{"ticks", T_PYSSIZET, offsetof(Object, ticks), READONLY,
+            "Number of ticks delivered since a monotonic timer was scheduled.\n"
+        },
+		{"missed", T_PYSSIZET, offsetof(Object, missed), READONLY,
+            "Number of ticks of a monotonic timer that were skipped before the\n"
+            "last callback because queue processing was late.\n"
         },
 		{NULL}  /* Sentinel */
 	};
@@ -53,17 +76,26 @@ PyTypeObject *PySensor::getType()
 		{"detach", (PyCFunction) detach, METH_NOARGS,
             "Deactivates a sensor.\n"
         },
-		{"set_interval", (PyCFunction) set_interval, METH_VARARGS,
-            "Sets up a timer sensor with a regular interval.\n"
+		{"set_interval", (PyCFunction) set_interval, METH_VARARGS | METH_KEYWORDS,
+            "Sets up a timer sensor with a regular interval. A regular timer is\n"
+            "rescheduled relative to when its callback fired and therefore drifts.\n"
+            "A monotonic timer schedules tick n at start + n * interval on a\n"
+            "monotonic clock and reports the lateness of each tick in the jitter\n"
+            "attribute.\n"
             "\n"
             "Args:\n"
-            "    Timer interval in milliseconds.\n"
+            "    interval: Timer interval in seconds.\n"
+            "    monotonic: If True the timer is scheduled against a monotonic\n"
+            "               clock without accumulating drift.\n"
+            "    catch_up: If True a late monotonic timer calls the callback once\n"
+            "              for every missed tick, otherwise missed ticks are\n"
+            "              skipped and counted in the missed attribute.\n"
         },
 		{"set_time", (PyCFunction) set_time, METH_VARARGS,
             "Sets up an alarm sensor that is trigegred at a given time from now.\n"
             "\n"
             "Args:\n"
-            "    Timer from now in milliseconds when the sensor will be triggered.\n"
+            "    Time from now in seconds when the sensor will be triggered.\n"
         },
 		{"schedule", (PyCFunction) schedule, METH_NOARGS,
             "Schedules a timer sensor."
@@ -76,6 +108,23 @@ PyTypeObject *PySensor::getType()
             "\n"
             "Returns:\n"
             "    True is sensor is currently scheduled, otherwise False.\n"
+        },
+		{"set_filter", (PyCFunction) set_filter, METH_VARARGS | METH_KEYWORDS,
+            "Sets up native predicates that are checked before the callback is\n"
+            "called, so that Python is only invoked for relevant changes. Value\n"
+            "tests apply to field sensors only and compare against the value of\n"
+            "the last delivered change. Calling without arguments removes the\n"
+            "filter.\n"
+            "\n"
+            "Args:\n"
+            "    epsilon: Only trigger if a component changed by more than epsilon\n"
+            "             (for non-numeric fields any change passes).\n"
+            "    range: Tuple (low, high), only trigger when the value enters or\n"
+            "           leaves the range.\n"
+            "    mask: Only trigger if any of the masked bits changed.\n"
+            "    min_interval: Minimum time in seconds between two callbacks on\n"
+            "                  the monotonic clock, the last change held back\n"
+            "                  is delivered once the interval has passed.\n"
         },
 		{NULL}  /* Sentinel */
 	};
@@ -147,14 +196,27 @@ void PySensor::unregisterSelectionCB(Object *self)
 }
 
 
-void PySensor::tp_dealloc(Object* self)
+void PySensor::deleteSensor(Object *self)
 {
 	if (self->sensor)
 	{
 		delete self->sensor;
+		self->sensor = 0;
 	}
 
+	if (self->timer)
+	{
+		delete self->timer;
+		self->timer = 0;
+	}
+}
+
+
+void PySensor::tp_dealloc(Object* self)
+{
+	deleteSensor(self);
     unregisterSelectionCB(self);
+    deleteFilter(self);
     
 	Py_XDECREF(self->callback);
 
@@ -171,6 +233,12 @@ PyObject* PySensor::tp_new(PyTypeObject *type, PyObject* /*args*/, PyObject* /*k
 	{
 		self->callback = 0;
 		self->sensor = 0;
+		self->field = 0;
+		self->filter = 0;
+		self->timer = 0;
+		self->jitter = 0.;
+		self->ticks = 0;
+		self->missed = 0;
         self->selection = 0;
         self->selectionCB = Object::CB_SELECTION;
     }
@@ -192,8 +260,10 @@ int PySensor::tp_init(Object *self, PyObject *args, PyObject * /*kwds*/)
 
 void PySensor::sensorCBFunc(void *userdata, SoSensor* /*sensor*/)
 {
+	PyProfiler::TraceScope trace("Sensor.callback");
+
 	Object *self = (Object *) userdata;
-	if ((self != NULL) && (self->callback != NULL) && PyCallable_Check(self->callback))
+	if ((self != NULL) && (self->callback != NULL) && passFilter(self) && PyCallable_Check(self->callback))
 	{
 		PyObject *value = PyObject_CallObject(self->callback, NULL);
 		if (value != NULL)
@@ -204,8 +274,64 @@ void PySensor::sensorCBFunc(void *userdata, SoSensor* /*sensor*/)
 }
 
 
+void PySensor::timerCBFunc(void *userdata, SoSensor *sensor)
+{
+	Object *self = (Object *) userdata;
+	if ((self == NULL) || (self->timer == NULL)) return;
+
+	Timer *timer = self->timer;
+	double now = getMonotonicTime();
+	double deadline = timer->next;
+	Py_ssize_t due = 1;
+	if (now > deadline)
+	{
+		due += (Py_ssize_t) floor((now - deadline) / timer->interval);
+	}
+
+	// reschedule first so callback may unschedule or replace the timer
+	timer->next = deadline + due * timer->interval;
+	((SoAlarmSensor*) sensor)->setTimeFromNow(SbTime(timer->next - now));
+	sensor->schedule();
+
+	// callback may release the last reference to the sensor object
+	Py_INCREF(self);
+	if (timer->catchUp)
+	{
+		self->missed = 0;
+		for (Py_ssize_t i = 0; (i < due) && (self->sensor == sensor) && (self->timer == timer); ++i)
+		{
+			self->jitter = now - (deadline + i * timer->interval);
+			self->ticks++;
+			sensorCBFunc(self, sensor);
+		}
+	}
+	else
+	{
+		self->jitter = now - (deadline + (due - 1) * timer->interval);
+		self->missed = due - 1;
+		self->ticks++;
+		sensorCBFunc(self, sensor);
+	}
+	Py_DECREF(self);
+}
+
+
+void PySensor::trailingCBFunc(void *userdata, SoSensor * /*sensor*/)
+{
+	// held back change is dropped if sensor was detached meanwhile
+	Object *self = (Object *) userdata;
+	if ((self == NULL) || (self->sensor == NULL)) return;
+
+	Py_INCREF(self);
+	sensorCBFunc(self, self->sensor);
+	Py_DECREF(self);
+}
+
+
 void PySensor::selectionPathCB(void * userdata, SoPath * path)
 {
+	PyProfiler::TraceScope trace("Sensor.callback");
+
     Object *self = (Object *)userdata;
     if ((self != NULL) && (self->callback != NULL) && PyCallable_Check(self->callback))
     {
@@ -220,6 +346,8 @@ void PySensor::selectionPathCB(void * userdata, SoPath * path)
 
 void PySensor::selectionClassCB(void * userdata, SoSelection * sel)
 {
+	PyProfiler::TraceScope trace("Sensor.callback");
+
     Object *self = (Object *)userdata;
     if ((self != NULL) && (self->callback != NULL) && PyCallable_Check(self->callback))
     {
@@ -291,11 +419,7 @@ PyObject* PySensor::attach(Object *self, PyObject *args)
 
 		if ((fc && !fieldName) || field)
 		{
-			if (self->sensor)
-			{
-				delete self->sensor;
-				self->sensor = 0;
-			}
+			deleteSensor(self);
 
 			if (field)
 			{
@@ -307,6 +431,9 @@ PyObject* PySensor::attach(Object *self, PyObject *args)
 				self->sensor = new SoNodeSensor(sensorCBFunc, self);
 				((SoNodeSensor*) self->sensor)->attach((SoNode*) fc);
 			}
+
+			self->field = field;
+			updateFilter(self);
 		}
 
         // set callback attribute based on option third argument
@@ -325,11 +452,8 @@ PyObject* PySensor::attach(Object *self, PyObject *args)
 
 PyObject* PySensor::detach(Object *self)
 {
-	if (self->sensor)
-	{
-		delete self->sensor;
-		self->sensor = 0;
-	}
+	deleteSensor(self);
+	self->field = 0;
 
     unregisterSelectionCB(self);
 
@@ -338,17 +462,42 @@ PyObject* PySensor::detach(Object *self)
 }
 
 
-PyObject* PySensor::set_interval(Object *self, PyObject *args)
+PyObject* PySensor::set_interval(Object *self, PyObject *args, PyObject *kwds)
 {
 	double interval = 0.;
-	if (PyArg_ParseTuple(args, "d", &interval))
+	int monotonic = 0, catchUp = 0;
+
+	static char *kwlist[] = { "interval", "monotonic", "catch_up", NULL};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "d|pp", kwlist, &interval, &monotonic, &catchUp))
 	{
-		if (self->sensor)
-		{
-			delete self->sensor;
-			self->sensor = 0;
-		}
+		return NULL;
+	}
+
+	if (monotonic && (interval <= 0.))
+	{
+		PyErr_SetString(PyExc_ValueError, "Interval of monotonic timer must be positive");
+		return NULL;
+	}
+
+	deleteSensor(self);
+	self->field = 0;
+	updateFilter(self);
 
+	self->jitter = 0.;
+	self->ticks = 0;
+	self->missed = 0;
+
+	if (monotonic)
+	{
+		self->timer = new Timer();
+		self->timer->interval = interval;
+		self->timer->next = 0.;
+		self->timer->catchUp = catchUp != 0;
+		self->sensor = new SoAlarmSensor(timerCBFunc, self);
+	}
+	else
+	{
 		self->sensor = new SoTimerSensor(sensorCBFunc, self);
 		((SoTimerSensor*) self->sensor)->setInterval(SbTime(interval));
 	}
@@ -363,11 +512,9 @@ PyObject* PySensor::set_time(Object *self, PyObject *args)
 	double time = 0.;
 	if (PyArg_ParseTuple(args, "d", &time))
 	{
-		if (self->sensor)
-		{
-			delete self->sensor;
-			self->sensor = 0;
-		}
+		deleteSensor(self);
+		self->field = 0;
+		updateFilter(self);
 
 		self->sensor = new SoAlarmSensor(sensorCBFunc, self);
 		((SoAlarmSensor*) self->sensor)->setTimeFromNow(SbTime(time));
@@ -382,6 +529,14 @@ PyObject* PySensor::schedule(Object *self)
 {
 	if (self->sensor && !self->sensor->isScheduled())
 	{
+		if (self->timer)
+		{
+			// first tick is one interval from now
+			self->timer->next = getMonotonicTime() + self->timer->interval;
+			((SoAlarmSensor*) self->sensor)->setTimeFromNow(SbTime(self->timer->interval));
+			self->ticks = 0;
+			self->missed = 0;
+		}
 		self->sensor->schedule();
 	}
 
@@ -414,3 +569,203 @@ PyObject* PySensor::is_scheduled(Object *self)
 	return PyBool_FromLong(val);
 }
 
+
+PyObject* PySensor::set_filter(Object *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *epsilon = NULL, *range = NULL, *mask = NULL, *minInterval = NULL;
+
+	static char *kwlist[] = { "epsilon", "range", "mask", "min_interval", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOOO", kwlist, &epsilon, &range, &mask, &minInterval))
+	{
+		return NULL;
+	}
+
+	Filter filter;
+	memset(&filter, 0, sizeof(filter));
+
+	if (epsilon && (epsilon != Py_None))
+	{
+		filter.epsilon = PyFloat_AsDouble(epsilon);
+		filter.useEpsilon = true;
+	}
+	if (range && (range != Py_None))
+	{
+		if (!PyArg_ParseTuple(range, "dd", &filter.low, &filter.high)) return NULL;
+		filter.useRange = true;
+	}
+	if (mask && (mask != Py_None))
+	{
+		filter.mask = (uint32_t) PyLong_AsUnsignedLongMask(mask);
+		filter.useMask = true;
+	}
+	if (minInterval && (minInterval != Py_None))
+	{
+		filter.minInterval = PyFloat_AsDouble(minInterval);
+	}
+	if (PyErr_Occurred())
+	{
+		return NULL;
+	}
+
+	deleteFilter(self);
+	if (filter.useEpsilon || filter.useRange || filter.useMask || (filter.minInterval > 0.))
+	{
+		self->filter = new Filter(filter);
+		if (filter.minInterval > 0.)
+		{
+			self->filter->trailing = new SoAlarmSensor(trailingCBFunc, self);
+		}
+		updateFilter(self);
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+int PySensor::getFieldValues(SoField *field, double *values_out)
+{
+	SOFIELD_GET_SCALAR(Float, field, values_out);
+	SOFIELD_GET_SCALAR(Double, field, values_out);
+	SOFIELD_GET_SCALAR(Int32, field, values_out);
+	SOFIELD_GET_SCALAR(UInt32, field, values_out);
+	SOFIELD_GET_SCALAR(Short, field, values_out);
+	SOFIELD_GET_SCALAR(UShort, field, values_out);
+	SOFIELD_GET_SCALAR(Bool, field, values_out);
+	SOFIELD_GET_SCALAR(Enum, field, values_out);
+	SOFIELD_GET_VECTOR(Vec2f, 2, field, values_out);
+	SOFIELD_GET_VECTOR(Vec3f, 3, field, values_out);
+	SOFIELD_GET_VECTOR(Vec4f, 4, field, values_out);
+	SOFIELD_GET_VECTOR(Color, 3, field, values_out);
+	SOFIELD_GET_VECTOR(Rotation, 4, field, values_out);
+
+	if (field->isOfType(SoSFTime::getClassTypeId()))
+	{
+		values_out[0] = ((SoSFTime*) field)->getValue().getValue();
+		return 1;
+	}
+
+	if (field->isOfType(SoSFMatrix::getClassTypeId()))
+	{
+		const float *d = (const float*) ((SoSFMatrix*) field)->getValue().getValue();
+		for (int i = 0; i < 16; ++i) values_out[i] = d[i];
+		return 16;
+	}
+
+	return -1;
+}
+
+
+void PySensor::updateFilter(Object *self)
+{
+	// takes snapshot of current field value as reference for predicates
+	Filter *filter = self->filter;
+	if (!filter) return;
+
+	if (filter->copy)
+	{
+		delete filter->copy;
+		filter->copy = 0;
+	}
+
+	filter->numValues = 0;
+	filter->hasLast = false;
+	if (filter->trailing && filter->trailing->isScheduled())
+	{
+		filter->trailing->unschedule();
+	}
+
+	if (self->field)
+	{
+		filter->numValues = getFieldValues(self->field, filter->values);
+		if ((filter->numValues < 0) && filter->useEpsilon)
+		{
+			filter->copy = (SoField*) self->field->getTypeId().createInstance();
+			if (filter->copy) filter->copy->copyFrom(*self->field);
+		}
+	}
+}
+
+
+bool PySensor::passFilter(Object *self)
+{
+	Filter *filter = self->filter;
+	if (!filter) return true;
+
+	// changes within minInterval are held back, the last one of a burst is
+	// delivered by the trailing alarm once the interval has passed
+	double now = getMonotonicTime();
+	if ((filter->minInterval > 0.) && filter->hasLast && (now - filter->lastTime < filter->minInterval))
+	{
+		if (filter->trailing && !filter->trailing->isScheduled())
+		{
+			filter->trailing->setTimeFromNow(SbTime(filter->lastTime + filter->minInterval - now));
+			filter->trailing->schedule();
+		}
+		return false;
+	}
+
+	if (self->field && (filter->useEpsilon || filter->useRange || filter->useMask))
+	{
+		double values[16];
+		int n = getFieldValues(self->field, values);
+		if ((n > 0) && (n == filter->numValues))
+		{
+			if (filter->useMask && ((((uint32_t) (int64_t) values[0]) & filter->mask) == (((uint32_t) (int64_t) filter->values[0]) & filter->mask)))
+			{
+				return false;
+			}
+
+			if (filter->useRange)
+			{
+				bool inside = (values[0] >= filter->low) && (values[0] <= filter->high);
+				bool wasInside = (filter->values[0] >= filter->low) && (filter->values[0] <= filter->high);
+				if (inside == wasInside) return false;
+			}
+
+			if (filter->useEpsilon)
+			{
+				bool changed = false;
+				for (int i = 0; (i < n) && !changed; ++i)
+				{
+					changed = fabs(values[i] - filter->values[i]) > filter->epsilon;
+				}
+				if (!changed) return false;
+			}
+
+			memcpy(filter->values, values, n * sizeof(double));
+		}
+		else if (filter->copy && filter->useEpsilon)
+		{
+			if (self->field->isSame(*filter->copy)) return false;
+			filter->copy->copyFrom(*self->field);
+		}
+	}
+
+	filter->lastTime = now;
+	filter->hasLast = true;
+	if (filter->trailing && filter->trailing->isScheduled())
+	{
+		filter->trailing->unschedule();
+	}
+
+	return true;
+}
+
+
+double PySensor::getMonotonicTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void PySensor::deleteFilter(Object *self)
+{
+	if (self->filter)
+	{
+		delete self->filter->copy;
+		delete self->filter->trailing;
+		delete self->filter;
+		self->filter = 0;
+	}
+}
@@ -15,7 +15,9 @@
 #include "PySceneObject.h"
 
 class SoSensor;
+class SoAlarmSensor;
 class SoSelection;
+class SoField;
 
 
 class PySensor
@@ -24,10 +26,40 @@ public:
 	static PyTypeObject *getType();
 
 private:
+	// native predicates evaluated before the Python callback is called
+	typedef struct
+	{
+		double epsilon, low, high, minInterval;
+		uint32_t mask;
+		bool useEpsilon, useRange, useMask;
+
+		// state of last delivered change
+		double values[16];
+		int numValues;
+		SoField *copy;
+		double lastTime;
+		bool hasLast;
+
+		// delivers last change suppressed by minInterval
+		SoAlarmSensor *trailing;
+	} Filter;
+
+	// timer scheduled against monotonic clock
+	typedef struct
+	{
+		double interval, next;
+		bool catchUp;
+	} Timer;
+
 	typedef struct 
 	{
 		PyObject_HEAD
 		SoSensor *sensor;
+		SoField *field;
+		Filter *filter;
+		Timer *timer;
+		double jitter;
+		Py_ssize_t ticks, missed;
         SoSelection *selection;
         enum {
             CB_SELECTION,
@@ -47,16 +79,25 @@ private:
 	// methods
 	static PyObject* attach(Object *self, PyObject *args);
 	static PyObject* detach(Object *self);
-	static PyObject* set_interval(Object *self, PyObject *args);
+	static PyObject* set_interval(Object *self, PyObject *args, PyObject *kwds);
 	static PyObject* set_time(Object *self, PyObject *args);
 	static PyObject* schedule(Object *self);
 	static PyObject* unschedule(Object *self);
 	static PyObject* is_scheduled(Object *self);
+	static PyObject* set_filter(Object *self, PyObject *args, PyObject *kwds);
 
 	// internal
     static void unregisterSelectionCB(Object *self);
+    static int getFieldValues(SoField *field, double *values_out);
+    static void updateFilter(Object *self);
+    static bool passFilter(Object *self);
+    static void deleteFilter(Object *self);
+    static void deleteSensor(Object *self);
+    static double getMonotonicTime();
     
     static void sensorCBFunc(void *userdata, SoSensor *sensor);
+    static void timerCBFunc(void *userdata, SoSensor *sensor);
+    static void trailingCBFunc(void *userdata, SoSensor *sensor);
     static void selectionPathCB(void * data, SoPath * path);
     static void selectionClassCB(void * data, SoSelection * sel);
 };
@@ -0,0 +1,445 @@
+/**
+ * \file
+ * \brief      PySharedScene class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoLists.h>
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/nodes/SoNode.h>
+#include <Inventor/fields/SoFields.h>
+#include "PySharedScene.h"
+#include <vector>
+#include <set>
+#include <limits.h>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+#pragma warning ( disable : 4244 ) // possible loss of data when converting int to short in SbVec2s
+
+
+// magic number at beginning of skeleton
+static const char sharedSceneMagic[8] = { 'I', 'V', 'S', 'H', 'M', '1', 0, 0 };
+
+// offsets of arrays in shared block are aligned to this value
+static const size_t sharedSceneAlignment = 64;
+
+
+PySharedScene::FieldKind PySharedScene::getFieldKind(SoField *field, size_t &elementSize_out)
+{
+    elementSize_out = 0;
+    if (!field) return UNSUPPORTED;
+
+    if (field->isOfType(SoMFFloat::getClassTypeId())) { elementSize_out = sizeof(float); return MF_FLOAT; }
+    if (field->isOfType(SoMFInt32::getClassTypeId())) { elementSize_out = sizeof(int32_t); return MF_INT32; }
+    if (field->isOfType(SoMFUInt32::getClassTypeId())) { elementSize_out = sizeof(uint32_t); return MF_UINT32; }
+    if (field->isOfType(SoMFShort::getClassTypeId())) { elementSize_out = sizeof(short); return MF_SHORT; }
+    if (field->isOfType(SoMFUShort::getClassTypeId())) { elementSize_out = sizeof(unsigned short); return MF_USHORT; }
+    if (field->isOfType(SoMFVec2f::getClassTypeId())) { elementSize_out = sizeof(SbVec2f); return MF_VEC2F; }
+    if (field->isOfType(SoMFVec3f::getClassTypeId())) { elementSize_out = sizeof(SbVec3f); return MF_VEC3F; }
+    if (field->isOfType(SoMFVec4f::getClassTypeId())) { elementSize_out = sizeof(SbVec4f); return MF_VEC4F; }
+    if (field->isOfType(SoMFColor::getClassTypeId())) { elementSize_out = sizeof(SbColor); return MF_COLOR; }
+    if (field->isOfType(SoSFImage::getClassTypeId())) { elementSize_out = 1; return SF_IMAGE; }
+
+    return UNSUPPORTED;
+}
+
+
+void PySharedScene::collectNodes(SoNode *root, SoNode **&nodes_out, int &numNodes_out)
+{
+    // returns all nodes of a graph in a deterministic order, both sides
+    // of the transport use this to match table entries with nodes
+    std::vector<SoNode*> nodes;
+    std::set<SoNode*> visited;
+
+    SoSearchAction sa;
+    sa.setType(SoNode::getClassTypeId());
+    sa.setSearchingAll(TRUE);
+    sa.setInterest(SoSearchAction::ALL);
+    sa.apply(root);
+
+    SoPathList &pl = sa.getPaths();
+    for (int i = 0; i < pl.getLength(); ++i)
+    {
+        SoNode *node = pl[i]->getTail();
+        if (node && (visited.find(node) == visited.end()))
+        {
+            visited.insert(node);
+            nodes.push_back(node);
+        }
+    }
+
+    numNodes_out = (int) nodes.size();
+    nodes_out = new SoNode*[nodes.size() + 1];
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        nodes_out[i] = nodes[i];
+    }
+}
+
+
+#define SHARED_MFIELD_DATA(t, f) (const void*) ((SoMF ## t *) f)->getValues(0)
+
+#if defined(__COIN__) || defined(TGS_VERSION)
+#define SHARED_MFIELD_ADOPT(t, ct, f, num, data) ((SoMF ## t *) f)->setValuesPointer(num, (ct *) data)
+#else
+#define SHARED_MFIELD_ADOPT(t, ct, f, num, data) SHARED_MFIELD_COPY(t, ct, f, num, data)
+#endif
+
+#define SHARED_MFIELD_COPY(t, ct, f, num, data) { ((SoMF ## t *) f)->setNum(num); ((SoMF ## t *) f)->setValues(0, num, (const ct *) data); }
+
+#define SHARED_MFIELD_SET(t, ct, f, num, data, adopt) { if (adopt) { SHARED_MFIELD_ADOPT(t, ct, f, num, data); } else SHARED_MFIELD_COPY(t, ct, f, num, data); }
+
+
+PyObject* PySharedScene::export_shared(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "applyTo", "minSize", NULL};
+    PyObject *applyTo = NULL;
+    Py_ssize_t minSize = 4096;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|n", kwlist, &applyTo, &minSize))
+    {
+        return NULL;
+    }
+
+    if (!PyNode_Check(applyTo) || !((PySceneObject::Object*) applyTo)->inventorObject)
+    {
+        PyErr_SetString(PyExc_TypeError, "First argument must be a node");
+        return NULL;
+    }
+
+    // bulk data is moved out of a copy so the original scene stays untouched
+    SoNode *root = ((SoNode*) ((PySceneObject::Object*) applyTo)->inventorObject)->copy(TRUE);
+    if (!root)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to copy scene");
+        return NULL;
+    }
+    root->ref();
+
+    SoNode **nodes = 0;
+    int numNodes = 0;
+    collectNodes(root, nodes, numNodes);
+
+    std::vector<FieldEntry> entries;
+    std::vector<SoField*> fields;
+    size_t blockSize = 0;
+
+    for (int i = 0; i < numNodes; ++i)
+    {
+        SoFieldList fl;
+        nodes[i]->getFields(fl);
+        for (int j = 0; j < fl.getLength(); ++j)
+        {
+            SoField *field = fl[j];
+            size_t elementSize = 0;
+            FieldKind kind = getFieldKind(field, elementSize);
+            if ((kind == UNSUPPORTED) || field->isConnected()) continue;
+
+            SbName name;
+            if (!nodes[i]->getFieldName(field, name) || (name.getLength() >= (int) sizeof(((FieldEntry*) 0)->field))) continue;
+
+            FieldEntry entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.node = (uint32_t) i;
+            entry.kind = (uint32_t) kind;
+            strcpy(entry.field, name.getString());
+
+            if (kind == SF_IMAGE)
+            {
+                SbVec2s size;
+                int nc = 0;
+                ((SoSFImage*) field)->getValue(size, nc);
+                entry.width = size[0];
+                entry.height = size[1];
+                entry.components = nc;
+                entry.count = (uint64_t) size[0] * size[1] * nc;
+            }
+            else
+            {
+                entry.count = (uint64_t) ((SoMField*) field)->getNum();
+            }
+
+            if (entry.count * elementSize < (uint64_t) minSize) continue;
+
+            entry.offset = blockSize;
+            blockSize += (size_t) (entry.count * elementSize);
+            blockSize = (blockSize + sharedSceneAlignment - 1) / sharedSceneAlignment * sharedSceneAlignment;
+
+            entries.push_back(entry);
+            fields.push_back(field);
+        }
+    }
+
+    // allocate shared block
+    PyObject *result = NULL;
+    PyObject *shm = NULL;
+    PyObject *module = PyImport_ImportModule("multiprocessing.shared_memory");
+    if (module)
+    {
+        PyObject *sharedMemoryType = PyObject_GetAttrString(module, "SharedMemory");
+        if (sharedMemoryType)
+        {
+            PyObject *shmArgs = PyTuple_New(0);
+            PyObject *shmKwds = Py_BuildValue("{s:O,s:n}", "create", Py_True, "size", (Py_ssize_t) (blockSize > 0 ? blockSize : 1));
+            shm = PyObject_Call(sharedMemoryType, shmArgs, shmKwds);
+            Py_DECREF(shmArgs);
+            Py_DECREF(shmKwds);
+            Py_DECREF(sharedMemoryType);
+        }
+        Py_DECREF(module);
+    }
+
+    PyObject *buf = shm ? PyObject_GetAttrString(shm, "buf") : NULL;
+    Py_buffer view;
+    if (buf && (PyObject_GetBuffer(buf, &view, PyBUF_WRITABLE) == 0))
+    {
+        // move bulk data into shared block and leave empty fields in skeleton
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            SoField *field = fields[i];
+            const FieldEntry &entry = entries[i];
+            unsigned char *dst = (unsigned char*) view.buf + entry.offset;
+            size_t elementSize = 0;
+            getFieldKind(field, elementSize);
+
+            const void *src = 0;
+            switch (entry.kind)
+            {
+            case MF_FLOAT: src = SHARED_MFIELD_DATA(Float, field); break;
+            case MF_INT32: src = SHARED_MFIELD_DATA(Int32, field); break;
+            case MF_UINT32: src = SHARED_MFIELD_DATA(UInt32, field); break;
+            case MF_SHORT: src = SHARED_MFIELD_DATA(Short, field); break;
+            case MF_USHORT: src = SHARED_MFIELD_DATA(UShort, field); break;
+            case MF_VEC2F: src = SHARED_MFIELD_DATA(Vec2f, field); break;
+            case MF_VEC3F: src = SHARED_MFIELD_DATA(Vec3f, field); break;
+            case MF_VEC4F: src = SHARED_MFIELD_DATA(Vec4f, field); break;
+            case MF_COLOR: src = SHARED_MFIELD_DATA(Color, field); break;
+            case SF_IMAGE:
+                {
+                    SbVec2s size;
+                    int nc = 0;
+                    src = ((SoSFImage*) field)->getValue(size, nc);
+                }
+                break;
+            }
+
+            if (src) memcpy(dst, src, (size_t) (entry.count * elementSize));
+
+            if (entry.kind == SF_IMAGE)
+            {
+                ((SoSFImage*) field)->setValue(SbVec2s(0, 0), 0, NULL);
+            }
+            else
+            {
+                ((SoMField*) field)->setNum(0);
+            }
+        }
+        PyBuffer_Release(&view);
+
+        // skeleton consists of header, field table and binary Inventor scene
+        PyObject *scene = PySceneObject::writeBuffer(root, true);
+        if (scene)
+        {
+            uint32_t numEntries = (uint32_t) entries.size();
+            size_t tableSize = sizeof(sharedSceneMagic) + sizeof(numEntries) + entries.size() * sizeof(FieldEntry);
+            PyObject *skeleton = PyBytes_FromStringAndSize(NULL, (Py_ssize_t) tableSize + PyBytes_Size(scene));
+            if (skeleton)
+            {
+                char *ptr = PyBytes_AsString(skeleton);
+                memcpy(ptr, sharedSceneMagic, sizeof(sharedSceneMagic));
+                ptr += sizeof(sharedSceneMagic);
+                memcpy(ptr, &numEntries, sizeof(numEntries));
+                ptr += sizeof(numEntries);
+                if (numEntries) memcpy(ptr, &entries[0], entries.size() * sizeof(FieldEntry));
+                ptr += entries.size() * sizeof(FieldEntry);
+                memcpy(ptr, PyBytes_AsString(scene), PyBytes_Size(scene));
+
+                result = Py_BuildValue("(NO)", skeleton, shm);
+            }
+            Py_DECREF(scene);
+        }
+        else
+        {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to serialize scene");
+        }
+    }
+
+    Py_XDECREF(buf);
+    if (!result && shm)
+    {
+        // don't leak shared memory segment on failure
+        PyObject *ret = PyObject_CallMethod(shm, "close", NULL);
+        Py_XDECREF(ret);
+        ret = PyObject_CallMethod(shm, "unlink", NULL);
+        Py_XDECREF(ret);
+    }
+    Py_XDECREF(shm);
+
+    delete [] nodes;
+    root->unref();
+
+    return result;
+}
+
+
+PyObject* PySharedScene::import_shared(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "skeleton", "buffer", "copy", NULL};
+    PyObject *skeleton = NULL, *buffer = NULL;
+    int copy = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "SO|p", kwlist, &skeleton, &buffer, &copy))
+    {
+        return NULL;
+    }
+
+    // accept SharedMemory instances as well as any object supporting buffer protocol
+    PyObject *bufferObj = NULL;
+    if (PyObject_CheckBuffer(buffer))
+    {
+        bufferObj = buffer;
+        Py_INCREF(bufferObj);
+    }
+    else
+    {
+        bufferObj = PyObject_GetAttrString(buffer, "buf");
+        if (!bufferObj) return NULL;
+    }
+
+    char *data = 0;
+    Py_ssize_t size = 0;
+    PyBytes_AsStringAndSize(skeleton, &data, &size);
+
+    uint32_t numEntries = 0;
+    size_t headerSize = sizeof(sharedSceneMagic) + sizeof(numEntries);
+    if ((size < (Py_ssize_t) headerSize) || memcmp(data, sharedSceneMagic, sizeof(sharedSceneMagic)))
+    {
+        Py_DECREF(bufferObj);
+        PyErr_SetString(PyExc_ValueError, "Invalid shared scene skeleton");
+        return NULL;
+    }
+    memcpy(&numEntries, data + sizeof(sharedSceneMagic), sizeof(numEntries));
+    size_t tableSize = headerSize + numEntries * sizeof(FieldEntry);
+    if ((size_t) size < tableSize)
+    {
+        Py_DECREF(bufferObj);
+        PyErr_SetString(PyExc_ValueError, "Invalid shared scene skeleton");
+        return NULL;
+    }
+
+    std::vector<FieldEntry> entries(numEntries);
+    if (numEntries) memcpy(&entries[0], data + headerSize, numEntries * sizeof(FieldEntry));
+
+    PySceneObject::initSoDB();
+
+    SoInput in;
+    in.setBuffer(data + tableSize, size - tableSize);
+    SoNode *root = 0;
+    if (!SoDB::read(&in, root) || !root)
+    {
+        Py_DECREF(bufferObj);
+        PyErr_SetString(PyExc_ValueError, "Failed to read shared scene skeleton");
+        return NULL;
+    }
+    root->ref();
+
+    // a memoryview holds the buffer export for as long as fields need it
+    PyObject *memoryView = PyMemoryView_FromObject(bufferObj);
+    Py_DECREF(bufferObj);
+    if (!memoryView)
+    {
+        root->unref();
+        return NULL;
+    }
+    Py_buffer *view = PyMemoryView_GET_BUFFER(memoryView);
+
+    // fields only reference shared memory if it is writable, so that
+    // later edits of a field don't fault
+    bool adopt = !copy && !view->readonly;
+
+    SoNode **nodes = 0;
+    int numNodes = 0;
+    collectNodes(root, nodes, numNodes);
+    std::vector<bool> adopted(numNodes, false);
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        FieldEntry &entry = entries[i];
+        entry.field[sizeof(entry.field) - 1] = 0;
+        if (entry.node >= (uint32_t) numNodes) continue;
+
+        SoField *field = nodes[entry.node]->getField(SbName(entry.field));
+        size_t elementSize = 0;
+        if ((getFieldKind(field, elementSize) != (FieldKind) entry.kind) || !elementSize ||
+            (entry.offset > (uint64_t) view->len) ||
+            (entry.count > ((uint64_t) view->len - entry.offset) / elementSize) ||
+            (entry.count > (uint64_t) INT_MAX))
+        {
+            continue;
+        }
+        if ((entry.kind == SF_IMAGE) && ((entry.width < 0) || (entry.height < 0) || (entry.components < 0) ||
+            ((uint64_t) entry.width * (uint64_t) entry.height * (uint64_t) entry.components > entry.count)))
+        {
+            continue;
+        }
+
+        void *src = (unsigned char*) view->buf + entry.offset;
+        int num = (int) entry.count;
+        switch (entry.kind)
+        {
+        case MF_FLOAT: SHARED_MFIELD_SET(Float, float, field, num, src, adopt); break;
+        case MF_INT32: SHARED_MFIELD_SET(Int32, int32_t, field, num, src, adopt); break;
+        case MF_UINT32: SHARED_MFIELD_SET(UInt32, uint32_t, field, num, src, adopt); break;
+        case MF_SHORT: SHARED_MFIELD_SET(Short, short, field, num, src, adopt); break;
+        case MF_USHORT: SHARED_MFIELD_SET(UShort, unsigned short, field, num, src, adopt); break;
+        case MF_VEC2F: SHARED_MFIELD_SET(Vec2f, SbVec2f, field, num, src, adopt); break;
+        case MF_VEC3F: SHARED_MFIELD_SET(Vec3f, SbVec3f, field, num, src, adopt); break;
+        case MF_VEC4F: SHARED_MFIELD_SET(Vec4f, SbVec4f, field, num, src, adopt); break;
+        case MF_COLOR: SHARED_MFIELD_SET(Color, SbColor, field, num, src, adopt); break;
+        case SF_IMAGE:
+            {
+                SbVec2s imgSize((short) entry.width, (short) entry.height);
+                #ifdef __COIN__
+                if (adopt)
+                {
+                    ((SoSFImage*) field)->setValue(imgSize, entry.components, (const unsigned char*) src, SoSFImage::NO_COPY);
+                    adopted[entry.node] = true;
+                    continue;
+                }
+                #endif
+                ((SoSFImage*) field)->setValue(imgSize, entry.components, (const unsigned char*) src);
+            }
+            continue;
+        }
+
+        #if defined(__COIN__) || defined(TGS_VERSION)
+        if (adopt) adopted[entry.node] = true;
+        #endif
+    }
+
+    // every node referencing the block keeps the buffer exported while it
+    // exists, which also prevents the SharedMemory instance from being
+    // closed underneath it, even if the node outlives the root
+    for (int i = 0; i < numNodes; ++i)
+    {
+        if (adopted[i])
+        {
+            PySceneObject::keepAlive(nodes[i], memoryView);
+        }
+    }
+    delete [] nodes;
+    Py_DECREF(memoryView);
+
+    PyObject *result = PySceneObject::createWrapper(root);
+    root->unrefNoDelete();
+
+    return result;
+}
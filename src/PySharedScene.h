@@ -0,0 +1,59 @@
+/**
+ * \file
+ * \brief      PySharedScene class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+
+class SoField;
+class SoNode;
+
+
+class PySharedScene
+{
+public:
+	// module functions
+	static PyObject* export_shared(PyObject *self, PyObject *args, PyObject *kwds);
+	static PyObject* import_shared(PyObject *self, PyObject *args, PyObject *kwds);
+
+private:
+	enum FieldKind
+	{
+		MF_FLOAT,
+		MF_INT32,
+		MF_UINT32,
+		MF_SHORT,
+		MF_USHORT,
+		MF_VEC2F,
+		MF_VEC3F,
+		MF_VEC4F,
+		MF_COLOR,
+		SF_IMAGE,
+		UNSUPPORTED
+	};
+
+	// entry in skeleton table describing one field stored in shared block
+	typedef struct
+	{
+		uint32_t node;
+		uint32_t kind;
+		uint64_t offset;
+		uint64_t count;
+		int32_t width, height, components;
+		char field[52];
+	} FieldEntry;
+
+	// internal
+	static FieldKind getFieldKind(SoField *field, size_t &elementSize_out);
+	static void collectNodes(SoNode *root, SoNode **&nodes_out, int &numNodes_out);
+};
+
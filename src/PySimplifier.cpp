@@ -0,0 +1,553 @@
+/**
+ * \file
+ * \brief      PySimplifier class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/nodes/SoLevelOfDetail.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoMaterialBinding.h>
+#include <Inventor/nodes/SoShapeHints.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+#include "PySimplifier.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <map>
+#include <thread>
+#include <cstring>
+#include <cmath>
+
+#pragma warning ( disable : 4127 ) // conditional expression is constant in Py_DECREF
+
+
+// meshes below this size are decimated on the calling thread only
+static const size_t THREAD_MIN_TRIANGLES = 16384;
+
+// screen pixels per triangle at which a level is replaced by the next coarser one
+static const float PIXELS_PER_TRIANGLE = 4.f;
+
+// weight of planes that keep open borders in place
+static const double BOUNDARY_WEIGHT = 1000.;
+
+// minimum cosine between face normals before and after a collapse
+static const double MIN_NORMAL_COSINE = 0.2;
+
+
+// orders positions bitwise when welding, only equality matters
+struct ComparePosition
+{
+	bool operator()(const SbVec3f &a, const SbVec3f &b) const { return memcmp(a.getValue(), b.getValue(), sizeof(float) * 3) < 0; }
+};
+
+
+// orders collapses so that the priority queue returns the cheapest first
+struct CompareCollapse
+{
+	bool operator()(const PySimplifier::Collapse &a, const PySimplifier::Collapse &b) const { return a.cost > b.cost; }
+};
+
+
+static void cross(const double *a, const double *b, double *result)
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+
+static double dot(const double *a, const double *b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+
+static void faceNormal(const double *p0, const double *p1, const double *p2, double *normal)
+{
+	double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	cross(e1, e2, normal);
+}
+
+
+static void addPlane(PySimplifier::Quadric &q, const double *n, double d, double weight)
+{
+	// upper triangle of (n, d) * (n, d)^T
+	q.a[0] += weight * n[0] * n[0]; q.a[1] += weight * n[0] * n[1]; q.a[2] += weight * n[0] * n[2]; q.a[3] += weight * n[0] * d;
+	q.a[4] += weight * n[1] * n[1]; q.a[5] += weight * n[1] * n[2]; q.a[6] += weight * n[1] * d;
+	q.a[7] += weight * n[2] * n[2]; q.a[8] += weight * n[2] * d;
+	q.a[9] += weight * d * d;
+}
+
+
+static double evaluate(const PySimplifier::Quadric &q, const double *p)
+{
+	const double *a = q.a;
+	return a[0] * p[0] * p[0] + 2. * a[1] * p[0] * p[1] + 2. * a[2] * p[0] * p[2] + 2. * a[3] * p[0] +
+		a[4] * p[1] * p[1] + 2. * a[5] * p[1] * p[2] + 2. * a[6] * p[1] +
+		a[7] * p[2] * p[2] + 2. * a[8] * p[2] + a[9];
+}
+
+
+static PySimplifier::Collapse makeCollapse(int32_t v1, int32_t v2, const std::vector<double> &positions, const std::vector<PySimplifier::Quadric> &quadrics, const std::vector<uint32_t> &stamps)
+{
+	PySimplifier::Collapse c;
+	c.v1 = v1;
+	c.v2 = v2;
+	c.stamp1 = stamps[v1];
+	c.stamp2 = stamps[v2];
+
+	PySimplifier::Quadric q;
+	for (int i = 0; i < 10; ++i) q.a[i] = quadrics[v1].a[i] + quadrics[v2].a[i];
+
+	// position with minimal error solves the 3x3 system of the quadric
+	const double *a = q.a;
+	double det = a[0] * (a[4] * a[7] - a[5] * a[5]) - a[1] * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * a[5] - a[4] * a[2]);
+	double trace = a[0] + a[4] + a[7];
+	if (fabs(det) > 1e-9 * trace * trace * trace)
+	{
+		double b[3] = { -a[3], -a[6], -a[8] };
+		c.position[0] = (b[0] * (a[4] * a[7] - a[5] * a[5]) - a[1] * (b[1] * a[7] - a[5] * b[2]) + a[2] * (b[1] * a[5] - a[4] * b[2])) / det;
+		c.position[1] = (a[0] * (b[1] * a[7] - a[5] * b[2]) - b[0] * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * b[2] - b[1] * a[2])) / det;
+		c.position[2] = (a[0] * (a[4] * b[2] - b[1] * a[5]) - a[1] * (a[1] * b[2] - b[1] * a[2]) + b[0] * (a[1] * a[5] - a[4] * a[2])) / det;
+		c.cost = evaluate(q, c.position);
+	}
+	else
+	{
+		// singular for flat or straight regions, pick best of end points and midpoint
+		const double *p1 = &positions[v1 * 3];
+		const double *p2 = &positions[v2 * 3];
+		double mid[3] = { (p1[0] + p2[0]) * 0.5, (p1[1] + p2[1]) * 0.5, (p1[2] + p2[2]) * 0.5 };
+		const double *candidates[3] = { p1, p2, mid };
+		c.cost = -1.;
+		for (int i = 0; i < 3; ++i)
+		{
+			double cost = evaluate(q, candidates[i]);
+			if ((c.cost < 0.) || (cost < c.cost))
+			{
+				c.cost = cost;
+				memcpy(c.position, candidates[i], sizeof(c.position));
+			}
+		}
+	}
+
+	return c;
+}
+
+
+static bool flips(int32_t v, int32_t other, const double *position, const std::vector<double> &positions, const std::vector<int32_t> &triangles, const std::vector<int32_t> &vertexTriangles, const std::vector<char> &removed)
+{
+	// moving v must not turn any remaining face around
+	for (size_t i = 0; i < vertexTriangles.size(); ++i)
+	{
+		int32_t t = vertexTriangles[i];
+		if (removed[t]) continue;
+
+		const int32_t *tri = &triangles[t * 3];
+		if ((tri[0] == other) || (tri[1] == other) || (tri[2] == other)) continue;
+
+		const double *p[3], *moved[3];
+		for (int j = 0; j < 3; ++j)
+		{
+			p[j] = &positions[tri[j] * 3];
+			moved[j] = (tri[j] == v) ? position : p[j];
+		}
+
+		double before[3], after[3];
+		faceNormal(p[0], p[1], p[2], before);
+		faceNormal(moved[0], moved[1], moved[2], after);
+		double lengths = sqrt(dot(before, before) * dot(after, after));
+		if ((lengths == 0.) || (dot(before, after) < MIN_NORMAL_COSINE * lengths))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void PySimplifier::weld(const PyGeometry::TriangleSoup &soup, Mesh &mesh_out)
+{
+	// edge collapses need connectivity, so corners at the same position are merged
+	std::map<SbVec3f, int32_t, ComparePosition> vertexMap;
+	size_t numTriangles = soup.shapeIds.size();
+	mesh_out.triangles.reserve(numTriangles * 3);
+	mesh_out.materialIds.reserve(numTriangles);
+
+	for (size_t i = 0; i < numTriangles; ++i)
+	{
+		int32_t tri[3];
+		for (size_t j = 0; j < 3; ++j)
+		{
+			SbVec3f v(&soup.vertices[(i * 3 + j) * 3]);
+			std::map<SbVec3f, int32_t, ComparePosition>::iterator it = vertexMap.find(v);
+			if (it == vertexMap.end())
+			{
+				tri[j] = (int32_t) mesh_out.vertices.size();
+				vertexMap[v] = tri[j];
+				mesh_out.vertices.push_back(v);
+			}
+			else
+			{
+				tri[j] = it->second;
+			}
+		}
+
+		if ((tri[0] != tri[1]) && (tri[1] != tri[2]) && (tri[0] != tri[2]))
+		{
+			mesh_out.triangles.insert(mesh_out.triangles.end(), tri, tri + 3);
+			mesh_out.materialIds.push_back(soup.materialIds[i]);
+		}
+	}
+}
+
+
+void PySimplifier::decimate(const Mesh *mesh, size_t targetTriangles, Mesh *result_out)
+{
+	// quadric error metric decimation, see Garland and Heckbert:
+	// "Surface Simplification Using Quadric Error Metrics"
+	size_t numVertices = mesh->vertices.size();
+	size_t numTriangles = mesh->triangles.size() / 3;
+
+	std::vector<double> positions(numVertices * 3);
+	for (size_t i = 0; i < numVertices; ++i)
+	{
+		for (int j = 0; j < 3; ++j) positions[i * 3 + j] = mesh->vertices[i][j];
+	}
+
+	std::vector<int32_t> triangles(mesh->triangles);
+	std::vector<char> removedTriangles(numTriangles, 0), removedVertices(numVertices, 0);
+	std::vector<uint32_t> stamps(numVertices, 0);
+	std::vector<std::vector<int32_t> > vertexTriangles(numVertices);
+	Quadric zero;
+	memset(&zero, 0, sizeof(Quadric));
+	std::vector<Quadric> quadrics(numVertices, zero);
+
+	// area weighted plane of every face, edges are counted to find open borders
+	std::map<std::pair<int32_t, int32_t>, int32_t> edges;
+	for (size_t t = 0; t < numTriangles; ++t)
+	{
+		const int32_t *tri = &triangles[t * 3];
+		double n[3];
+		faceNormal(&positions[tri[0] * 3], &positions[tri[1] * 3], &positions[tri[2] * 3], n);
+		double length = sqrt(dot(n, n));
+		if (length > 0.)
+		{
+			n[0] /= length; n[1] /= length; n[2] /= length;
+			double d = -dot(n, &positions[tri[0] * 3]);
+			for (int j = 0; j < 3; ++j) addPlane(quadrics[tri[j]], n, d, length * 0.5);
+		}
+
+		for (int j = 0; j < 3; ++j)
+		{
+			vertexTriangles[tri[j]].push_back((int32_t) t);
+			std::pair<int32_t, int32_t> edge(std::min(tri[j], tri[(j + 1) % 3]), std::max(tri[j], tri[(j + 1) % 3]));
+			edges[edge]++;
+		}
+	}
+
+	// borders get a plane perpendicular to their face so they don't shrink
+	for (size_t t = 0; t < numTriangles; ++t)
+	{
+		const int32_t *tri = &triangles[t * 3];
+		double n[3];
+		faceNormal(&positions[tri[0] * 3], &positions[tri[1] * 3], &positions[tri[2] * 3], n);
+		for (int j = 0; j < 3; ++j)
+		{
+			int32_t a = tri[j], b = tri[(j + 1) % 3];
+			if (edges[std::pair<int32_t, int32_t>(std::min(a, b), std::max(a, b))] != 1) continue;
+
+			double e[3] = { positions[b * 3] - positions[a * 3], positions[b * 3 + 1] - positions[a * 3 + 1], positions[b * 3 + 2] - positions[a * 3 + 2] };
+			double bn[3];
+			cross(e, n, bn);
+			double length = sqrt(dot(bn, bn));
+			if (length > 0.)
+			{
+				bn[0] /= length; bn[1] /= length; bn[2] /= length;
+				double d = -dot(bn, &positions[a * 3]);
+				addPlane(quadrics[a], bn, d, BOUNDARY_WEIGHT * dot(e, e));
+				addPlane(quadrics[b], bn, d, BOUNDARY_WEIGHT * dot(e, e));
+			}
+		}
+	}
+
+	std::priority_queue<Collapse, std::vector<Collapse>, CompareCollapse> queue;
+	for (std::map<std::pair<int32_t, int32_t>, int32_t>::iterator it = edges.begin(); it != edges.end(); ++it)
+	{
+		queue.push(makeCollapse(it->first.first, it->first.second, positions, quadrics, stamps));
+	}
+	edges.clear();
+
+	size_t remaining = numTriangles;
+	std::vector<int32_t> neighbors;
+	while ((remaining > targetTriangles) && !queue.empty())
+	{
+		Collapse c = queue.top();
+		queue.pop();
+
+		if (removedVertices[c.v1] || removedVertices[c.v2] || (stamps[c.v1] != c.stamp1) || (stamps[c.v2] != c.stamp2)) continue;
+		if (flips(c.v1, c.v2, c.position, positions, triangles, vertexTriangles[c.v1], removedTriangles) ||
+			flips(c.v2, c.v1, c.position, positions, triangles, vertexTriangles[c.v2], removedTriangles)) continue;
+
+		// v2 is merged into v1
+		memcpy(&positions[c.v1 * 3], c.position, sizeof(c.position));
+		for (int i = 0; i < 10; ++i) quadrics[c.v1].a[i] += quadrics[c.v2].a[i];
+		removedVertices[c.v2] = 1;
+		stamps[c.v1]++;
+
+		std::vector<int32_t> &v1Triangles = vertexTriangles[c.v1];
+		std::vector<int32_t> &v2Triangles = vertexTriangles[c.v2];
+		for (size_t i = 0; i < v2Triangles.size(); ++i)
+		{
+			int32_t t = v2Triangles[i];
+			if (removedTriangles[t]) continue;
+
+			int32_t *tri = &triangles[t * 3];
+			if ((tri[0] == c.v1) || (tri[1] == c.v1) || (tri[2] == c.v1))
+			{
+				removedTriangles[t] = 1;
+				remaining--;
+			}
+			else
+			{
+				for (int j = 0; j < 3; ++j) if (tri[j] == c.v2) tri[j] = c.v1;
+				v1Triangles.push_back(t);
+			}
+		}
+		std::vector<int32_t>().swap(v2Triangles);
+
+		// drop collapsed faces and queue the edges around the new vertex
+		neighbors.clear();
+		size_t kept = 0;
+		for (size_t i = 0; i < v1Triangles.size(); ++i)
+		{
+			int32_t t = v1Triangles[i];
+			if (removedTriangles[t]) continue;
+			v1Triangles[kept++] = t;
+			for (int j = 0; j < 3; ++j)
+			{
+				if (triangles[t * 3 + j] != c.v1) neighbors.push_back(triangles[t * 3 + j]);
+			}
+		}
+		v1Triangles.resize(kept);
+
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		for (size_t i = 0; i < neighbors.size(); ++i)
+		{
+			queue.push(makeCollapse(c.v1, neighbors[i], positions, quadrics, stamps));
+		}
+	}
+
+	// compact remaining vertices and faces
+	std::vector<int32_t> newIndex(numVertices, -1);
+	result_out->triangles.reserve(remaining * 3);
+	result_out->materialIds.reserve(remaining);
+	for (size_t t = 0; t < numTriangles; ++t)
+	{
+		if (removedTriangles[t]) continue;
+		for (int j = 0; j < 3; ++j)
+		{
+			int32_t v = triangles[t * 3 + j];
+			if (newIndex[v] < 0)
+			{
+				newIndex[v] = (int32_t) result_out->vertices.size();
+				result_out->vertices.push_back(SbVec3f((float) positions[v * 3], (float) positions[v * 3 + 1], (float) positions[v * 3 + 2]));
+			}
+			result_out->triangles.push_back(newIndex[v]);
+		}
+		result_out->materialIds.push_back(mesh->materialIds[t]);
+	}
+}
+
+
+SoSeparator *PySimplifier::createLevel(const Mesh &mesh, SoNode *hints, SoNode *material, SoNode *binding)
+{
+	SoSeparator *level = new SoSeparator();
+	level->addChild(hints);
+	level->addChild(material);
+	if (binding) level->addChild(binding);
+
+	SoVertexProperty *vertexProperty = new SoVertexProperty();
+	if (!mesh.vertices.empty())
+	{
+		vertexProperty->vertex.setValues(0, (int) mesh.vertices.size(), &mesh.vertices[0]);
+	}
+
+	SoIndexedFaceSet *faceSet = new SoIndexedFaceSet();
+	size_t numTriangles = mesh.triangles.size() / 3;
+	faceSet->coordIndex.setNum((int) numTriangles * 4);
+	int32_t *coordIndex = faceSet->coordIndex.startEditing();
+	for (size_t i = 0; i < numTriangles; ++i)
+	{
+		memcpy(coordIndex + i * 4, &mesh.triangles[i * 3], sizeof(int32_t) * 3);
+		coordIndex[i * 4 + 3] = -1;
+	}
+	faceSet->coordIndex.finishEditing();
+
+	if (binding && numTriangles)
+	{
+		faceSet->materialIndex.setValues(0, (int) numTriangles, &mesh.materialIds[0]);
+	}
+
+	faceSet->vertexProperty = vertexProperty;
+	level->addChild(faceSet);
+
+	return level;
+}
+
+
+PyObject* PySimplifier::simplify(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+	PyObject *nodeObj = NULL, *ratiosObj = NULL, *screenAreasObj = NULL;
+
+	static char *kwlist[] = { "node", "ratios", "screen_areas", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO", kwlist, &nodeObj, &ratiosObj, &screenAreasObj))
+	{
+		return NULL;
+	}
+
+	SoNode *node = PyNode_Check(nodeObj) ? (SoNode *) ((PySceneObject::Object *) nodeObj)->inventorObject : NULL;
+	if (!node)
+	{
+		PyErr_SetString(PyExc_TypeError, "First argument must be a node");
+		return NULL;
+	}
+
+	std::vector<float> ratios, screenAreas;
+	if (ratiosObj)
+	{
+		PyObject *seq = PySequence_Check(ratiosObj) ? PySequence_Fast(ratiosObj, "") : NULL;
+		for (Py_ssize_t i = 0; seq && (i < PySequence_Fast_GET_SIZE(seq)); ++i)
+		{
+			ratios.push_back((float) PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, i)));
+		}
+		Py_XDECREF(seq);
+	}
+	else
+	{
+		ratios.push_back(0.5f);
+		ratios.push_back(0.1f);
+		ratios.push_back(0.01f);
+	}
+
+	if (PyErr_Occurred() || ratios.empty() || (*std::min_element(ratios.begin(), ratios.end()) <= 0.f) || (*std::max_element(ratios.begin(), ratios.end()) > 1.f))
+	{
+		PyErr_SetString(PyExc_ValueError, "Ratios must be a sequence of values in the range (0, 1]");
+		return NULL;
+	}
+
+	// default screen areas are derived from the next finer level
+	for (size_t i = 1; i < ratios.size(); ++i)
+	{
+		if (ratios[i] >= ratios[i - 1])
+		{
+			PyErr_SetString(PyExc_ValueError, "Ratios must be decreasing");
+			return NULL;
+		}
+	}
+
+	if (screenAreasObj && (screenAreasObj != Py_None))
+	{
+		PyObject *seq = PySequence_Check(screenAreasObj) ? PySequence_Fast(screenAreasObj, "") : NULL;
+		for (Py_ssize_t i = 0; seq && (i < PySequence_Fast_GET_SIZE(seq)); ++i)
+		{
+			screenAreas.push_back((float) PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, i)));
+		}
+		Py_XDECREF(seq);
+
+		if (PyErr_Occurred() || (screenAreas.size() != ratios.size()))
+		{
+			PyErr_SetString(PyExc_ValueError, "Screen areas must be a sequence with one value per ratio");
+			return NULL;
+		}
+
+		// LevelOfDetail picks the first child whose area is exceeded
+		for (size_t i = 1; i < screenAreas.size(); ++i)
+		{
+			if (screenAreas[i] >= screenAreas[i - 1])
+			{
+				PyErr_SetString(PyExc_ValueError, "Screen areas must be decreasing");
+				return NULL;
+			}
+		}
+	}
+
+	PyGeometry::TriangleSoup soup(false, true);
+	PyGeometry::extractTriangles(nodeObj, soup);
+
+	Mesh mesh;
+	weld(soup, mesh);
+	size_t numTriangles = mesh.triangles.size() / 3;
+
+	// levels are independent, so each one is decimated from the full mesh on its own thread
+	std::vector<Mesh> levels(ratios.size());
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < ratios.size(); ++i)
+	{
+		size_t target = (size_t) (ratios[i] * numTriangles);
+		if ((i > 0) && (numTriangles >= THREAD_MIN_TRIANGLES))
+		{
+			workers.push_back(std::thread(&PySimplifier::decimate, &mesh, target, &levels[i]));
+		}
+		else if (i > 0)
+		{
+			decimate(&mesh, target, &levels[i]);
+		}
+	}
+	decimate(&mesh, (size_t) (ratios[0] * numTriangles), &levels[0]);
+
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i].join();
+	}
+
+	// materials are shared by all levels, bound per face if there are several
+	SoMaterial *material = new SoMaterial();
+	SoMaterialBinding *binding = NULL;
+	for (size_t i = 0; i < soup.materials.size(); ++i)
+	{
+		const PyGeometry::Material &m = soup.materials[i];
+		material->ambientColor.set1Value((int) i, SbColor(m.ambient));
+		material->diffuseColor.set1Value((int) i, SbColor(m.diffuse));
+		material->specularColor.set1Value((int) i, SbColor(m.specular));
+		material->emissiveColor.set1Value((int) i, SbColor(m.emissive));
+		material->shininess.set1Value((int) i, m.shininess);
+		material->transparency.set1Value((int) i, m.transparency);
+	}
+	if (soup.materials.size() > 1)
+	{
+		binding = new SoMaterialBinding();
+		binding->value = SoMaterialBinding::PER_FACE_INDEXED;
+	}
+
+	SoShapeHints *hints = new SoShapeHints();
+	hints->creaseAngle = 0.5f;
+
+	SoLevelOfDetail *lod = new SoLevelOfDetail();
+	lod->ref();
+	lod->addChild(node);
+
+	// a level is shown while each of its triangles covers enough pixels
+	size_t previous = numTriangles;
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		lod->addChild(createLevel(levels[i], hints, material, binding));
+		lod->screenArea.set1Value((int) i, screenAreas.empty() ? previous * PIXELS_PER_TRIANGLE : screenAreas[i]);
+		previous = levels[i].triangles.size() / 3;
+	}
+
+	PyObject *result = PySceneObject::createWrapper(lod);
+	lod->unref();
+
+	return result;
+}
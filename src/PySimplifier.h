@@ -0,0 +1,58 @@
+/**
+ * \file
+ * \brief      PySimplifier class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include "PySceneObject.h"
+#include "PyGeometry.h"
+#include <vector>
+
+class SoNode;
+class SoSeparator;
+
+
+class PySimplifier
+{
+public:
+	// module functions
+	static PyObject* simplify(PyObject *self, PyObject *args, PyObject *kwds);
+
+	// indexed triangle mesh with one material id per triangle
+	struct Mesh
+	{
+		std::vector<SbVec3f> vertices;
+		std::vector<int32_t> triangles;
+		std::vector<int32_t> materialIds;
+	};
+
+	// symmetric 4x4 matrix measuring squared distance to a set of planes
+	struct Quadric
+	{
+		double a[10];
+	};
+
+	// candidate edge collapse, outdated when the stamp of a vertex changed
+	struct Collapse
+	{
+		double cost;
+		double position[3];
+		int32_t v1, v2;
+		uint32_t stamp1, stamp2;
+	};
+
+private:
+	// internal
+	static void weld(const PyGeometry::TriangleSoup &soup, Mesh &mesh_out);
+	static void decimate(const Mesh *mesh, size_t targetTriangles, Mesh *result_out);
+	static SoSeparator *createLevel(const Mesh &mesh, SoNode *hints, SoNode *material, SoNode *binding);
+};
+
@@ -0,0 +1,809 @@
+/**
+ * \file
+ * \brief      SoExpressionEngine class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#include <Inventor/errors/SoError.h>
+#include "SoExpressionEngine.h"
+#include <math.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <algorithm>
+
+
+// number of elements each instruction processes at once
+static const int BATCH_SIZE = 256;
+
+// minimum number of elements per worker thread
+static const int THREAD_CHUNK_SIZE = 32768;
+
+// number of inputs (a-h, A-H) and outputs (oa-od, oA-oD)
+static const int NUM_INPUTS = 16;
+static const int NUM_OUTPUTS = 8;
+
+
+enum Opcode
+{
+	// data transfer: LOAD dst <- input a component b, STORE output b component c <- a
+	OP_LOAD, OP_STORE,
+
+	// unary
+	OP_NEG, OP_NOT, OP_SIN, OP_COS, OP_TAN, OP_ASIN, OP_ACOS, OP_ATAN, OP_SINH, OP_COSH, OP_TANH,
+	OP_SQRT, OP_EXP, OP_LOG, OP_LOG10, OP_ABS, OP_FLOOR, OP_CEIL,
+
+	// binary
+	OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW, OP_ATAN2, OP_MIN, OP_MAX,
+	OP_LT, OP_GT, OP_LE, OP_GE, OP_EQ, OP_NE, OP_AND, OP_OR,
+
+	// ternary
+	OP_SELECT, OP_CLAMP, OP_MIX
+};
+
+
+typedef struct
+{
+	int op, dst, a, b, c;
+} Instruction;
+
+
+// compiled expression, all registers are arrays of BATCH_SIZE floats
+struct SoExpressionEngine::Program
+{
+	std::vector<Instruction> code;
+	std::vector<std::pair<int, float> > constants;
+	int numSlots;
+	unsigned int usedInputs, assignedOutputs;
+
+	Program() : numSlots(0), usedInputs(0), assignedOutputs(0) {}
+
+	void run(const float * const *inputData, const int *inputNum, float * const *outputData, int start, int end) const;
+};
+
+
+// macros for element-wise kernels that compilers can vectorize
+#define EXPR_UNARY(op, expr) \
+	case op: { float *rd = R(ins.dst); const float *ra = R(ins.a); \
+		for (int i = 0; i < n; ++i) { const float x = ra[i]; rd[i] = (expr); } } break;
+
+#define EXPR_BINARY(op, expr) \
+	case op: { float *rd = R(ins.dst); const float *ra = R(ins.a), *rb = R(ins.b); \
+		for (int i = 0; i < n; ++i) { const float x = ra[i], y = rb[i]; rd[i] = (expr); } } break;
+
+#define EXPR_TERNARY(op, expr) \
+	case op: { float *rd = R(ins.dst); const float *ra = R(ins.a), *rb = R(ins.b), *rc = R(ins.c); \
+		for (int i = 0; i < n; ++i) { const float x = ra[i], y = rb[i], z = rc[i]; rd[i] = (expr); } } break;
+
+
+void SoExpressionEngine::Program::run(const float * const *inputData, const int *inputNum, float * const *outputData, int start, int end) const
+{
+	std::vector<float> regs(numSlots * BATCH_SIZE);
+	#define R(slot) (&regs[(slot) * BATCH_SIZE])
+
+	for (size_t i = 0; i < constants.size(); ++i)
+	{
+		std::fill(R(constants[i].first), R(constants[i].first) + BATCH_SIZE, constants[i].second);
+	}
+
+	for (int first = start; first < end; first += BATCH_SIZE)
+	{
+		const int n = std::min(BATCH_SIZE, end - first);
+
+		for (size_t k = 0; k < code.size(); ++k)
+		{
+			const Instruction &ins = code[k];
+			switch (ins.op)
+			{
+			case OP_LOAD:
+				{
+					// shorter inputs repeat their last value, empty inputs read as zero
+					float *rd = R(ins.dst);
+					const int width = (ins.a < 8) ? 1 : 3;
+					const int num = inputNum[ins.a];
+					const float *src = inputData[ins.a] + ins.b;
+					if (first + n <= num)
+					{
+						for (int i = 0; i < n; ++i) rd[i] = src[(first + i) * width];
+					}
+					else
+					{
+						for (int i = 0; i < n; ++i) rd[i] = num ? src[std::min(first + i, num - 1) * width] : 0.f;
+					}
+				}
+				break;
+			case OP_STORE:
+				{
+					const float *ra = R(ins.a);
+					const int width = (ins.b < 4) ? 1 : 3;
+					float *dst = outputData[ins.b] + ins.c;
+					for (int i = 0; i < n; ++i) dst[(first + i) * width] = ra[i];
+				}
+				break;
+
+			EXPR_UNARY(OP_NEG, -x)
+			EXPR_UNARY(OP_NOT, (x == 0.f) ? 1.f : 0.f)
+			EXPR_UNARY(OP_SIN, sinf(x))
+			EXPR_UNARY(OP_COS, cosf(x))
+			EXPR_UNARY(OP_TAN, tanf(x))
+			EXPR_UNARY(OP_ASIN, asinf(x))
+			EXPR_UNARY(OP_ACOS, acosf(x))
+			EXPR_UNARY(OP_ATAN, atanf(x))
+			EXPR_UNARY(OP_SINH, sinhf(x))
+			EXPR_UNARY(OP_COSH, coshf(x))
+			EXPR_UNARY(OP_TANH, tanhf(x))
+			EXPR_UNARY(OP_SQRT, sqrtf(x))
+			EXPR_UNARY(OP_EXP, expf(x))
+			EXPR_UNARY(OP_LOG, logf(x))
+			EXPR_UNARY(OP_LOG10, log10f(x))
+			EXPR_UNARY(OP_ABS, fabsf(x))
+			EXPR_UNARY(OP_FLOOR, floorf(x))
+			EXPR_UNARY(OP_CEIL, ceilf(x))
+
+			EXPR_BINARY(OP_ADD, x + y)
+			EXPR_BINARY(OP_SUB, x - y)
+			EXPR_BINARY(OP_MUL, x * y)
+			EXPR_BINARY(OP_DIV, x / y)
+			EXPR_BINARY(OP_MOD, fmodf(x, y))
+			EXPR_BINARY(OP_POW, powf(x, y))
+			EXPR_BINARY(OP_ATAN2, atan2f(x, y))
+			EXPR_BINARY(OP_MIN, (y < x) ? y : x)
+			EXPR_BINARY(OP_MAX, (x < y) ? y : x)
+			EXPR_BINARY(OP_LT, (x < y) ? 1.f : 0.f)
+			EXPR_BINARY(OP_GT, (x > y) ? 1.f : 0.f)
+			EXPR_BINARY(OP_LE, (x <= y) ? 1.f : 0.f)
+			EXPR_BINARY(OP_GE, (x >= y) ? 1.f : 0.f)
+			EXPR_BINARY(OP_EQ, (x == y) ? 1.f : 0.f)
+			EXPR_BINARY(OP_NE, (x != y) ? 1.f : 0.f)
+			EXPR_BINARY(OP_AND, ((x != 0.f) && (y != 0.f)) ? 1.f : 0.f)
+			EXPR_BINARY(OP_OR, ((x != 0.f) || (y != 0.f)) ? 1.f : 0.f)
+
+			EXPR_TERNARY(OP_SELECT, (x != 0.f) ? y : z)
+			EXPR_TERNARY(OP_CLAMP, (x < y) ? y : ((z < x) ? z : x))
+			EXPR_TERNARY(OP_MIX, x + (y - x) * z)
+			}
+		}
+	}
+
+	#undef R
+}
+
+
+// recursive descent parser that generates register code while parsing
+class ExpressionCompiler
+{
+public:
+	ExpressionCompiler(SoExpressionEngine::Program &program) : prog(program), pos(0), failed(false)
+	{
+		for (int i = 0; i < NUM_INPUTS; ++i) inputs[i].width = 0;
+	}
+
+	bool compile(const char *text)
+	{
+		pos = text;
+		while (!failed)
+		{
+			skipSpace();
+			if (*pos == ';') { pos++; continue; }
+			if (!*pos) break;
+			statement();
+		}
+
+		return !failed;
+	}
+
+	SbString error;
+
+private:
+	typedef struct
+	{
+		int width;
+		int slot[3];
+	} Value;
+
+	Value fail(const char *message)
+	{
+		if (!failed)
+		{
+			error.sprintf("%s at '%.20s'", message, pos);
+			failed = true;
+		}
+		return constant(0.f);
+	}
+
+	void skipSpace()
+	{
+		while (*pos && strchr(" \t\r\n", *pos)) pos++;
+	}
+
+	bool accept(const char *token)
+	{
+		skipSpace();
+		size_t len = strlen(token);
+		if (strncmp(pos, token, len) != 0) return false;
+
+		// do not match '<', '>' or '!' as prefix of '<=', '>=' or '!='
+		if ((len == 1) && strchr("<>!", token[0]) && (pos[1] == '=')) return false;
+
+		pos += len;
+		return true;
+	}
+
+	bool identifier(std::string &name)
+	{
+		skipSpace();
+		if (!isalpha((unsigned char) *pos) && (*pos != '_')) return false;
+		const char *begin = pos;
+		while (isalnum((unsigned char) *pos) || (*pos == '_')) pos++;
+		name.assign(begin, pos - begin);
+		return true;
+	}
+
+	int newSlot()
+	{
+		return prog.numSlots++;
+	}
+
+	void emit(int op, int dst, int a, int b = 0, int c = 0)
+	{
+		Instruction ins = { op, dst, a, b, c };
+		prog.code.push_back(ins);
+	}
+
+	Value scalar(int slot)
+	{
+		Value v = { 1, { slot, slot, slot } };
+		return v;
+	}
+
+	Value constant(float value)
+	{
+		std::map<float, int>::iterator it = constantSlots.find(value);
+		if (it == constantSlots.end())
+		{
+			it = constantSlots.insert(std::make_pair(value, newSlot())).first;
+			prog.constants.push_back(std::make_pair(it->second, value));
+		}
+		return scalar(it->second);
+	}
+
+	Value result(Value r)
+	{
+		// scalars keep their slot in all components so they can be broadcast
+		if (r.width == 1) r.slot[1] = r.slot[2] = r.slot[0];
+		return r;
+	}
+
+	bool broadcast(Value &v, int width)
+	{
+		if (v.width == width) return true;
+		if (v.width == 1)
+		{
+			v.width = width;
+			return true;
+		}
+		return false;
+	}
+
+	Value apply(int op, Value x)
+	{
+		Value r = x;
+		for (int k = 0; k < x.width; ++k)
+		{
+			r.slot[k] = newSlot();
+			emit(op, r.slot[k], x.slot[k]);
+		}
+		return result(r);
+	}
+
+	Value apply(int op, Value x, Value y)
+	{
+		int width = std::max(x.width, y.width);
+		if (!broadcast(x, width) || !broadcast(y, width)) return fail("Operand types do not match");
+
+		Value r = x;
+		for (int k = 0; k < width; ++k)
+		{
+			r.slot[k] = newSlot();
+			emit(op, r.slot[k], x.slot[k], y.slot[k]);
+		}
+		return result(r);
+	}
+
+	Value apply(int op, Value x, Value y, Value z)
+	{
+		int width = std::max(x.width, std::max(y.width, z.width));
+		if (!broadcast(x, width) || !broadcast(y, width) || !broadcast(z, width)) return fail("Operand types do not match");
+
+		Value r = x;
+		for (int k = 0; k < width; ++k)
+		{
+			r.slot[k] = newSlot();
+			emit(op, r.slot[k], x.slot[k], y.slot[k], z.slot[k]);
+		}
+		return result(r);
+	}
+
+	Value dot(Value x, Value y)
+	{
+		if ((x.width != 3) || (y.width != 3)) return fail("Function expects vector arguments");
+		Value r = apply(OP_MUL, scalar(x.slot[0]), scalar(y.slot[0]));
+		r = apply(OP_ADD, r, apply(OP_MUL, scalar(x.slot[1]), scalar(y.slot[1])));
+		return apply(OP_ADD, r, apply(OP_MUL, scalar(x.slot[2]), scalar(y.slot[2])));
+	}
+
+	Value cross(Value x, Value y)
+	{
+		if ((x.width != 3) || (y.width != 3)) return fail("Function expects vector arguments");
+		Value r = x;
+		for (int k = 0; k < 3; ++k)
+		{
+			int i = (k + 1) % 3, j = (k + 2) % 3;
+			r.slot[k] = apply(OP_SUB,
+				apply(OP_MUL, scalar(x.slot[i]), scalar(y.slot[j])),
+				apply(OP_MUL, scalar(x.slot[j]), scalar(y.slot[i]))).slot[0];
+		}
+		return r;
+	}
+
+	Value variable(const std::string &name)
+	{
+		if ((name.size() == 1) && (name[0] >= 'a') && (name[0] <= 'h'))
+		{
+			return input(name[0] - 'a');
+		}
+		if ((name.size() == 1) && (name[0] >= 'A') && (name[0] <= 'H'))
+		{
+			return input(8 + name[0] - 'A');
+		}
+		if ((name == "pi") || (name == "M_PI")) return constant(3.14159265358979323846f);
+		if (name == "M_E") return constant(2.71828182845904523536f);
+		if (name == "M_SQRT2") return constant(1.41421356237309504880f);
+
+		std::map<std::string, Value>::iterator it = variables.find(name);
+		if (it != variables.end())
+		{
+			return it->second;
+		}
+
+		return fail("Unknown variable");
+	}
+
+	Value input(int index)
+	{
+		// inputs are loaded once when first referenced
+		if (!inputs[index].width)
+		{
+			inputs[index].width = (index < 8) ? 1 : 3;
+			for (int k = 0; k < inputs[index].width; ++k)
+			{
+				inputs[index].slot[k] = newSlot();
+				emit(OP_LOAD, inputs[index].slot[k], index, k);
+			}
+			if (inputs[index].width == 1)
+			{
+				inputs[index].slot[1] = inputs[index].slot[2] = inputs[index].slot[0];
+			}
+			prog.usedInputs |= 1u << index;
+		}
+
+		return inputs[index];
+	}
+
+	Value call(const std::string &name)
+	{
+		static const struct { const char *name; int args, op; } functions[] =
+		{
+			{ "sin", 1, OP_SIN }, { "cos", 1, OP_COS }, { "tan", 1, OP_TAN },
+			{ "asin", 1, OP_ASIN }, { "acos", 1, OP_ACOS }, { "atan", 1, OP_ATAN },
+			{ "sinh", 1, OP_SINH }, { "cosh", 1, OP_COSH }, { "tanh", 1, OP_TANH },
+			{ "sqrt", 1, OP_SQRT }, { "exp", 1, OP_EXP }, { "log", 1, OP_LOG }, { "log10", 1, OP_LOG10 },
+			{ "abs", 1, OP_ABS }, { "fabs", 1, OP_ABS }, { "floor", 1, OP_FLOOR }, { "ceil", 1, OP_CEIL },
+			{ "pow", 2, OP_POW }, { "atan2", 2, OP_ATAN2 }, { "fmod", 2, OP_MOD }, { "mod", 2, OP_MOD },
+			{ "min", 2, OP_MIN }, { "max", 2, OP_MAX },
+			{ "clamp", 3, OP_CLAMP }, { "mix", 3, OP_MIX },
+			{ "dot", 2, -1 }, { "cross", 2, -1 }, { "length", 1, -1 }, { "normalize", 1, -1 },
+			{ "vec3f", 3, -1 }, { "vec3", 3, -1 },
+			{ NULL, 0, 0 }
+		};
+
+		int f = 0;
+		while (functions[f].name && (name != functions[f].name)) f++;
+		if (!functions[f].name) return fail("Unknown function");
+
+		Value args[3];
+		for (int i = 0; i < functions[f].args; ++i)
+		{
+			if ((i > 0) && !accept(",")) return fail("Expected ','");
+			args[i] = expression();
+		}
+		if (!accept(")")) return fail("Expected ')'");
+
+		switch (functions[f].args)
+		{
+		case 1: if (functions[f].op >= 0) return apply(functions[f].op, args[0]); break;
+		case 2: if (functions[f].op >= 0) return apply(functions[f].op, args[0], args[1]); break;
+		case 3: if (functions[f].op >= 0) return apply(functions[f].op, args[0], args[1], args[2]); break;
+		}
+
+		if (name == "dot") return dot(args[0], args[1]);
+		if (name == "cross") return cross(args[0], args[1]);
+		if (name == "length") return apply(OP_SQRT, dot(args[0], args[0]));
+		if (name == "normalize") return apply(OP_DIV, args[0], apply(OP_SQRT, dot(args[0], args[0])));
+
+		// vec3f(x, y, z)
+		for (int i = 0; i < 3; ++i)
+		{
+			if (args[i].width != 1) return fail("Function expects scalar arguments");
+		}
+		Value r = { 3, { args[0].slot[0], args[1].slot[0], args[2].slot[0] } };
+		return r;
+	}
+
+	Value primary()
+	{
+		skipSpace();
+		if (accept("("))
+		{
+			Value v = expression();
+			if (!accept(")")) return fail("Expected ')'");
+			return v;
+		}
+
+		if (isdigit((unsigned char) *pos) || ((*pos == '.') && isdigit((unsigned char) pos[1])))
+		{
+			char *end = NULL;
+			float value = (float) strtod(pos, &end);
+			pos = end;
+			return constant(value);
+		}
+
+		std::string name;
+		if (!identifier(name)) return fail("Expected expression");
+		if (accept("(")) return call(name);
+		return variable(name);
+	}
+
+	Value postfix()
+	{
+		Value v = primary();
+		while (!failed)
+		{
+			int component = -1;
+			if (accept("["))
+			{
+				skipSpace();
+				if ((*pos >= '0') && (*pos <= '2')) component = *pos++ - '0';
+				if ((component < 0) || !accept("]")) return fail("Expected vector index 0, 1 or 2");
+			}
+			else if (accept("."))
+			{
+				skipSpace();
+				const char *names = "xyz";
+				if (*pos && strchr(names, *pos)) component = (int) (strchr(names, *pos++) - names);
+				if (component < 0) return fail("Expected vector component x, y or z");
+			}
+			else
+			{
+				break;
+			}
+
+			if (v.width != 3) return fail("Component access on scalar");
+			v = scalar(v.slot[component]);
+		}
+		return v;
+	}
+
+	Value unary()
+	{
+		if (accept("-")) return apply(OP_NEG, unary());
+		if (accept("!")) return apply(OP_NOT, unary());
+		if (accept("+")) return unary();
+		return postfix();
+	}
+
+	Value multiplicative()
+	{
+		Value v = unary();
+		while (!failed)
+		{
+			if (accept("*")) v = apply(OP_MUL, v, unary());
+			else if (accept("/")) v = apply(OP_DIV, v, unary());
+			else if (accept("%")) v = apply(OP_MOD, v, unary());
+			else break;
+		}
+		return v;
+	}
+
+	Value additive()
+	{
+		Value v = multiplicative();
+		while (!failed)
+		{
+			if (accept("+")) v = apply(OP_ADD, v, multiplicative());
+			else if (accept("-")) v = apply(OP_SUB, v, multiplicative());
+			else break;
+		}
+		return v;
+	}
+
+	Value comparison()
+	{
+		Value v = additive();
+		if (accept("<=")) return apply(OP_LE, v, additive());
+		if (accept(">=")) return apply(OP_GE, v, additive());
+		if (accept("==")) return apply(OP_EQ, v, additive());
+		if (accept("!=")) return apply(OP_NE, v, additive());
+		if (accept("<")) return apply(OP_LT, v, additive());
+		if (accept(">")) return apply(OP_GT, v, additive());
+		return v;
+	}
+
+	Value logicalAnd()
+	{
+		Value v = comparison();
+		while (!failed && accept("&&")) v = apply(OP_AND, v, comparison());
+		return v;
+	}
+
+	Value logicalOr()
+	{
+		Value v = logicalAnd();
+		while (!failed && accept("||")) v = apply(OP_OR, v, logicalAnd());
+		return v;
+	}
+
+	Value expression()
+	{
+		Value v = logicalOr();
+		if (!failed && accept("?"))
+		{
+			Value t = expression();
+			if (!accept(":")) return fail("Expected ':'");
+			Value f = expression();
+			return apply(OP_SELECT, v, t, f);
+		}
+		return v;
+	}
+
+	void statement()
+	{
+		std::string name;
+		if (!identifier(name))
+		{
+			fail("Expected assignment");
+			return;
+		}
+
+		skipSpace();
+		if ((pos[0] != '=') || (pos[1] == '='))
+		{
+			fail("Expected '='");
+			return;
+		}
+		pos++;
+
+		Value v = expression();
+		if (failed) return;
+
+		int output = -1;
+		if ((name.size() == 2) && (name[0] == 'o') && (name[1] >= 'a') && (name[1] <= 'd')) output = name[1] - 'a';
+		if ((name.size() == 2) && (name[0] == 'o') && (name[1] >= 'A') && (name[1] <= 'D')) output = 4 + name[1] - 'A';
+
+		bool isTemporary = (name.size() == 2) && (name[0] == 't') &&
+			(((name[1] >= 'a') && (name[1] <= 'h')) || ((name[1] >= 'A') && (name[1] <= 'H')));
+
+		if ((output < 0) && !isTemporary)
+		{
+			fail("Only outputs oa-od, oA-oD and temporaries ta-th, tA-tH can be assigned");
+			return;
+		}
+
+		int width = ((output >= 4) || (isTemporary && (name[1] <= 'H'))) ? 3 : 1;
+		if (!broadcast(v, width))
+		{
+			fail("Cannot assign vector to scalar");
+			return;
+		}
+
+		variables[name] = v;
+
+		if (output >= 0)
+		{
+			for (int k = 0; k < width; ++k)
+			{
+				emit(OP_STORE, -1, v.slot[k], output, k);
+			}
+			prog.assignedOutputs |= 1u << output;
+		}
+	}
+
+	SoExpressionEngine::Program &prog;
+	const char *pos;
+	bool failed;
+	Value inputs[NUM_INPUTS];
+	std::map<std::string, Value> variables;
+	std::map<float, int> constantSlots;
+};
+
+
+SO_ENGINE_SOURCE(SoExpressionEngine);
+
+
+void SoExpressionEngine::initClass()
+{
+	SO_ENGINE_INIT_CLASS(SoExpressionEngine, SoEngine, "Engine");
+}
+
+
+SoExpressionEngine::SoExpressionEngine() : program(0), needsCompile(true)
+{
+	SO_ENGINE_CONSTRUCTOR(SoExpressionEngine);
+
+	SO_ENGINE_ADD_INPUT(a, (0.f));
+	SO_ENGINE_ADD_INPUT(b, (0.f));
+	SO_ENGINE_ADD_INPUT(c, (0.f));
+	SO_ENGINE_ADD_INPUT(d, (0.f));
+	SO_ENGINE_ADD_INPUT(e, (0.f));
+	SO_ENGINE_ADD_INPUT(f, (0.f));
+	SO_ENGINE_ADD_INPUT(g, (0.f));
+	SO_ENGINE_ADD_INPUT(h, (0.f));
+	SO_ENGINE_ADD_INPUT(A, (0.f, 0.f, 0.f));
+	SO_ENGINE_ADD_INPUT(B, (0.f, 0.f, 0.f));
+	SO_ENGINE_ADD_INPUT(C, (0.f, 0.f, 0.f));
+	SO_ENGINE_ADD_INPUT(D, (0.f, 0.f, 0.f));
+	SO_ENGINE_ADD_INPUT(E, (0.f, 0.f, 0.f));
+	SO_ENGINE_ADD_INPUT(F, (0.f, 0.f, 0.f));
+	SO_ENGINE_ADD_INPUT(G, (0.f, 0.f, 0.f));
+	SO_ENGINE_ADD_INPUT(H, (0.f, 0.f, 0.f));
+	SO_ENGINE_ADD_INPUT(expression, (""));
+
+	SO_ENGINE_ADD_OUTPUT(oa, SoMFFloat);
+	SO_ENGINE_ADD_OUTPUT(ob, SoMFFloat);
+	SO_ENGINE_ADD_OUTPUT(oc, SoMFFloat);
+	SO_ENGINE_ADD_OUTPUT(od, SoMFFloat);
+	SO_ENGINE_ADD_OUTPUT(oA, SoMFVec3f);
+	SO_ENGINE_ADD_OUTPUT(oB, SoMFVec3f);
+	SO_ENGINE_ADD_OUTPUT(oC, SoMFVec3f);
+	SO_ENGINE_ADD_OUTPUT(oD, SoMFVec3f);
+}
+
+
+SoExpressionEngine::~SoExpressionEngine()
+{
+	delete program;
+}
+
+
+void SoExpressionEngine::inputChanged(SoField *which)
+{
+	// outputs are enabled before the notification reaches them, so fields
+	// connected to a newly assigned output are marked as needing evaluation
+	if (which == &expression)
+	{
+		compile();
+	}
+}
+
+
+void SoExpressionEngine::compile()
+{
+	delete program;
+	program = new Program();
+	needsCompile = false;
+
+	ExpressionCompiler compiler(*program);
+	for (int i = 0; i < expression.getNum(); ++i)
+	{
+		if (!compiler.compile(expression[i].getString()))
+		{
+			SoError::post("SoExpressionEngine: %s in expression %d", compiler.error.getString(), i);
+			delete program;
+			program = new Program();
+			break;
+		}
+	}
+
+	SoEngineOutput *outputs[] = { &oa, &ob, &oc, &od, &oA, &oB, &oC, &oD };
+	for (int i = 0; i < NUM_OUTPUTS; ++i)
+	{
+		outputs[i]->enable((program->assignedOutputs & (1u << i)) != 0);
+	}
+}
+
+
+void SoExpressionEngine::evaluate()
+{
+	if (needsCompile)
+	{
+		compile();
+	}
+
+	// number of results is given by longest input referenced
+	const SoMFFloat *scalars[] = { &a, &b, &c, &d, &e, &f, &g, &h };
+	const SoMFVec3f *vectors[] = { &A, &B, &C, &D, &E, &F, &G, &H };
+	const float *inputData[NUM_INPUTS];
+	int inputNum[NUM_INPUTS];
+	int num = program->usedInputs ? 0 : 1;
+
+	for (int i = 0; i < NUM_INPUTS; ++i)
+	{
+		inputData[i] = 0;
+		inputNum[i] = 0;
+		if (program->usedInputs & (1u << i))
+		{
+			if (i < 8)
+			{
+				inputNum[i] = scalars[i]->getNum();
+				inputData[i] = scalars[i]->getValues(0);
+			}
+			else
+			{
+				inputNum[i] = vectors[i - 8]->getNum();
+				inputData[i] = inputNum[i] ? vectors[i - 8]->getValues(0)->getValue() : 0;
+			}
+			num = std::max(num, inputNum[i]);
+		}
+	}
+
+	std::vector<float> results[NUM_OUTPUTS];
+	float *outputData[NUM_OUTPUTS];
+	for (int i = 0; i < NUM_OUTPUTS; ++i)
+	{
+		if (program->assignedOutputs & (1u << i))
+		{
+			results[i].resize(std::max(1, num * ((i < 4) ? 1 : 3)));
+		}
+		outputData[i] = results[i].size() ? &results[i][0] : 0;
+	}
+
+	// split large arrays into chunks of whole batches for worker threads
+	int numThreads = 1;
+	if (num >= 2 * THREAD_CHUNK_SIZE)
+	{
+		int cores = (int) std::thread::hardware_concurrency();
+		numThreads = std::max(1, std::min(cores, num / THREAD_CHUNK_SIZE));
+	}
+
+	if (numThreads > 1)
+	{
+		int chunk = (num + numThreads - 1) / numThreads;
+		chunk = ((chunk + BATCH_SIZE - 1) / BATCH_SIZE) * BATCH_SIZE;
+
+		std::vector<std::thread> workers;
+		for (int start = chunk; start < num; start += chunk)
+		{
+			workers.push_back(std::thread(&Program::run, program, inputData, inputNum, outputData, start, std::min(num, start + chunk)));
+		}
+		program->run(inputData, inputNum, outputData, 0, std::min(num, chunk));
+
+		for (size_t i = 0; i < workers.size(); ++i)
+		{
+			workers[i].join();
+		}
+	}
+	else
+	{
+		program->run(inputData, inputNum, outputData, 0, num);
+	}
+
+	if (outputData[0]) { SO_ENGINE_OUTPUT(oa, SoMFFloat, setNum(num)); SO_ENGINE_OUTPUT(oa, SoMFFloat, setValues(0, num, outputData[0])); }
+	if (outputData[1]) { SO_ENGINE_OUTPUT(ob, SoMFFloat, setNum(num)); SO_ENGINE_OUTPUT(ob, SoMFFloat, setValues(0, num, outputData[1])); }
+	if (outputData[2]) { SO_ENGINE_OUTPUT(oc, SoMFFloat, setNum(num)); SO_ENGINE_OUTPUT(oc, SoMFFloat, setValues(0, num, outputData[2])); }
+	if (outputData[3]) { SO_ENGINE_OUTPUT(od, SoMFFloat, setNum(num)); SO_ENGINE_OUTPUT(od, SoMFFloat, setValues(0, num, outputData[3])); }
+	if (outputData[4]) { SO_ENGINE_OUTPUT(oA, SoMFVec3f, setNum(num)); SO_ENGINE_OUTPUT(oA, SoMFVec3f, setValues(0, num, (const SbVec3f *) outputData[4])); }
+	if (outputData[5]) { SO_ENGINE_OUTPUT(oB, SoMFVec3f, setNum(num)); SO_ENGINE_OUTPUT(oB, SoMFVec3f, setValues(0, num, (const SbVec3f *) outputData[5])); }
+	if (outputData[6]) { SO_ENGINE_OUTPUT(oC, SoMFVec3f, setNum(num)); SO_ENGINE_OUTPUT(oC, SoMFVec3f, setValues(0, num, (const SbVec3f *) outputData[6])); }
+	if (outputData[7]) { SO_ENGINE_OUTPUT(oD, SoMFVec3f, setNum(num)); SO_ENGINE_OUTPUT(oD, SoMFVec3f, setValues(0, num, (const SbVec3f *) outputData[7])); }
+}
+
@@ -0,0 +1,58 @@
+/**
+ * \file
+ * \brief      SoExpressionEngine class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include <Inventor/engines/SoSubEngine.h>
+#include <Inventor/fields/SoMFFloat.h>
+#include <Inventor/fields/SoMFVec3f.h>
+#include <Inventor/fields/SoMFString.h>
+
+
+/**
+ * Engine that evaluates arithmetic expressions over whole multi-value
+ * fields. The inputs and outputs follow SoCalculator (a-h, A-H, oa-od,
+ * oA-oD, temporaries ta-th, tA-tH), but the expression is compiled once
+ * into register code that processes batches of elements. Large arrays
+ * are split across threads.
+ */
+class SoExpressionEngine : public SoEngine
+{
+	typedef SoEngine inherited;
+
+	SO_ENGINE_HEADER(SoExpressionEngine);
+
+public:
+	static void initClass();
+	SoExpressionEngine();
+
+	SoMFFloat a, b, c, d, e, f, g, h;
+	SoMFVec3f A, B, C, D, E, F, G, H;
+	SoMFString expression;
+
+	SoEngineOutput oa, ob, oc, od; // SoMFFloat
+	SoEngineOutput oA, oB, oC, oD; // SoMFVec3f
+
+	struct Program;
+
+protected:
+	virtual ~SoExpressionEngine();
+	virtual void inputChanged(SoField *which);
+	virtual void evaluate();
+
+private:
+	void compile();
+
+	Program *program;
+	bool needsCompile;
+};
+
@@ -0,0 +1,722 @@
+/**
+ * \file
+ * \brief      SoPointCloud class implementation.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <Inventor/SbViewVolume.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/bundles/SoMaterialBundle.h>
+#include <Inventor/elements/SoGLLazyElement.h> // for GL.h, whose location is distribution specific under system/ or sys/
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoLightModelElement.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/elements/SoViewVolumeElement.h>
+#include <Inventor/elements/SoViewportRegionElement.h>
+#include <Inventor/errors/SoError.h>
+#include <Inventor/misc/SoState.h>
+#include <Inventor/sensors/SoTimerSensor.h>
+#include "SoPointCloud.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+
+// maximum number of grid cells along each axis of a node from which one point is kept
+static const int MAX_GRID_SIZE = 1024;
+
+// nodes below this depth keep all their points
+static const int MAX_DEPTH = 21;
+
+// file format identification
+static const char FILE_MAGIC[4] = { 'I', 'V', 'P', 'C' };
+static const uint32_t FILE_VERSION = 1;
+
+// seconds between checks for chunks completed by the loader thread
+static const double POLL_INTERVAL = 0.05;
+
+// multiple of point budget that may stay resident before unused chunks are dropped
+static const size_t RESIDENT_FACTOR = 4;
+
+
+// header of point cloud files, followed by node table and point data
+typedef struct
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t numNodes;
+	uint32_t hasColors;
+	float bounds[6];
+} FileHeader;
+
+
+// octree node, offset counts points in memory and bytes in files
+typedef struct
+{
+	float bounds[6];
+	float spacing;
+	uint32_t numPoints;
+	uint64_t offset;
+	int32_t children[8];
+} OctreeNode;
+
+
+// points of a node paged in from a mapped file
+typedef struct
+{
+	enum State { EMPTY, REQUESTED, LOADED } state;
+	std::vector<float> positions;
+	std::vector<unsigned char> colors;
+	unsigned int lastFrame;
+} Chunk;
+
+
+struct SoPointCloud::Octree
+{
+	Octree() : hasColors(false), data(0), size(0), stop(false), loads(0), pending(0), residentPoints(0)
+	{
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#endif
+		bounds.makeEmpty();
+	}
+
+	std::vector<OctreeNode> nodes;
+	SbBox3f bounds;
+	bool hasColors;
+
+	// points of octree built in memory
+	std::vector<float> positions;
+	std::vector<unsigned char> colors;
+
+	// mapped file and the chunks paged in from it by the loader thread
+	const char *data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file, mapping;
+#endif
+	std::vector<Chunk> chunks;
+	std::deque<int32_t> requests;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::thread loader;
+	bool stop;
+	std::atomic<int> loads;
+	int pending;
+	size_t residentPoints;
+};
+
+
+static size_t selectCells(const float *positions, std::vector<uint32_t> &indices, size_t begin, size_t end, const float *origin, float size, int grid, size_t limit, bool move)
+{
+	// counts occupied grid cells up to limit, optionally moving the first
+	// point of every cell to the front of the range
+	std::unordered_set<uint32_t> cells;
+	float scale = grid / size;
+	size_t selected = 0;
+	for (size_t i = begin; (i < end) && (selected <= limit); ++i)
+	{
+		const float *p = positions + (size_t) indices[i] * 3;
+		uint32_t cell = 0;
+		for (int j = 0; j < 3; ++j)
+		{
+			int c = std::min(grid - 1, std::max(0, (int) ((p[j] - origin[j]) * scale)));
+			cell = cell * grid + c;
+		}
+		if (cells.insert(cell).second)
+		{
+			if (move) std::swap(indices[begin + selected], indices[i]);
+			selected++;
+		}
+	}
+
+	return selected;
+}
+
+
+static void buildNode(SoPointCloud::Octree *octree, const float *positions, const unsigned char *colors, std::vector<uint32_t> &indices, size_t begin, size_t end, const float *origin, float size, int depth, size_t maxNodePoints, int32_t &index_out)
+{
+	index_out = (int32_t) octree->nodes.size();
+
+	OctreeNode node;
+	memset(&node, 0, sizeof(OctreeNode));
+	for (int i = 0; i < 3; ++i)
+	{
+		node.bounds[i] = origin[i];
+		node.bounds[i + 3] = origin[i] + size;
+	}
+	for (int i = 0; i < 8; ++i) node.children[i] = -1;
+
+	// inner nodes keep one point per grid cell, with the finest grid whose
+	// subsample still fits, so surfaces and volumes both fill their nodes
+	size_t count = end - begin;
+	size_t selected = count;
+	int grid = MAX_GRID_SIZE;
+	if ((count > maxNodePoints) && (depth < MAX_DEPTH))
+	{
+		grid = std::max(1, (int) pow((double) maxNodePoints, 1. / 3.));
+		while ((grid * 2 <= MAX_GRID_SIZE) && (selectCells(positions, indices, begin, end, origin, size, grid * 2, maxNodePoints, false) <= maxNodePoints))
+		{
+			grid *= 2;
+		}
+		selected = selectCells(positions, indices, begin, end, origin, size, grid, count, true);
+	}
+	node.spacing = size / grid;
+
+	node.numPoints = (uint32_t) selected;
+	node.offset = octree->positions.size() / 3;
+	for (size_t i = begin; i < begin + selected; ++i)
+	{
+		octree->positions.insert(octree->positions.end(), positions + (size_t) indices[i] * 3, positions + (size_t) indices[i] * 3 + 3);
+		if (colors) octree->colors.insert(octree->colors.end(), colors + (size_t) indices[i] * 4, colors + (size_t) indices[i] * 4 + 4);
+	}
+	octree->nodes.push_back(node);
+
+	if (selected == count) return;
+
+	// remaining points are sorted into octants
+	float half = size * 0.5f;
+	std::vector<uint32_t> octants(count - selected);
+	size_t counts[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	for (size_t i = begin + selected; i < end; ++i)
+	{
+		const float *p = positions + (size_t) indices[i] * 3;
+		uint32_t octant = (p[0] >= origin[0] + half ? 1 : 0) | (p[1] >= origin[1] + half ? 2 : 0) | (p[2] >= origin[2] + half ? 4 : 0);
+		octants[i - begin - selected] = octant;
+		counts[octant]++;
+	}
+
+	size_t starts[9] = { begin + selected };
+	for (int i = 0; i < 8; ++i) starts[i + 1] = starts[i] + counts[i];
+
+	std::vector<uint32_t> sorted(count - selected);
+	size_t fill[8];
+	for (int i = 0; i < 8; ++i) fill[i] = starts[i] - starts[0];
+	for (size_t i = 0; i < octants.size(); ++i)
+	{
+		sorted[fill[octants[i]]++] = indices[begin + selected + i];
+	}
+	std::copy(sorted.begin(), sorted.end(), indices.begin() + begin + selected);
+	std::vector<uint32_t>().swap(sorted);
+	std::vector<uint32_t>().swap(octants);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		if (!counts[i]) continue;
+
+		float childOrigin[3] = { origin[0] + ((i & 1) ? half : 0.f), origin[1] + ((i & 2) ? half : 0.f), origin[2] + ((i & 4) ? half : 0.f) };
+		int32_t child = -1;
+		buildNode(octree, positions, colors, indices, starts[i], starts[i + 1], childOrigin, half, depth + 1, maxNodePoints, child);
+		octree->nodes[index_out].children[i] = child;
+	}
+}
+
+
+static void loaderThread(SoPointCloud::Octree *octree)
+{
+	std::unique_lock<std::mutex> lock(octree->mutex);
+	while (!octree->stop)
+	{
+		if (octree->requests.empty())
+		{
+			octree->wakeup.wait(lock);
+			continue;
+		}
+
+		int32_t index = octree->requests.front();
+		octree->requests.pop_front();
+		const OctreeNode &node = octree->nodes[index];
+		lock.unlock();
+
+		// copying touches the mapped pages, so page faults happen here rather than while drawing
+		std::vector<float> positions(node.numPoints * 3);
+		std::vector<unsigned char> colors(octree->hasColors ? node.numPoints * 4 : 0);
+		memcpy(positions.data(), octree->data + node.offset, positions.size() * sizeof(float));
+		memcpy(colors.data(), octree->data + node.offset + positions.size() * sizeof(float), colors.size());
+
+		lock.lock();
+		Chunk &chunk = octree->chunks[index];
+		if (chunk.state == Chunk::REQUESTED)
+		{
+			chunk.positions.swap(positions);
+			chunk.colors.swap(colors);
+			chunk.state = Chunk::LOADED;
+			octree->residentPoints += node.numPoints;
+			octree->pending--;
+			octree->loads++;
+		}
+	}
+}
+
+
+static SoPointCloud::Octree *openOctree(const char *path)
+{
+	SoPointCloud::Octree *octree = new SoPointCloud::Octree();
+
+#ifdef _WIN32
+	octree->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER fileSize;
+	if ((octree->file != INVALID_HANDLE_VALUE) && GetFileSizeEx(octree->file, &fileSize) && fileSize.QuadPart)
+	{
+		octree->mapping = CreateFileMappingA(octree->file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (octree->mapping)
+		{
+			octree->data = (const char *) MapViewOfFile(octree->mapping, FILE_MAP_READ, 0, 0, 0);
+			octree->size = octree->data ? (size_t) fileSize.QuadPart : 0;
+		}
+	}
+#else
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if ((fd >= 0) && !fstat(fd, &st) && st.st_size)
+	{
+		void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			octree->data = (const char *) data;
+			octree->size = (size_t) st.st_size;
+		}
+	}
+	if (fd >= 0) close(fd);
+#endif
+
+	// validate header, node table and data ranges before anything is drawn
+	const FileHeader *header = (const FileHeader *) octree->data;
+	bool valid = (octree->size >= sizeof(FileHeader)) && !memcmp(header->magic, FILE_MAGIC, 4) && (header->version == FILE_VERSION) &&
+		(octree->size >= sizeof(FileHeader) + (size_t) header->numNodes * sizeof(OctreeNode));
+
+	if (valid)
+	{
+		const OctreeNode *nodes = (const OctreeNode *) (octree->data + sizeof(FileHeader));
+		size_t bytesPerPoint = 3 * sizeof(float) + (header->hasColors ? 4 : 0);
+		for (uint32_t i = 0; valid && (i < header->numNodes); ++i)
+		{
+			valid = (nodes[i].offset <= octree->size) && ((octree->size - nodes[i].offset) / bytesPerPoint >= nodes[i].numPoints);
+			for (int j = 0; valid && (j < 8); ++j)
+			{
+				valid = (nodes[i].children[j] < (int32_t) header->numNodes);
+			}
+		}
+
+		if (valid)
+		{
+			octree->nodes.assign(nodes, nodes + header->numNodes);
+			octree->hasColors = (header->hasColors != 0);
+			octree->bounds.setBounds(header->bounds[0], header->bounds[1], header->bounds[2], header->bounds[3], header->bounds[4], header->bounds[5]);
+
+			Chunk empty;
+			empty.state = Chunk::EMPTY;
+			empty.lastFrame = 0;
+			octree->chunks.resize(octree->nodes.size(), empty);
+			octree->loader = std::thread(loaderThread, octree);
+		}
+	}
+
+	if (!valid)
+	{
+		SoPointCloud::destroy(octree);
+		return NULL;
+	}
+
+	return octree;
+}
+
+
+SO_NODE_SOURCE(SoPointCloud);
+
+
+void SoPointCloud::initClass()
+{
+	SO_NODE_INIT_CLASS(SoPointCloud, SoShape, "Shape");
+}
+
+
+SoPointCloud::SoPointCloud() : memoryOctree(0), fileOctree(0), loadSensor(0), loadsSeen(0), frame(0)
+{
+	SO_NODE_CONSTRUCTOR(SoPointCloud);
+
+	SO_NODE_ADD_FIELD(filename, (""));
+	SO_NODE_ADD_FIELD(pointBudget, (1000000));
+	SO_NODE_ADD_FIELD(maxScreenError, (1.f));
+
+	loadSensor = new SoTimerSensor(loadCBFunc, this);
+	loadSensor->setInterval(SbTime(POLL_INTERVAL));
+}
+
+
+SoPointCloud::~SoPointCloud()
+{
+	delete loadSensor;
+	destroy(memoryOctree);
+	destroy(fileOctree);
+}
+
+
+SoPointCloud::Octree *SoPointCloud::build(const float *positions, const unsigned char *colors, size_t numPoints, int maxNodePoints)
+{
+	Octree *octree = new Octree();
+	octree->hasColors = (colors != 0);
+	octree->positions.reserve(numPoints * 3);
+	if (colors) octree->colors.reserve(numPoints * 4);
+
+	for (size_t i = 0; i < numPoints; ++i)
+	{
+		octree->bounds.extendBy(SbVec3f(positions + i * 3));
+	}
+
+	if (numPoints)
+	{
+		// octree cells are cubes around the bounding box
+		SbVec3f min, max;
+		octree->bounds.getBounds(min, max);
+		SbVec3f extent = max - min;
+		float size = std::max(extent[0], std::max(extent[1], extent[2]));
+
+		std::vector<uint32_t> indices(numPoints);
+		for (size_t i = 0; i < numPoints; ++i) indices[i] = (uint32_t) i;
+
+		int32_t root = 0;
+		buildNode(octree, positions, colors, indices, 0, numPoints, min.getValue(), size > 0.f ? size : 1.f, 0, (size_t) std::max(1, maxNodePoints), root);
+	}
+
+	return octree;
+}
+
+
+bool SoPointCloud::write(const Octree *octree, const char *path)
+{
+	FILE *fp = fopen(path, "wb");
+	if (!fp) return false;
+
+	FileHeader header;
+	memcpy(header.magic, FILE_MAGIC, 4);
+	header.version = FILE_VERSION;
+	header.numNodes = (uint32_t) octree->nodes.size();
+	header.hasColors = octree->hasColors ? 1 : 0;
+	SbVec3f min(0.f, 0.f, 0.f), max(0.f, 0.f, 0.f);
+	if (!octree->bounds.isEmpty()) octree->bounds.getBounds(min, max);
+	for (int i = 0; i < 3; ++i)
+	{
+		header.bounds[i] = min[i];
+		header.bounds[i + 3] = max[i];
+	}
+
+	// point data follows node table, positions of a node before its colors
+	std::vector<OctreeNode> nodes(octree->nodes);
+	uint64_t offset = sizeof(FileHeader) + nodes.size() * sizeof(OctreeNode);
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		nodes[i].offset = offset;
+		offset += nodes[i].numPoints * (3 * sizeof(float) + (octree->hasColors ? 4 : 0));
+	}
+
+	bool ok = (fwrite(&header, sizeof(FileHeader), 1, fp) == 1) && (fwrite(nodes.data(), sizeof(OctreeNode), nodes.size(), fp) == nodes.size());
+	for (size_t i = 0; ok && (i < nodes.size()); ++i)
+	{
+		const OctreeNode &node = octree->nodes[i];
+		if (!node.numPoints) continue;
+
+		ok = (fwrite(&octree->positions[node.offset * 3], 3 * sizeof(float), node.numPoints, fp) == node.numPoints);
+		if (ok && octree->hasColors)
+		{
+			ok = (fwrite(&octree->colors[node.offset * 4], 4, node.numPoints, fp) == node.numPoints);
+		}
+	}
+
+	return (fclose(fp) == 0) && ok;
+}
+
+
+void SoPointCloud::destroy(Octree *octree)
+{
+	if (!octree) return;
+
+	if (octree->loader.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(octree->mutex);
+			octree->stop = true;
+		}
+		octree->wakeup.notify_all();
+		octree->loader.join();
+	}
+
+#ifdef _WIN32
+	if (octree->data) UnmapViewOfFile(octree->data);
+	if (octree->mapping) CloseHandle(octree->mapping);
+	if (octree->file != INVALID_HANDLE_VALUE) CloseHandle(octree->file);
+#else
+	if (octree->data) munmap((void *) octree->data, octree->size);
+#endif
+
+	delete octree;
+}
+
+
+void SoPointCloud::setOctree(Octree *octree)
+{
+	destroy(memoryOctree);
+	memoryOctree = octree;
+	touch();
+}
+
+
+SoPointCloud::Octree *SoPointCloud::getOctree()
+{
+	SbString name = filename.getValue();
+	if (!name.getLength())
+	{
+		return memoryOctree;
+	}
+
+	if (name != loadedFilename)
+	{
+		destroy(fileOctree);
+		fileOctree = openOctree(name.getString());
+		if (!fileOctree)
+		{
+			SoError::post("Cannot read point cloud file '%s'", name.getString());
+		}
+		loadedFilename = name;
+		loadsSeen = 0;
+	}
+
+	return fileOctree;
+}
+
+
+void SoPointCloud::loadCBFunc(void *userdata, SoSensor *sensor)
+{
+	SoPointCloud *self = (SoPointCloud *) userdata;
+	Octree *octree = self->fileOctree;
+	if (!octree)
+	{
+		sensor->unschedule();
+		return;
+	}
+
+	// redraw picks up completed chunks and requests the next ones
+	int loads = octree->loads;
+	if (loads != self->loadsSeen)
+	{
+		self->loadsSeen = loads;
+		self->touch();
+	}
+
+	std::lock_guard<std::mutex> lock(octree->mutex);
+	if (!octree->pending)
+	{
+		sensor->unschedule();
+	}
+}
+
+
+void SoPointCloud::computeBBox(SoAction * /*action*/, SbBox3f &box, SbVec3f &center)
+{
+	Octree *octree = getOctree();
+	if (octree && !octree->bounds.isEmpty())
+	{
+		box = octree->bounds;
+		center = box.getCenter();
+	}
+}
+
+
+void SoPointCloud::GLRender(SoGLRenderAction *action)
+{
+	Octree *octree = getOctree();
+	if (!octree || octree->nodes.empty() || !shouldGLRender(action))
+	{
+		return;
+	}
+
+	// selection depends on camera, so rendering must not be cached
+	SoState *state = action->getState();
+	SoCacheElement::invalidate(state);
+
+	const SbViewVolume &viewVolume = SoViewVolumeElement::get(state);
+	const SbMatrix &modelMatrix = SoModelMatrixElement::get(state);
+	float viewportPixels = (float) SoViewportRegionElement::get(state).getViewportSizePixels()[1];
+	float scale = powf(fabsf(modelMatrix.det3()), 1.f / 3.f);
+	float maxError = maxScreenError.getValue();
+	size_t budget = (size_t) std::max(0, pointBudget.getValue());
+	bool mapped = (octree->data != 0);
+	frame++;
+
+	if (mapped)
+	{
+		// requests of the last frame that were not picked up yet may be outdated
+		std::lock_guard<std::mutex> lock(octree->mutex);
+		for (size_t i = 0; i < octree->requests.size(); ++i)
+		{
+			octree->chunks[octree->requests[i]].state = Chunk::EMPTY;
+		}
+		octree->pending -= (int) octree->requests.size();
+		octree->requests.clear();
+	}
+
+	// visible nodes are refined in order of their screen-space error until budget is used up
+	std::priority_queue<std::pair<float, int32_t> > queue;
+	std::vector<int32_t> selected;
+	size_t numPoints = 0;
+	bool requested = false;
+	queue.push(std::make_pair(FLT_MAX, 0));
+
+	while (!queue.empty())
+	{
+		int32_t index = queue.top().second;
+		queue.pop();
+
+		const OctreeNode &node = octree->nodes[index];
+		SbBox3f box(node.bounds[0], node.bounds[1], node.bounds[2], node.bounds[3], node.bounds[4], node.bounds[5]);
+		box.transform(modelMatrix);
+		if (!viewVolume.intersect(box)) continue;
+		if (!selected.empty() && (numPoints + node.numPoints > budget)) break;
+
+		if (mapped)
+		{
+			// descendants are not refined before the node itself is resident
+			std::lock_guard<std::mutex> lock(octree->mutex);
+			Chunk &chunk = octree->chunks[index];
+			chunk.lastFrame = frame;
+			if (chunk.state != Chunk::LOADED)
+			{
+				if (chunk.state == Chunk::EMPTY)
+				{
+					chunk.state = Chunk::REQUESTED;
+					octree->requests.push_back(index);
+					octree->pending++;
+					requested = true;
+				}
+				continue;
+			}
+		}
+
+		selected.push_back(index);
+		numPoints += node.numPoints;
+
+		for (int i = 0; i < 8; ++i)
+		{
+			if (node.children[i] < 0) continue;
+
+			// error is the projected spacing of the points drawn so far near the child
+			const OctreeNode &child = octree->nodes[node.children[i]];
+			SbVec3f center((child.bounds[0] + child.bounds[3]) * 0.5f, (child.bounds[1] + child.bounds[4]) * 0.5f, (child.bounds[2] + child.bounds[5]) * 0.5f);
+			modelMatrix.multVecMatrix(center, center);
+			float worldToScreen = fabsf(viewVolume.getWorldToScreenScale(center, 1.f));
+			float error = (worldToScreen > 0.f) ? node.spacing * scale * viewportPixels / worldToScreen : FLT_MAX;
+			if (error > maxError)
+			{
+				queue.push(std::make_pair(error, node.children[i]));
+			}
+		}
+	}
+
+	if (requested)
+	{
+		octree->wakeup.notify_one();
+		if (!loadSensor->isScheduled()) loadSensor->schedule();
+	}
+
+	// points carry their own color, so lighting is turned off
+	state->push();
+	SoLightModelElement::set(state, this, SoLightModelElement::BASE_COLOR);
+	SoMaterialBundle mb(action);
+	mb.sendFirst();
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	if (octree->hasColors) glEnableClientState(GL_COLOR_ARRAY);
+	for (size_t i = 0; i < selected.size(); ++i)
+	{
+		const OctreeNode &node = octree->nodes[selected[i]];
+		if (!node.numPoints) continue;
+
+		const float *positions = mapped ? octree->chunks[selected[i]].positions.data() : &octree->positions[node.offset * 3];
+		const unsigned char *colors = !octree->hasColors ? 0 : mapped ? octree->chunks[selected[i]].colors.data() : &octree->colors[node.offset * 4];
+		glVertexPointer(3, GL_FLOAT, 0, positions);
+		if (colors) glColorPointer(4, GL_UNSIGNED_BYTE, 0, colors);
+		glDrawArrays(GL_POINTS, 0, (GLsizei) node.numPoints);
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+	if (octree->hasColors)
+	{
+		glDisableClientState(GL_COLOR_ARRAY);
+		SoGLLazyElement::getInstance(state)->reset(state, SoLazyElement::DIFFUSE_MASK);
+	}
+	state->pop();
+
+	if (mapped)
+	{
+		// chunks not needed in this frame are dropped when too many points are resident
+		std::lock_guard<std::mutex> lock(octree->mutex);
+		for (size_t i = 0; (octree->residentPoints > RESIDENT_FACTOR * budget) && (i < octree->chunks.size()); ++i)
+		{
+			Chunk &chunk = octree->chunks[i];
+			if ((chunk.state == Chunk::LOADED) && (chunk.lastFrame != frame))
+			{
+				std::vector<float>().swap(chunk.positions);
+				std::vector<unsigned char>().swap(chunk.colors);
+				chunk.state = Chunk::EMPTY;
+				octree->residentPoints -= octree->nodes[i].numPoints;
+			}
+		}
+	}
+}
+
+
+void SoPointCloud::generatePrimitives(SoAction *action)
+{
+	// picking and callback actions see the coarsest level only
+	Octree *octree = getOctree();
+	if (!octree || octree->nodes.empty()) return;
+
+	const float *positions = NULL;
+	const OctreeNode &root = octree->nodes[0];
+	if (!octree->data)
+	{
+		positions = octree->positions.data();
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(octree->mutex);
+		if (octree->chunks[0].state == Chunk::LOADED) positions = octree->chunks[0].positions.data();
+	}
+
+	if (!positions) return;
+
+	SoPrimitiveVertex pv;
+	for (uint32_t i = 0; i < root.numPoints; ++i)
+	{
+		pv.setPoint(SbVec3f(positions + i * 3));
+		invokePointCallbacks(action, &pv);
+	}
+}
@@ -0,0 +1,75 @@
+/**
+ * \file
+ * \brief      SoPointCloud class declaration.
+ * \author     Thomas Moeller
+ * \details
+ *
+ * Copyright (C) the PyInventor contributors. All rights reserved.
+ * This file is part of PyInventor, distributed under the BSD 3-Clause
+ * License. For full terms see the included COPYING file.
+ */
+
+
+#pragma once
+
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoSubNode.h>
+#include <Inventor/fields/SoSFString.h>
+#include <Inventor/fields/SoSFInt32.h>
+#include <Inventor/fields/SoSFFloat.h>
+
+class SoTimerSensor;
+class SoSensor;
+
+
+/**
+ * Shape drawing large point clouds organized in an octree. Every octree
+ * node holds a subsample of the points in its cell and children hold the
+ * rest, so drawing a node and some of its descendants never duplicates
+ * points. Each frame the visible nodes with the largest screen-space error
+ * are drawn until pointBudget is used up. The octree is either built in
+ * memory or memory-mapped from a file written by build(), in which case
+ * node chunks are paged in on a background thread.
+ */
+class SoPointCloud : public SoShape
+{
+	typedef SoShape inherited;
+
+	SO_NODE_HEADER(SoPointCloud);
+
+public:
+	static void initClass();
+	SoPointCloud();
+
+	SoSFString filename;
+	SoSFInt32 pointBudget;
+	SoSFFloat maxScreenError;
+
+	struct Octree;
+
+	// builds octree from positions and optional RGBA byte colors, copying both;
+	// numPoints must not exceed UINT32_MAX since points are indexed with 32 bits
+	static Octree *build(const float *positions, const unsigned char *colors, size_t numPoints, int maxNodePoints);
+	static bool write(const Octree *octree, const char *path);
+	static void destroy(Octree *octree);
+
+	// adopts octree built in memory, which is used while filename is empty
+	void setOctree(Octree *octree);
+
+protected:
+	virtual ~SoPointCloud();
+	virtual void GLRender(SoGLRenderAction *action);
+	virtual void computeBBox(SoAction *action, SbBox3f &box, SbVec3f &center);
+	virtual void generatePrimitives(SoAction *action);
+
+private:
+	Octree *getOctree();
+	static void loadCBFunc(void *userdata, SoSensor *sensor);
+
+	Octree *memoryOctree;
+	Octree *fileOctree;
+	SbString loadedFilename;
+	SoTimerSensor *loadSensor;
+	int loadsSeen;
+	unsigned int frame;
+};
@@ -1,6 +1,17 @@
 import unittest
+import pickle
+import tempfile
+import os
+import time
+import json
+import numpy
 import inventor
 
+try:
+    from OpenGL import GLUT
+except ImportError:
+    GLUT = None
+
 
 class NodeTest(unittest.TestCase):
     
@@ -81,5 +92,704 @@ class SensorTest(unittest.TestCase):
         self.assertEqual(self.callback_info, ['', 'Cone', 'Selection', 'Selection'])
 
 
+class SensorFilterTest(unittest.TestCase):
+
+    def test_epsilon_and_range(self):
+        cube = inventor.Cube()
+        calls = []
+        sensor = inventor.Sensor(cube, "width", lambda: calls.append(cube.width))
+        sensor.set_filter(epsilon=0.5)
+        cube.width = 2.1
+        inventor.process_queues(False)
+        self.assertEqual(calls, [])
+        cube.width = 3
+        inventor.process_queues(False)
+        self.assertEqual(calls, [3])
+        sensor.set_filter(range=(5, 10))
+        cube.width = 4
+        inventor.process_queues(False)
+        cube.width = 6
+        inventor.process_queues(False)
+        self.assertEqual(calls, [3, 6])
+
+    def test_min_interval_trailing(self):
+        cube = inventor.Cube()
+        calls = []
+        sensor = inventor.Sensor(cube, "width", lambda: calls.append(cube.width))
+        sensor.set_filter(min_interval=0.05)
+        for width in (2, 3, 4):
+            cube.width = width
+            inventor.process_queues(False)
+        self.assertEqual(calls, [2])
+        start = time.time()
+        while (len(calls) < 2) and (time.time() - start < 1.0):
+            inventor.process_queues(True)
+        self.assertEqual(calls, [2, 4])
+
+
+class EventLoopTest(unittest.TestCase):
+
+    def test_next_timeout(self):
+        inventor.process_queues(False)
+        sensor = inventor.Sensor(None)
+        sensor.set_interval(5.0)
+        sensor.schedule()
+        timeout = inventor.next_timeout()
+        self.assertIsNotNone(timeout)
+        self.assertTrue(0.0 <= timeout <= 5.0)
+        sensor.unschedule()
+
+    def test_process_without_wait(self):
+        inventor.process_queues(True, False)
+        start = time.time()
+        for i in range(10):
+            inventor.process_queues(True, False)
+        self.assertLess(time.time() - start, 0.05)
+
+
+class MonotonicTimerTest(unittest.TestCase):
+
+    def run_timer(self, catch_up):
+        calls = []
+        sensor = inventor.Sensor(None)
+        sensor.callback = lambda: calls.append(sensor.jitter)
+        sensor.set_interval(0.01, monotonic=True, catch_up=catch_up)
+        sensor.schedule()
+        time.sleep(0.055)
+        inventor.process_queues(False)
+        sensor.unschedule()
+        return sensor, calls
+
+    def test_skip(self):
+        sensor, calls = self.run_timer(False)
+        self.assertEqual(len(calls), 1)
+        self.assertEqual(sensor.ticks, 1)
+        self.assertGreaterEqual(sensor.missed, 4)
+        self.assertTrue(0.0 <= calls[0] < 0.01)
+
+    def test_catch_up(self):
+        sensor, calls = self.run_timer(True)
+        self.assertGreaterEqual(len(calls), 5)
+        self.assertEqual(sensor.ticks, len(calls))
+        self.assertEqual(sensor.missed, 0)
+        self.assertEqual(calls, sorted(calls, reverse=True))
+
+    def test_release_in_callback(self):
+        # callback drops the only reference to its sensor while ticks are due
+        calls = []
+        holder = [inventor.Sensor(None)]
+        holder[0].callback = lambda: (calls.append(1), holder.clear())
+        holder[0].set_interval(0.01, monotonic=True, catch_up=True)
+        holder[0].schedule()
+        time.sleep(0.035)
+        inventor.process_queues(False)
+        self.assertEqual(holder, [])
+        self.assertGreaterEqual(len(calls), 1)
+
+
+class ChangeLogTest(unittest.TestCase):
+
+    def test_batch(self):
+        root = inventor.Separator()
+        cube = inventor.Cube()
+        root += cube
+        batches = []
+        log = inventor.ChangeLog(batches.append)
+        root_id = log.attach(root)
+        cube.width = 2
+        cube.width = 3
+        cube.height = 4
+        root += inventor.Sphere()
+        inventor.process_queues(False)
+        self.assertEqual(len(batches), 1)
+        fields = [(log.get_container(i).get_type(), f) for i, f, t in batches[0] if f]
+        self.assertEqual(fields, [('Cube', 'width'), ('Cube', 'height')])
+        self.assertEqual(batches[0][-1], (root_id, None, 1))
+        inventor.process_queues(False)
+        self.assertEqual(len(batches), 1)
+
+    def test_release(self):
+        root = inventor.Separator()
+        cube = inventor.Cube()
+        sphere = inventor.Sphere()
+        root += [cube, sphere]
+        batches = []
+        log = inventor.ChangeLog(batches.append)
+        root_id = log.attach(root)
+        cube.width = 2
+        self.assertEqual(inventor.next_timeout(), 0)
+        inventor.process_queues(False)
+        cube_id = batches[0][0][0]
+        self.assertEqual(log.get_container(cube_id).get_type(), 'Cube')
+        sphere.radius = 3
+        inventor.process_queues(False)
+        self.assertEqual(len(batches), 2)
+        self.assertIsNone(log.get_container(cube_id))
+        self.assertEqual(log.get_container(root_id).get_type(), 'Separator')
+
+
+class PickleTest(unittest.TestCase):
+
+    def test_node(self):
+        sphere = pickle.loads(pickle.dumps(inventor.Sphere("radius 4")))
+        self.assertEqual(sphere.get_type(), 'Sphere')
+        self.assertEqual(sphere.radius, 4)
+
+    def test_shared(self):
+        root = inventor.Separator()
+        cone = inventor.Cone()
+        root += [cone, cone]
+        copy = pickle.loads(pickle.dumps(root))
+        self.assertEqual(len(copy), 2)
+        self.assertTrue(copy[0] == copy[1])
+        a, b = pickle.loads(pickle.dumps([root, root]))
+        self.assertTrue(a is b)
+
+    def test_independent_reads(self):
+        data = inventor.write(inventor.Cone(), binary=True)
+        a = inventor.read(data)
+        b = inventor.read(data)
+        self.assertFalse(a == b)
+        a.height = 5
+        self.assertNotEqual(b.height, 5)
+        self.assertRaises(TypeError, inventor.read, 42)
+
+    def test_path_errors(self):
+        root = inventor.Separator()
+        root += inventor.Cube()
+        self.assertEqual(len(inventor.Path(root, [0])), 2)
+        self.assertRaises(IndexError, inventor.Path, root, [1])
+        self.assertRaises(IndexError, inventor.Path, root, [0, 0])
+        self.assertRaises(TypeError, inventor.Path, root, ["a"])
+        self.assertRaises(TypeError, inventor.Path, 1)
+
+    def test_path_and_field(self):
+        root = inventor.Separator()
+        root += inventor.Group()
+        root[0] += inventor.Cube("width 3")
+        path = inventor.search(root, type="Cube")
+        copy = pickle.loads(pickle.dumps(path))
+        self.assertEqual(len(copy), 3)
+        self.assertEqual(copy[-1].width, 3)
+        field = pickle.loads(pickle.dumps(root[0][0].get_field("width")))
+        self.assertEqual(field.get_name(), "width")
+        self.assertEqual(field.value, 3)
+
+
+class SharedSceneTest(unittest.TestCase):
+
+    def test_roundtrip(self):
+        root = inventor.Separator()
+        coords = inventor.Coordinate3()
+        coords.point = [[i, i, i] for i in range(1000)]
+        root += [coords, inventor.PointSet()]
+        skeleton, shm = inventor.export_shared(root)
+        self.assertEqual(len(coords.point), 1000)
+        self.assertLess(len(skeleton), 1000 * 12)
+        copy = inventor.import_shared(skeleton, shm)
+        self.assertEqual(len(copy[0].point), 1000)
+        self.assertEqual(copy[0].point[999][0], 999)
+        del copy
+        shm.close()
+        shm.unlink()
+
+    def test_child_keeps_buffer(self):
+        root = inventor.Separator()
+        coords = inventor.Coordinate3()
+        coords.point = [[i, i, i] for i in range(1000)]
+        root += [coords, inventor.PointSet()]
+        skeleton, shm = inventor.export_shared(root)
+        copy = inventor.import_shared(skeleton, shm)
+        child = copy[0]
+        del copy
+        # child fields still reference the block, so it can't be unmapped
+        with self.assertRaises(BufferError):
+            shm.close()
+        self.assertEqual(child.point[999][0], 999)
+        del child
+        shm.close()
+        shm.unlink()
+
+
+class PyEngineTest(unittest.TestCase):
+
+    def test_evaluate(self):
+        calls = []
+        def scale(points, factor):
+            calls.append(points.flags.writeable)
+            return points * factor
+        engine = inventor.PyEngine({'points': 'MFVec3f', 'factor': 'SFFloat'}, {'result': 'MFVec3f'}, scale)
+        engine.points = [[1, 2, 3], [4, 5, 6]]
+        engine.factor = 2
+        coords = inventor.Coordinate3()
+        coords.get_field('point').connect_from(engine.get_output('result'))
+        self.assertEqual(coords.point.tolist(), [[2, 4, 6], [8, 10, 12]])
+        self.assertEqual(calls, [False])
+        engine.factor = 3
+        self.assertEqual(coords.point.tolist(), [[3, 6, 9], [12, 15, 18]])
+        self.assertEqual(engine.get_type(), 'PyEngine')
+        with self.assertRaises(ValueError):
+            inventor.PyEngine({'a': 'NoField'}, {}, scale)
+
+    def test_output_shape(self):
+        # mismatching shape is reported instead of reinterpreting the values
+        engine = inventor.PyEngine({'points': 'MFVec3f'}, {'result': 'MFVec3f'}, lambda points: points[:, :2])
+        engine.points = [[1, 2, 3], [4, 5, 6], [7, 8, 9]]
+        coords = inventor.Coordinate3()
+        coords.get_field('point').connect_from(engine.get_output('result'))
+        self.assertEqual(coords.point.tolist(), [[0, 0, 0]])
+
+
+class ExpressionEngineTest(unittest.TestCase):
+
+    def test_expression(self):
+        engine = inventor.ExpressionEngine()
+        engine.a = [1, 2, 3]
+        engine.A = [[1, 0, 0]]
+        engine.expression = ["ta = a * a + 1; oa = ta", "oA = normalize(A) * a + vec3f(0, a > 2 ? 1 : 0, 0)"]
+        lod = inventor.LOD()
+        lod.get_field('range').connect_from(engine.get_output('oa'))
+        coords = inventor.Coordinate3()
+        coords.get_field('point').connect_from(engine.get_output('oA'))
+        self.assertEqual(list(lod.range), [2, 5, 10])
+        self.assertEqual(coords.point.tolist(), [[1, 0, 0], [2, 0, 0], [3, 1, 0]])
+        self.assertFalse(engine.get_output('ob').is_enabled())
+
+    def test_expression_change(self):
+        engine = inventor.ExpressionEngine()
+        engine.a = [1, 2]
+        engine.expression = "oa = a"
+        lod = inventor.LOD()
+        lod.get_field('range').connect_from(engine.get_output('ob'))
+        self.assertEqual(len(lod.range), 0)
+        engine.expression = "ob = a * 2"
+        self.assertTrue(engine.get_output('ob').is_enabled())
+        self.assertEqual(list(lod.range), [2, 4])
+
+
+class EngineProfileTest(unittest.TestCase):
+
+    def test_profile(self):
+        root = inventor.Separator()
+        compose = inventor.ComposeVec3f()
+        coords = inventor.Coordinate3()
+        coords.get_field('point').connect_from(compose.get_output('vector'))
+        root += coords
+        self.assertEqual(inventor.start_engine_profile(root), 1)
+        for i in range(3):
+            compose.x = i
+            self.assertEqual(coords.point[0][0], i)
+        engines, types = inventor.stop_engine_profile()
+        self.assertEqual(engines[0]['type'], 'ComposeVec3f')
+        self.assertEqual(engines[0]['evaluations'], 3)
+        self.assertEqual(engines[0]['fanout'], 1)
+        self.assertGreaterEqual(engines[0]['propagations'], 3)
+        self.assertEqual(types['ComposeVec3f']['instances'], 1)
+        compose.x = 5
+        self.assertEqual(coords.point[0][0], 5)
+
+    def test_rewired_slave(self):
+        root = inventor.Separator()
+        compose = inventor.ComposeVec3f()
+        other = inventor.ComposeVec3f()
+        coords = inventor.Coordinate3()
+        coords.get_field('point').connect_from(compose.get_output('vector'))
+        root += coords
+        inventor.start_engine_profile(root)
+        coords.get_field('point').connect_from(other.get_output('vector'))
+        inventor.stop_engine_profile()
+        other.x = 7
+        compose.x = 9
+        self.assertEqual(coords.point[0][0], 7)
+
+
+class TraversalProfileTest(unittest.TestCase):
+
+    def test_profile(self):
+        root = inventor.Separator()
+        cube = inventor.Cube()
+        cube.set_name("box")
+        root += [inventor.Group(), cube]
+        inventor.start_traversal_profile(actions=["Search"])
+        inventor.search(root, type="Cube")
+        inventor.search(root, type="Cube")
+        profile = inventor.stop_traversal_profile()
+        self.assertEqual(len(profile), 3)
+        self.assertEqual(list(profile['type']), ['Separator', 'Group', 'Cube'])
+        self.assertEqual(list(profile['parent']), [-1, 0, 0])
+        self.assertEqual(profile['name'][2], 'box')
+        self.assertEqual(list(profile['visits']), [2, 2, 2])
+        self.assertTrue((profile['inclusive'] >= profile['exclusive']).all())
+        inventor.start_traversal_profile()
+        inventor.search(root, type="Cube")
+        stacks = inventor.stop_traversal_profile(format="collapsed")
+        self.assertTrue(all(line.startswith('Search;Separator') for line in stacks))
+        with self.assertRaises(ValueError):
+            inventor.start_traversal_profile(actions=["Write"])
+
+
+class TraceTest(unittest.TestCase):
+
+    def test_trace(self):
+        inventor.start_trace()
+        cube = inventor.Cube()
+        cube.width = 2
+        self.assertEqual(cube.width, 2)
+        inventor.stop_trace()
+        cube.width = 3
+        events = json.loads(inventor.flush_trace())['traceEvents']
+        names = [e['name'] for e in events]
+        self.assertEqual(names.count('SceneObject.setattr'), 1)
+        self.assertIn('SceneObject.getattr', names)
+        self.assertTrue(all(e['ph'] == 'X' and e['dur'] >= 0 for e in events))
+        self.assertEqual(json.loads(inventor.flush_trace())['traceEvents'], [])
+
+
+class FrameStatsTest(unittest.TestCase):
+
+    def test_snapshot(self):
+        manager = inventor.SceneManager()
+        stats = manager.frame_stats()
+        self.assertEqual(stats['frames'], 0)
+        self.assertEqual(stats['average_frame_time'], 0)
+        self.assertIn('cache_misses', stats.dtype.names)
+        self.assertEqual(stats['culled'], 0)
+        self.assertFalse(manager.detailed_stats)
+        manager.detailed_stats = True
+        self.assertTrue(manager.detailed_stats)
+
+
+class FramePacingTest(unittest.TestCase):
+
+    def test_pacing(self):
+        redraws = []
+        manager = inventor.SceneManager()
+        manager.redisplay = lambda: redraws.append(1)
+        manager.frame_interval = 10.0
+        manager.scene += inventor.Cube()
+        inventor.process_queues()
+        manager.scene += inventor.Cube()
+        inventor.process_queues()
+        self.assertEqual(len(redraws), 1)
+        self.assertEqual(manager.frame_stats()['redraw_requests'], 2)
+
+    def drag_camera(self, moves, coalesce):
+        # camera interaction rotates by the distance to the previous location event
+        manager = inventor.SceneManager()
+        manager.resize(100, 100)
+        manager.interaction(1)
+        manager.coalesce_moves = coalesce
+        camera = inventor.PerspectiveCamera()
+        manager.scene += [camera, inventor.Cube()]
+        start = list(camera.orientation)
+        manager.mouse_button(0, 0, 50, 50)
+        for x, y in moves:
+            manager.mouse_move(x, y)
+        manager.mouse_button(0, 1, x, y)
+        inventor.process_queues()
+        return start, list(camera.orientation)
+
+    def test_coalesce(self):
+        moves = [(50 + i // 4, 50 + i // 10) for i in range(100)]
+        start, coalesced = self.drag_camera(moves, True)
+        single = self.drag_camera(moves[-1:], False)[1]
+        # moves are merged into one location event that is delivered before
+        # the release, otherwise the camera would not have turned
+        self.assertNotEqual(coalesced, start)
+        self.assertEqual(coalesced, single)
+
+
+class AdaptiveQualityTest(unittest.TestCase):
+
+    def test_attributes(self):
+        manager = inventor.SceneManager()
+        self.assertFalse(manager.adaptive_quality)
+        self.assertAlmostEqual(manager.target_frame_time, 1 / 30)
+        manager.adaptive_quality = True
+        manager.target_frame_time = 0.05
+        self.assertEqual(manager.quality_level, 0)
+        with self.assertRaises(AttributeError):
+            manager.quality_level = 2
+
+    def test_progressive(self):
+        manager = inventor.SceneManager()
+        self.assertFalse(manager.progressive)
+        self.assertAlmostEqual(manager.progressive_budget, 0.1)
+        manager.progressive = True
+        manager.scene += inventor.Cube()
+        inventor.process_queues()
+        self.assertEqual(manager.quality_level, 0)
+
+    def test_replace_scene(self):
+        # scene sits below the quality complexity node, only it requests redraws
+        manager = inventor.SceneManager()
+        calls = []
+        manager.redisplay = lambda: calls.append(1)
+        old = manager.scene
+        manager.scene = inventor.Separator()
+        inventor.process_queues()
+        del calls[:]
+        old += inventor.Cube()
+        inventor.process_queues()
+        self.assertEqual(calls, [])
+        manager.scene += inventor.Cube()
+        inventor.process_queues()
+        self.assertGreater(len(calls), 0)
+
+    @unittest.skipUnless(GLUT and os.environ.get("DISPLAY"), "needs an OpenGL window")
+    def test_refinement(self):
+        GLUT.glutInit()
+        GLUT.glutInitDisplayMode(GLUT.GLUT_RGB | GLUT.GLUT_DEPTH | GLUT.GLUT_DOUBLE)
+        GLUT.glutInitWindowSize(64, 64)
+        window = GLUT.glutCreateWindow(b"test_refinement")
+        manager = inventor.SceneManager()
+        manager.resize(64, 64)
+        manager.scene += inventor.Cube()
+        manager.render()
+        # any measured full quality frame exceeds this budget
+        manager.progressive = True
+        manager.progressive_budget = 1e-9
+        levels = []
+        def redisplay():
+            levels.append(manager.quality_level)
+            manager.render()
+        manager.redisplay = redisplay
+        manager.scene += inventor.Sphere()
+        for i in range(20):
+            inventor.process_queues(True, False)
+        GLUT.glutDestroyWindow(window)
+        self.assertEqual(levels, [3, 2, 1, 0])
+        self.assertEqual(manager.quality_level, 0)
+
+
+class OptimizeTest(unittest.TestCase):
+
+    def test_spatial(self):
+        root = inventor.Separator()
+        root += inventor.Material()
+        for i in range(100):
+            sep = inventor.Separator()
+            sep += [inventor.Translation("translation {} {} 0".format(i % 10, i // 10)), inventor.Cube()]
+            root += sep
+        vertices = inventor.extract_triangles(root)[0]
+        self.assertGreater(inventor.optimize(root, leaf_size=8), 1)
+        self.assertEqual(len(root), 2)
+        self.assertEqual(root[0].get_type(), 'Material')
+        self.assertEqual(len(inventor.search(root, type="Cube")), 100)
+        optimized = inventor.extract_triangles(root)[0]
+        self.assertEqual(sorted(map(tuple, vertices.tolist())), sorted(map(tuple, optimized.tolist())))
+        with self.assertRaises(ValueError):
+            inventor.optimize(root, strategy="octree")
+
+
+class FlattenTest(unittest.TestCase):
+
+    def test_flatten(self):
+        root = inventor.Separator()
+        for i in range(4):
+            sep = inventor.Separator()
+            color = "1 0 0" if i % 2 else "0 0 1"
+            sep += [inventor.Material("diffuseColor " + color), inventor.Translation("translation {} 0 0".format(i * 3)), inventor.Cube()]
+            root += sep
+        flat, shapes, faces = inventor.flatten(root)
+        self.assertEqual(len(flat), 4)
+        self.assertEqual(flat[1].get_type(), 'IndexedFaceSet')
+        self.assertEqual(len(shapes), 4)
+        self.assertEqual([len(f) for f in faces], [24, 24])
+        self.assertEqual(sorted(set(faces[0].tolist()) | set(faces[1].tolist())), [0, 1, 2, 3])
+        vertices = inventor.extract_triangles(root)[0]
+        flattened = inventor.extract_triangles(flat)[0]
+        self.assertEqual(sorted(map(tuple, vertices.tolist())), sorted(map(tuple, flattened.tolist())))
+
+    def test_flatten_state(self):
+        root = inventor.Separator()
+        light = inventor.Separator()
+        light += [inventor.Translation("translation 0 5 0"), inventor.PointLight()]
+        root += [inventor.PerspectiveCamera(), inventor.Environment(), light, inventor.Cube()]
+        flat = inventor.flatten(root)[0]
+        self.assertEqual([n.get_type() for n in flat], ['PerspectiveCamera', 'Environment', 'TransformSeparator', 'Material', 'IndexedFaceSet'])
+        self.assertEqual(flat[2][1].get_type(), 'PointLight')
+        self.assertEqual(flat[2][0].matrix[3][1], 5)
+
+
+class SimplifyTest(unittest.TestCase):
+
+    def test_simplify(self):
+        sphere = inventor.Sphere()
+        root = inventor.Separator()
+        root += [inventor.Complexity("value 1"), sphere]
+        full = len(inventor.extract_triangles(root)[3])
+        lod = inventor.simplify(root, ratios=[0.5, 0.1])
+        self.assertEqual(lod.get_type(), 'LevelOfDetail')
+        self.assertEqual(len(lod), 3)
+        self.assertEqual(len(lod.screenArea), 2)
+        counts = [len(inventor.extract_triangles(lod[i])[3]) for i in (1, 2)]
+        self.assertLessEqual(counts[0], full // 2 + 1)
+        self.assertLess(counts[1], counts[0])
+        self.assertGreater(counts[1], 0)
+        with self.assertRaises(ValueError):
+            inventor.simplify(root, ratios=[2])
+        with self.assertRaises(ValueError):
+            inventor.simplify(root, ratios=[0.1, 0.5])
+        with self.assertRaises(ValueError):
+            inventor.simplify(root, ratios=[0.5, 0.1], screen_areas=[100, 1000])
+
+
+class PointCloudTest(unittest.TestCase):
+
+    def test_point_cloud(self):
+        points = [[(i * 7919 % 1000) / 1000.0, (i * 104729 % 1000) / 1000.0, (i % 97) / 97.0] for i in range(50000)]
+        cloud = inventor.point_cloud(points, colors=points, node_points=5000)
+        self.assertEqual(cloud.get_type(), 'PointCloud')
+        self.assertEqual(cloud.filename, '')
+        with tempfile.TemporaryDirectory() as path:
+            file = os.path.join(path, 'cloud.ivpc')
+            streamed = inventor.point_cloud(points, file=file, node_points=5000)
+            self.assertEqual(streamed.filename, file)
+            self.assertGreater(os.path.getsize(file), 50000 * 12)
+        with self.assertRaises(ValueError):
+            inventor.point_cloud([[0, 0]])
+
+
+class IsosurfaceTest(unittest.TestCase):
+
+    def test_isosurface(self):
+        n = 40
+        volume = [[[30 - ((x - 20) ** 2 + (y - 20) ** 2 + (z - 20) ** 2) ** 0.5 for x in range(n)] for y in range(n)] for z in range(n)]
+        shape = inventor.isosurface(volume, 15.0, spacing=(0.5, 0.5, 0.5))
+        self.assertEqual(shape.get_type(), 'IndexedFaceSet')
+        vertices = shape.vertexProperty.vertex
+        self.assertGreater(len(vertices), 100)
+        self.assertEqual(len(shape.vertexProperty.normal), len(vertices))
+        self.assertAlmostEqual(vertices[:, 0].max(), 17.5, places=2)
+        triangles = len(shape.coordIndex) // 4
+        self.assertIs(inventor.isosurface(volume, 12.0, shape=shape), shape)
+        self.assertGreater(len(shape.coordIndex) // 4, triangles)
+        inventor.isosurface(volume, 100.0, shape=shape)
+        self.assertEqual(len(shape.coordIndex), 0)
+
+    def test_cached_ranges(self):
+        n = 40
+        volume = numpy.fromfunction(lambda z, y, x: 30 - numpy.sqrt((x - 20) ** 2 + (y - 20) ** 2 + (z - 20) ** 2), (n, n, n), dtype=numpy.float32)
+        shape = inventor.isosurface(volume, 15.0)
+        for level in (12.0, 25.0, 15.0):
+            inventor.isosurface(volume, level, shape=shape)
+            fresh = inventor.isosurface(volume, level)
+            self.assertEqual(list(shape.coordIndex), list(fresh.coordIndex))
+        # a new array object is rescanned
+        shifted = volume + 10.0
+        inventor.isosurface(shifted, 15.0, shape=shape)
+        self.assertEqual(list(shape.coordIndex), list(inventor.isosurface(shifted, 15.0).coordIndex))
+
+
+class MeshToolsTest(unittest.TestCase):
+
+    def test_weld(self):
+        # two triangles sharing an edge through duplicated vertices
+        vertices = [[0, 0, 0], [1, 0, 0], [1, 1, 0], [0, 0, 0], [1, 1.001, 0], [0, 1, 0]]
+        shape = inventor.mesh(vertices, [[0, 1, 2], [3, 4, 5]], colors=[[1, 0, 0]] * 6)
+        self.assertEqual(inventor.weld(shape), 5)
+        self.assertEqual(list(shape.coordIndex), [0, 1, 2, -1, 0, 3, 4, -1])
+        self.assertEqual(list(shape.materialIndex), [0, 1, 2, -1, 3, 4, 5, -1])
+        self.assertEqual(inventor.weld(shape, 0.01), 4)
+        self.assertEqual(list(shape.coordIndex), [0, 1, 2, -1, 0, 2, 3, -1])
+        self.assertEqual(len(shape.vertexProperty.vertex), 4)
+        with self.assertRaises(TypeError):
+            inventor.weld(inventor.Cube())
+
+    def test_compute_normals(self):
+        # square folded by 90 degrees along its diagonal edge
+        vertices = [[0, 0, 0], [1, 0, 0], [1, 1, 0], [1, 0, 1]]
+        shape = inventor.mesh(vertices, [[0, 1, 2], [0, 3, 1]])
+        self.assertEqual(inventor.compute_normals(shape, 0.5), 6)
+        self.assertEqual(len(shape.normalIndex), len(shape.coordIndex))
+        normals = shape.vertexProperty.normal
+        self.assertAlmostEqual(normals[shape.normalIndex[2]][2], 1.0, places=5)
+        self.assertEqual(inventor.compute_normals(shape, 3.2), 4)
+        self.assertEqual(len(shape.normalIndex), 0)
+        normal = inventor.Normal()
+        inventor.compute_normals(shape, 0.5, normal=normal)
+        self.assertEqual(len(normal.vector), 6)
+
+    def test_optimize_vertex_cache(self):
+        def runs(indices):
+            result, run = [], []
+            for i in indices:
+                if i < 0:
+                    result.append(run)
+                    run = []
+                else:
+                    run.append(i)
+            return result
+
+        def face_colors(shape):
+            vertices, colors = shape.vertexProperty.vertex, shape.vertexProperty.orderedRGBA
+            faces = runs(shape.coordIndex)
+            return sorted((sorted(tuple(vertices[i]) for i in f), colors[k]) for k, f in enumerate(faces))
+
+        n = 12
+        vertices = [[i % (n + 1), i // (n + 1), 0] for i in range((n + 1) ** 2)]
+        faces = []
+        for i in range(n * (n + 1)):
+            if i % (n + 1) < n:
+                faces += [[i, i + 1, i + n + 2], [i, i + n + 2, i + n + 1]]
+        faces.sort(key=lambda f: (f[0] * 37 + f[1]) % 101)
+        colors = [[(k % 5) / 4.0, (k % 7) / 6.0, 0] for k in range(len(faces))]
+        shape = inventor.mesh(vertices, faces, colors=colors)
+        expected = face_colors(shape)
+        before, after = inventor.optimize_vertex_cache(shape)
+        self.assertLess(after, before)
+        self.assertEqual(face_colors(shape), expected)
+
+        strips = inventor.IndexedTriangleStripSet()
+        strips.vertexProperty = inventor.VertexProperty('vertex [0 0 0, 1 0 0, 0 1 0, 1 1 0, 0 2 0, 1 2 0]')
+        strips.coordIndex = [4, 5, 2, 3, -1, 0, 1, 2, 3, -1]
+        inventor.optimize_vertex_cache(strips)
+        self.assertEqual(sum(len(s) - 2 for s in runs(strips.coordIndex)), 4)
+
+
+class GeometryTest(unittest.TestCase):
+
+    def test_extract_triangles(self):
+        root = inventor.Separator()
+        root += [inventor.Translation("translation 10 0 0"), inventor.Cube()]
+        vertices, normals, colors, ids, shapes = inventor.extract_triangles(root, colors=True)
+        self.assertEqual(vertices.shape, (36, 3))
+        self.assertEqual(normals.shape, (36, 3))
+        self.assertEqual(colors.shape, (36, 4))
+        self.assertEqual(len(ids), 12)
+        self.assertEqual(shapes[0].get_type(), 'Cube')
+        self.assertAlmostEqual(vertices[:, 0].min(), 9)
+
+    def test_mesh(self):
+        vertices = [[0, 0, 0], [1, 0, 0], [1, 1, 0], [0, 1, 0]]
+        faces = [[0, 1, 2], [0, 2, 3]]
+        shape = inventor.mesh(vertices, faces, colors=[[1, 0, 0]] * 4)
+        self.assertEqual(shape.get_type(), 'IndexedFaceSet')
+        self.assertEqual(list(shape.coordIndex), [0, 1, 2, -1, 0, 2, 3, -1])
+        self.assertEqual(len(shape.vertexProperty.vertex), 4)
+        self.assertEqual(len(inventor.extract_triangles(shape)[3]), 2)
+        with self.assertRaises(ValueError):
+            inventor.mesh(vertices, [[0, 1, 4]])
+
+    def test_mesh_copies_arrays(self):
+        vertices = inventor.Coordinate3('point [0 0 0, 1 0 0, 1 1 0]').point
+        vertices.setflags(write=False)
+        shape = inventor.mesh(vertices, [[2, 1, 0]])
+        inventor.optimize_vertex_cache(shape)
+        self.assertEqual(list(shape.vertexProperty.vertex[0]), [1, 1, 0])
+        self.assertEqual(list(vertices[0]), [0, 0, 0])
+
+    def test_export(self):
+        root = inventor.Separator()
+        root += [inventor.Material("diffuseColor 1 0 0"), inventor.Cube()]
+        with tempfile.TemporaryDirectory() as folder:
+            for ext, magic in (("glb", b"glTF"), ("ply", b"ply\n"), ("obj", b"# Py")):
+                file = os.path.join(folder, "cube." + ext)
+                inventor.export_geometry(root, file)
+                with open(file, "rb") as f:
+                    self.assertEqual(f.read(4), magic)
+
+
 if __name__ == '__main__':
     unittest.main(verbosity=2)